@@ -49,6 +49,9 @@
 DEFINE_GUID(MEDIASUBTYPE_I420,
         0x30323449, 0x0000, 0x0010, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71);
 
+DEFINE_GUID(MEDIASUBTYPE_NV12,
+        0x3231564E, 0x0000, 0x0010, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71);
+
 DEFINE_GUID(MEDIASUBTYPE_H263,
         0x33363248, 0x0000, 0x0010, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71);
 
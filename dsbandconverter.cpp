@@ -0,0 +1,176 @@
+#include "dsbandconverter.h"
+
+#include <QtCore/qthread.h>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+// Handing a band to another core costs a few microseconds, about as long as
+// converting a quarter million pixels takes, so bands never get smaller than
+// that. VGA stays on one thread, 1080p uses up to seven.
+const int MinBandPixels = 256 * 1024;
+
+// Rows of preview blocks converted before they are shrunk. Small enough for
+// the converted rows to still be in L2 when they are read again.
+const int PreviewChunkBlocks = 8;
+
+} // end namespace
+
+class DSConversionBand : public QRunnable
+{
+public:
+    DSConversionBand(QSemaphore *done)
+        : job(0)
+        , firstRow(0)
+        , rows(0)
+        , m_done(done)
+    {
+        // owned by DSBandConverter and reused for every frame
+        setAutoDelete(false);
+    }
+
+    void run()
+    {
+        job->convertRows(firstRow, rows);
+        m_done->release();
+    }
+
+    const DSConversionJob *job;
+    int firstRow;
+    int rows;
+
+private:
+    QSemaphore *m_done;
+};
+
+void DSConversionJob::convertRows(int firstRow, int rows) const
+{
+    if (!preview) {
+        runKernel(firstRow, rows);
+        return;
+    }
+
+    // Shrinking a few rows right after converting them saves reading the
+    // whole frame back from memory. firstRow is a multiple of previewFactor.
+    const int chunk = previewFactor * PreviewChunkBlocks;
+    const int end = firstRow + rows;
+    for (int row = firstRow; row < end; row += chunk) {
+        const int chunkRows = qMin(chunk, end - row);
+        runKernel(row, chunkRows);
+        DSFrameConverter::downscaleBox(dst + qptrdiff(row) * dstStride, dstStride,
+                                       preview + qptrdiff(row / previewFactor) * previewStride,
+                                       previewStride, width, chunkRows, dstChannels(),
+                                       previewFactor);
+    }
+}
+
+void DSConversionJob::runKernel(int firstRow, int rows) const
+{
+    // Strides may be negative, the offsets work out the same either way.
+    const quint8 *bandSrc = src + qptrdiff(firstRow) * srcStride;
+    quint8 *bandDst = dst + qptrdiff(firstRow) * dstStride;
+
+    switch (kind) {
+    case Bgr24ToRgb24:
+        DSFrameConverter::bgr24ToRgb24(bandSrc, srcStride, bandDst, dstStride, width, rows);
+        break;
+    case Bgr32ToRgb24:
+        DSFrameConverter::bgr32ToRgb24(bandSrc, srcStride, bandDst, dstStride, width, rows);
+        break;
+    case Rgb555ToRgb24:
+        DSFrameConverter::rgb555ToRgb24(bandSrc, srcStride, bandDst, dstStride, width, rows);
+        break;
+    case Yuy2ToRgb24:
+        DSFrameConverter::yuy2ToRgb24(bandSrc, srcStride, bandDst, dstStride, width, rows, *matrix, bgr);
+        break;
+    case UyvyToRgb24:
+        DSFrameConverter::uyvyToRgb24(bandSrc, srcStride, bandDst, dstStride, width, rows, *matrix, bgr);
+        break;
+    case I420ToRgb24:
+        DSFrameConverter::i420ToRgb24(bandSrc, srcStride,
+                                      srcU + qptrdiff(firstRow / 2) * srcUVStride,
+                                      srcV + qptrdiff(firstRow / 2) * srcUVStride, srcUVStride,
+                                      bandDst, dstStride, width, rows, *matrix, bgr);
+        break;
+    case Nv12ToRgb24:
+        DSFrameConverter::nv12ToRgb24(bandSrc, srcStride,
+                                      srcU + qptrdiff(firstRow / 2) * srcUVStride, srcUVStride,
+                                      bandDst, dstStride, width, rows, *matrix, bgr);
+        break;
+    case Yuy2ToLuma:
+        DSFrameConverter::yuy2ToLuma(bandSrc, srcStride, bandDst, dstStride, width, rows);
+        break;
+    case UyvyToLuma:
+        DSFrameConverter::uyvyToLuma(bandSrc, srcStride, bandDst, dstStride, width, rows);
+        break;
+    case PlaneToLuma:
+        DSFrameConverter::copyPlane(bandSrc, srcStride, bandDst, dstStride, width, rows);
+        break;
+    }
+}
+
+DSBandConverter::DSBandConverter(int threadCount)
+    : m_threadCount(0)
+{
+    setThreadCount(threadCount);
+}
+
+DSBandConverter::~DSBandConverter()
+{
+    m_pool.waitForDone();
+    qDeleteAll(m_bands);
+}
+
+void DSBandConverter::setThreadCount(int threadCount)
+{
+    if (threadCount <= 0)
+        threadCount = qMax(1, QThread::idealThreadCount());
+    m_threadCount = threadCount;
+
+    // the calling thread converts one band itself
+    m_pool.setMaxThreadCount(qMax(1, threadCount - 1));
+}
+
+int DSBandConverter::bandCount(const DSConversionJob &job) const
+{
+    const qint64 pixels = qint64(job.width) * job.height;
+    const int bands = int(qMin<qint64>(pixels / MinBandPixels, m_threadCount));
+    const int align = job.rowAlignment();
+    return qBound(1, bands, qMax(1, (job.height + align - 1) / align));
+}
+
+void DSBandConverter::run(const DSConversionJob &job)
+{
+    const int bands = bandCount(job);
+    if (bands == 1) {
+        job.convertRows(0, job.height);
+        return;
+    }
+
+    while (m_bands.size() < bands - 1)
+        m_bands.append(new DSConversionBand(&m_done));
+
+    // Split in units of rowAlignment() rows and spread the remainder so band
+    // sizes differ by at most one unit. The last band may end short.
+    const int align = job.rowAlignment();
+    const int units = (job.height + align - 1) / align;
+    const int unitsPerBand = units / bands;
+    const int extraUnits = units % bands;
+    const int firstRows = (unitsPerBand + (extraUnits > 0 ? 1 : 0)) * align;
+
+    int row = firstRows;
+    for (int i = 1; i < bands; ++i) {
+        DSConversionBand *band = m_bands.at(i - 1);
+        band->job = &job;
+        band->firstRow = row;
+        band->rows = qMin((unitsPerBand + (i < extraUnits ? 1 : 0)) * align, job.height - row);
+        row += band->rows;
+        m_pool.start(band);
+    }
+
+    job.convertRows(0, firstRows);
+    m_done.acquire(bands - 1);
+}
+
+QT_END_NAMESPACE
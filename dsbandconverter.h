@@ -0,0 +1,163 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSBANDCONVERTER_H
+#define DSBANDCONVERTER_H
+
+#include <QtCore/qglobal.h>
+#include <QtCore/qthreadpool.h>
+#include <QtCore/qsemaphore.h>
+#include <QtCore/qvector.h>
+
+#include "dsframeconverter.h"
+
+QT_BEGIN_NAMESPACE
+
+class DSConversionBand;
+
+// One frame worth of work for a DSFrameConverter kernel. Every kernel converts
+// rows independently, so any range of rows can be handed to a different core.
+struct DSConversionJob
+{
+    enum Kind {
+        Bgr24ToRgb24,
+        Bgr32ToRgb24,
+        Rgb555ToRgb24,
+        Yuy2ToRgb24,
+        UyvyToRgb24,
+        I420ToRgb24,
+        Nv12ToRgb24,
+        Yuy2ToLuma,
+        UyvyToLuma,
+        PlaneToLuma     // the Y plane of I420 or NV12
+    };
+
+    DSConversionJob()
+        : kind(Bgr24ToRgb24)
+        , src(0)
+        , srcStride(0)
+        , srcU(0)
+        , srcV(0)
+        , srcUVStride(0)
+        , dst(0)
+        , dstStride(0)
+        , width(0)
+        , height(0)
+        , matrix(0)
+        , bgr(false)
+        , preview(0)
+        , previewStride(0)
+        , previewFactor(0)
+    {
+    }
+
+    // Bands of 4:2:0 formats have to start on an even row, where a new row
+    // of chroma begins, bands with a preview on a row of preview blocks.
+    int rowAlignment() const
+    {
+        const int chroma = kind == I420ToRgb24 || kind == Nv12ToRgb24 ? 2 : 1;
+        return preview ? qMax(chroma, previewFactor) : chroma;
+    }
+
+    // 3 for RGB24 output, 1 for luma
+    int dstChannels() const
+    {
+        return kind == Yuy2ToLuma || kind == UyvyToLuma || kind == PlaneToLuma ? 1 : 3;
+    }
+
+    void convertRows(int firstRow, int rows) const;
+
+    Kind kind;
+    const quint8 *src;      // packed pixels or the Y plane
+    int srcStride;
+    const quint8 *srcU;     // chroma planes; NV12 keeps its U V pairs in srcU
+    const quint8 *srcV;
+    int srcUVStride;
+    quint8 *dst;
+    int dstStride;
+    int width;
+    int height;
+    const DSColorMatrix *matrix;
+    bool bgr;               // YUV kinds write BGR24 instead of RGB24
+
+    // If set, dst is also shrunk by previewFactor (2 or 4) into preview, see
+    // DSFrameConverter::downscaleBox().
+    quint8 *preview;
+    int previewStride;
+    int previewFactor;
+
+private:
+    void runKernel(int firstRow, int rows) const;
+};
+
+// Splits conversions into horizontal bands and runs them on a private thread
+// pool, with the calling thread taking the first band itself. Frames too small
+// to make up for the hand-off stay on the calling thread.
+//
+// run() blocks until the whole frame is converted and must only be called
+// from one thread at a time.
+class DSBandConverter
+{
+public:
+    // threadCount <= 0 uses one thread per core
+    explicit DSBandConverter(int threadCount = 0);
+    ~DSBandConverter();
+
+    void setThreadCount(int threadCount);
+    int threadCount() const { return m_threadCount; }
+
+    // Number of bands run() splits job into.
+    int bandCount(const DSConversionJob &job) const;
+
+    void run(const DSConversionJob &job);
+
+private:
+    Q_DISABLE_COPY(DSBandConverter)
+
+    int m_threadCount;
+    QThreadPool m_pool;
+    QSemaphore m_done;
+    QVector<DSConversionBand *> m_bands;
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,51 @@
+#include "dscameramanager.h"
+#include "dscamerasession.h"
+
+QT_BEGIN_NAMESPACE
+
+DSCameraManager::DSCameraManager(int threadCount, QObject *parent)
+    : QObject(parent)
+    , m_scheduler(threadCount)
+{
+}
+
+DSCameraManager::~DSCameraManager()
+{
+    while (!m_sessions.isEmpty())
+        removeCamera(m_sessions.last());
+}
+
+DSCameraSession *DSCameraManager::addCamera(const QByteArray &device, int priority)
+{
+    DSCameraSession *session = new DSCameraSession(device, this);
+    m_scheduler.add(session->frameProcessor, priority);
+    m_sessions.append(session);
+    return session;
+}
+
+void DSCameraManager::removeCamera(DSCameraSession *session)
+{
+    if (!m_sessions.removeOne(session))
+        return;
+
+    // the processor leaves the pool as the session deletes it, after the
+    // stream is closed
+    delete session;
+}
+
+void DSCameraManager::setPriority(DSCameraSession *session, int priority)
+{
+    m_scheduler.setPriority(session->frameProcessor, priority);
+}
+
+int DSCameraManager::priority(DSCameraSession *session) const
+{
+    return m_scheduler.priority(session->frameProcessor);
+}
+
+DSSchedulerStatistics DSCameraManager::statistics(DSCameraSession *session) const
+{
+    return m_scheduler.statistics(session->frameProcessor);
+}
+
+QT_END_NAMESPACE
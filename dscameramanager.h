@@ -0,0 +1,93 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSCAMERAMANAGER_H
+#define DSCAMERAMANAGER_H
+
+#include <QtCore/qobject.h>
+#include <QtCore/qlist.h>
+
+#include "dsframescheduler.h"
+
+QT_BEGIN_NAMESPACE
+
+class DSCameraSession;
+
+// Owns the sessions of many cameras on one host and processes all their
+// frames on a single DSFrameScheduler sized to the machine, instead of a
+// worker thread and a conversion thread pool per camera. Frames are still
+// emitted by each session, from the pool's threads.
+//
+// Priorities weigh the processing time a camera gets once the pool cannot
+// keep up with all of them; a 4K camera then gets its share without starving
+// the VGA ones next to it. Cameras whose frames wait too long lose them as
+// their backpressure policy says.
+class DSCameraManager : public QObject
+{
+    Q_OBJECT
+public:
+    // threadCount <= 0 uses one thread per core
+    explicit DSCameraManager(int threadCount = 0, QObject *parent = 0);
+    ~DSCameraManager();
+
+    // Opens device, see DSCameraSession; the manager owns the session.
+    DSCameraSession *addCamera(const QByteArray &device, int priority = 1);
+    // Closes and deletes session.
+    void removeCamera(DSCameraSession *session);
+    QList<DSCameraSession *> cameras() const { return m_sessions; }
+
+    void setPriority(DSCameraSession *session, int priority);
+    int priority(DSCameraSession *session) const;
+
+    DSSchedulerStatistics statistics(DSCameraSession *session) const;
+
+    DSFrameScheduler *scheduler() { return &m_scheduler; }
+
+private:
+    Q_DISABLE_COPY(DSCameraManager)
+
+    DSFrameScheduler m_scheduler;
+    QList<DSCameraSession *> m_sessions;
+};
+
+QT_END_NAMESPACE
+
+#endif
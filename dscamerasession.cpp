@@ -9,11 +9,10 @@
 
 #include <opencv2/imgproc/imgproc.hpp>
 
-QT_BEGIN_NAMESPACE
+#include <dvdmedia.h>
+#include <setupapi.h>
 
-// If frames come in quicker than we display them, we allow the queue to build
-// up to this number before we start dropping them.
-const int LIMIT_FRAME = 5;
+QT_BEGIN_NAMESPACE
 
 namespace {
 // DirectShow helper implementation
@@ -31,6 +30,327 @@ void _FreeMediaType(AM_MEDIA_TYPE& mt)
     }
 }
 
+// Describes the frames the sample grabber delivers for a negotiated media
+// type. VIDEOINFOHEADER2 may carry the colorimetry in the upper bits of
+// dwControlFlags (DXVA_ExtendedFormat without SampleFormat); otherwise follow
+// the usual convention of BT.709 for HD sizes and BT.601 below, both with
+// limited range.
+DSFrameFormat frameFormatForMediaType(const AM_MEDIA_TYPE& mt)
+{
+    DSFrameFormat format;
+    const BITMAPINFOHEADER *bmi = 0;
+    DWORD controlFlags = 0;
+
+    if (mt.formattype == FORMAT_VideoInfo && mt.cbFormat >= sizeof(VIDEOINFOHEADER)) {
+        bmi = &reinterpret_cast<VIDEOINFOHEADER*>(mt.pbFormat)->bmiHeader;
+    } else if (mt.formattype == FORMAT_VideoInfo2 && mt.cbFormat >= sizeof(VIDEOINFOHEADER2)) {
+        VIDEOINFOHEADER2 *pvi2 = reinterpret_cast<VIDEOINFOHEADER2*>(mt.pbFormat);
+        bmi = &pvi2->bmiHeader;
+        controlFlags = pvi2->dwControlFlags;
+    }
+    if (!bmi)
+        return format;
+
+    format.width = bmi->biWidth;
+    format.height = qAbs(bmi->biHeight);
+    format.sampleSize = qMax<int>(mt.lSampleSize, bmi->biSizeImage);
+
+    // RGB DIBs are bottom-up unless the height is negative and their rows are
+    // DWORD aligned. YUV formats are always top-down with packed rows.
+    if (mt.subtype == MEDIASUBTYPE_RGB24) {
+        format.pixelFormat = DSFrameFormat::BGR24;
+        format.stride = (format.width * 3 + 3) & ~3;
+        format.bottomUp = bmi->biHeight > 0;
+    } else if (mt.subtype == MEDIASUBTYPE_RGB32) {
+        format.pixelFormat = DSFrameFormat::BGR32;
+        format.stride = format.width * 4;
+        format.bottomUp = bmi->biHeight > 0;
+    } else if (mt.subtype == MEDIASUBTYPE_RGB555) {
+        format.pixelFormat = DSFrameFormat::RGB555;
+        format.stride = (format.width * 2 + 3) & ~3;
+        format.bottomUp = bmi->biHeight > 0;
+    } else if (mt.subtype == MEDIASUBTYPE_YUY2 || mt.subtype == MEDIASUBTYPE_YUYV) {
+        format.pixelFormat = DSFrameFormat::YUY2;
+        format.stride = format.width * 2;
+    } else if (mt.subtype == MEDIASUBTYPE_UYVY) {
+        format.pixelFormat = DSFrameFormat::UYVY;
+        format.stride = format.width * 2;
+    } else if (mt.subtype == MEDIASUBTYPE_IYUV || mt.subtype == MEDIASUBTYPE_I420) {
+        format.pixelFormat = DSFrameFormat::I420;
+        format.stride = format.width;
+    } else if (mt.subtype == MEDIASUBTYPE_NV12) {
+        format.pixelFormat = DSFrameFormat::NV12;
+        format.stride = format.width;
+    } else if (mt.subtype == MEDIASUBTYPE_MJPG) {
+        // Compressed frames vary in size and drivers do not always say how
+        // large they get; no sane JPEG outgrows the raw RGB24 frame.
+        format.pixelFormat = DSFrameFormat::MJPG;
+        if (format.sampleSize <= 0)
+            format.sampleSize = format.width * format.height * 3;
+    }
+
+    if (format.height >= 720)
+        format.colorStandard = DSColorMatrix::BT709;
+
+    if (controlFlags & AMCONTROL_COLORINFO_PRESENT) {
+        const DWORD nominalRange = (controlFlags >> 12) & 0x7;
+        const DWORD transferMatrix = (controlFlags >> 15) & 0x7;
+        if (nominalRange == 1) // DXVA_NominalRange_0_255
+            format.colorRange = DSColorMatrix::FullRange;
+        if (transferMatrix == 1) // DXVA_VideoTransferMatrix_BT709
+            format.colorStandard = DSColorMatrix::BT709;
+        else if (transferMatrix == 2) // DXVA_VideoTransferMatrix_BT601
+            format.colorStandard = DSColorMatrix::BT601;
+    }
+
+    return format;
+}
+
+// Something that changes whenever the device's driver does: version, date
+// and provider from the driver key of the device behind its DevicePath. Filters
+// that are no PnP devices, virtual cameras for one, have no device path and
+// are told apart by their CLSID alone.
+QByteArray driverIdentity(IPropertyBag *propertyBag)
+{
+    QByteArray identity;
+    VARIANT var;
+
+    VariantInit(&var);
+    if (SUCCEEDED(propertyBag->Read(L"CLSID", &var, 0)) && var.vt == VT_BSTR)
+        identity = QString::fromWCharArray(var.bstrVal).toUtf8();
+    VariantClear(&var);
+
+    if (FAILED(propertyBag->Read(L"DevicePath", &var, 0)) || var.vt != VT_BSTR) {
+        VariantClear(&var);
+        return identity;
+    }
+
+    HDEVINFO deviceInfoSet = SetupDiCreateDeviceInfoList(NULL, NULL);
+    if (deviceInfoSet == INVALID_HANDLE_VALUE) {
+        VariantClear(&var);
+        return identity;
+    }
+
+    SP_DEVICE_INTERFACE_DATA interfaceData;
+    interfaceData.cbSize = sizeof(interfaceData);
+    SP_DEVINFO_DATA deviceInfo;
+    deviceInfo.cbSize = sizeof(deviceInfo);
+    DWORD detailSize = 0;
+    if (SetupDiOpenDeviceInterfaceW(deviceInfoSet, var.bstrVal, 0, &interfaceData)) {
+        SetupDiGetDeviceInterfaceDetailW(deviceInfoSet, &interfaceData, NULL, 0, &detailSize, NULL);
+        QByteArray detailBuffer(int(qMax<DWORD>(detailSize, sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA_W))), 0);
+        SP_DEVICE_INTERFACE_DETAIL_DATA_W *detail =
+                reinterpret_cast<SP_DEVICE_INTERFACE_DETAIL_DATA_W *>(detailBuffer.data());
+        detail->cbSize = sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA_W);
+        if (SetupDiGetDeviceInterfaceDetailW(deviceInfoSet, &interfaceData, detail,
+                                             detailBuffer.size(), NULL, &deviceInfo)) {
+            HKEY key = SetupDiOpenDevRegKey(deviceInfoSet, &deviceInfo, DICS_FLAG_GLOBAL, 0,
+                                            DIREG_DRV, KEY_READ);
+            if (key != INVALID_HANDLE_VALUE) {
+                static const wchar_t *const values[] = { L"DriverVersion", L"DriverDate", L"ProviderName" };
+                for (int i = 0; i < 3; ++i) {
+                    wchar_t value[256];
+                    DWORD type = 0;
+                    DWORD size = sizeof(value) - sizeof(wchar_t);
+                    if (RegQueryValueExW(key, values[i], NULL, &type, reinterpret_cast<BYTE *>(value), &size) == ERROR_SUCCESS
+                            && type == REG_SZ) {
+                        value[size / sizeof(wchar_t)] = 0;
+                        identity += '/' + QString::fromWCharArray(value).toUtf8();
+                    }
+                }
+                RegCloseKey(key);
+            }
+        }
+    }
+
+    SetupDiDestroyDeviceInfoList(deviceInfoSet);
+    VariantClear(&var);
+    return identity;
+}
+
+// Every stream capability of the capture pin of filter, the slow part of
+// opening a device.
+bool streamCapabilities(ICaptureGraphBuilder2 *builder, IBaseFilter *filter, QList<DSDeviceFormat> *formats)
+{
+    HRESULT hr;
+    AM_MEDIA_TYPE *pmt = NULL;
+    VIDEOINFOHEADER *pvi = NULL;
+    VIDEO_STREAM_CONFIG_CAPS scc;
+    IAMStreamConfig* pConfig = 0;
+
+    if(FAILED(hr = builder->FindInterface(&PIN_CATEGORY_CAPTURE, &MEDIATYPE_Video, filter,
+                               IID_IAMStreamConfig, (void**)&pConfig)))
+    {
+        qWarning()<<"failed to get config on capture device";
+        return false;
+    }
+
+    int iCount;
+    int iSize;
+    if(FAILED(hr = pConfig->GetNumberOfCapabilities(&iCount, &iSize))) {
+        qWarning() << "failed to get capabilities";
+        pConfig->Release();
+        return false;
+    }
+
+    formats->clear();
+
+    for (int iIndex = 0; iIndex < iCount; iIndex++)
+    {
+        if(SUCCEEDED(hr = pConfig->GetStreamCaps(iIndex, &pmt, reinterpret_cast<BYTE*>(&scc)))) {
+            pvi = (VIDEOINFOHEADER*)pmt->pbFormat;
+            if ((pmt->majortype == MEDIATYPE_Video) &&
+                    (pmt->formattype == FORMAT_VideoInfo))
+            {
+                // save each format available from the camera
+                DSDeviceFormat format;
+                format.width = pvi->bmiHeader.biWidth;
+                format.height = pvi->bmiHeader.biHeight;
+                // AvgTimePerFrame is in 100 ns units, 0 if the driver leaves it open
+                format.frameRate = pvi->AvgTimePerFrame > 0 ? 10000000.0 / pvi->AvgTimePerFrame : 0;
+                if(pmt->subtype == MEDIASUBTYPE_RGB24) {
+                    format.pixelFormat = DSFrameFormat::BGR24;
+                } else if(pmt->subtype == MEDIASUBTYPE_RGB32) {
+                    format.pixelFormat = DSFrameFormat::BGR32;
+                } else if(pmt->subtype == MEDIASUBTYPE_YUY2) {
+                    format.pixelFormat = DSFrameFormat::YUY2;
+                } else if(pmt->subtype == MEDIASUBTYPE_MJPG) {
+                    format.pixelFormat = DSFrameFormat::MJPG;
+                } else if(pmt->subtype == MEDIASUBTYPE_I420) {
+                    format.pixelFormat = DSFrameFormat::I420;
+                } else if(pmt->subtype == MEDIASUBTYPE_NV12) {
+                    format.pixelFormat = DSFrameFormat::NV12;
+                } else if(pmt->subtype == MEDIASUBTYPE_RGB555) {
+                    format.pixelFormat = DSFrameFormat::RGB555;
+                } else if(pmt->subtype == MEDIASUBTYPE_UYVY) {
+                    format.pixelFormat = DSFrameFormat::UYVY;
+                } else if(pmt->subtype == MEDIASUBTYPE_H263) {
+                    qWarning() << "QVideoFrame does not have format for H263, frameSize: " << QSize(pvi->bmiHeader.biWidth, pvi->bmiHeader.biHeight);
+                } else {
+                    qWarning() << "UNKNOWN FORMAT: " << pmt->subtype.Data1 << " frameSize: " << QSize(pvi->bmiHeader.biWidth, pvi->bmiHeader.biHeight);
+                }
+                if (format.pixelFormat != DSFrameFormat::Invalid)
+                    formats->append(format);
+            }
+            _FreeMediaType(*pmt);
+            CoTaskMemFree(pmt);
+        }
+    }
+    pConfig->Release();
+    return true;
+}
+
+QList<QVideoSurfaceFormat> surfaceFormats(const QList<DSDeviceFormat> &formats)
+{
+    QList<QVideoSurfaceFormat> surfaceFormats;
+    foreach (const DSDeviceFormat &format, formats) {
+        QVideoFrame::PixelFormat pixelFormat = QVideoFrame::Format_Invalid;
+        switch (format.pixelFormat) {
+        case DSFrameFormat::BGR24:
+            pixelFormat = QVideoFrame::Format_RGB24;
+            break;
+        case DSFrameFormat::BGR32:
+            pixelFormat = QVideoFrame::Format_RGB32;
+            break;
+        case DSFrameFormat::RGB555:
+            pixelFormat = QVideoFrame::Format_RGB555;
+            break;
+        case DSFrameFormat::YUY2:
+            pixelFormat = QVideoFrame::Format_YUYV;
+            break;
+        case DSFrameFormat::UYVY:
+            pixelFormat = QVideoFrame::Format_UYVY;
+            break;
+        case DSFrameFormat::I420:
+            pixelFormat = QVideoFrame::Format_YUV420P;
+            break;
+        case DSFrameFormat::NV12:
+            pixelFormat = QVideoFrame::Format_NV12;
+            break;
+        case DSFrameFormat::MJPG:
+            pixelFormat = QVideoFrame::Format_User;
+            break;
+        default:
+            continue;
+        }
+        QVideoSurfaceFormat sfmt(QSize(format.width, format.height), pixelFormat);
+        sfmt.setFrameRate(format.frameRate);
+        surfaceFormats.append(sfmt);
+    }
+    return surfaceFormats;
+}
+
+// Revalidates DSCapabilityCache entries on the cache's thread, with a filter
+// and graph builder of its own; the session's belong to its apartment.
+class DirectShowCapabilityProvider : public DSCapabilityProvider
+{
+public:
+    bool query(const QByteArray &device, DSDeviceCapabilities *capabilities)
+    {
+        HRESULT hr;
+        ICreateDevEnum* pDevEnum = NULL;
+        IEnumMoniker* pEnum = NULL;
+        IMoniker* pMoniker = NULL;
+        IBaseFilter* pFilter = NULL;
+        ICaptureGraphBuilder2* pBuilder = NULL;
+        bool found = false;
+
+        CoInitialize(NULL);
+
+        if(SUCCEEDED(hr = CoCreateInstance(CLSID_SystemDeviceEnum, NULL,
+                CLSCTX_INPROC_SERVER, IID_ICreateDevEnum,
+                reinterpret_cast<void**>(&pDevEnum))))
+        {
+            if(pDevEnum->CreateClassEnumerator(CLSID_VideoInputDeviceCategory, &pEnum, 0) == S_OK) {
+                IMalloc *mallocInterface = 0;
+                CoGetMalloc(1, (LPMALLOC*)&mallocInterface);
+                while (!found && pEnum->Next(1, &pMoniker, NULL) == S_OK) {
+                    BSTR strName = 0;
+                    if(SUCCEEDED(hr = pMoniker->GetDisplayName(NULL, NULL, &strName))) {
+                        QString output(QString::fromWCharArray(strName));
+                        mallocInterface->Free(strName);
+                        if (output.toUtf8() == device) {
+                            capabilities->device = device;
+                            capabilities->description = output;
+                            IPropertyBag *pPropBag;
+                            if(SUCCEEDED(hr = pMoniker->BindToStorage(0, 0, IID_IPropertyBag, (void**)(&pPropBag)))) {
+                                VARIANT varName;
+                                varName.vt = VT_BSTR;
+                                if(SUCCEEDED(hr = pPropBag->Read(L"FriendlyName", &varName, 0)))
+                                    capabilities->description = QString::fromWCharArray(varName.bstrVal);
+                                capabilities->driver = driverIdentity(pPropBag);
+                                pPropBag->Release();
+                            }
+                            found = SUCCEEDED(pMoniker->BindToObject(0, 0, IID_IBaseFilter, (void**)&pFilter));
+                        }
+                    }
+                    pMoniker->Release();
+                }
+                mallocInterface->Release();
+                pEnum->Release();
+            }
+            pDevEnum->Release();
+        }
+
+        if (found) {
+            found = SUCCEEDED(CoCreateInstance(CLSID_CaptureGraphBuilder2, NULL, CLSCTX_INPROC,
+                                               IID_ICaptureGraphBuilder2, (void**)&pBuilder))
+                    && streamCapabilities(pBuilder, pFilter, &capabilities->formats);
+        }
+
+        SAFE_RELEASE(pBuilder);
+        SAFE_RELEASE(pFilter);
+        CoUninitialize();
+        return found;
+    }
+};
+
+DirectShowCapabilityProvider *capabilityProvider()
+{
+    static DirectShowCapabilityProvider provider;
+    return &provider;
+}
+
 } // end namespace
 
 class SampleGrabberCallbackPrivate : public ISampleGrabberCB
@@ -61,71 +381,10 @@ public:
         return E_NOTIMPL;
     }
 
-    /*
     STDMETHODIMP BufferCB(double Time, BYTE *pBuffer, long BufferLen)
     {
-        qDebug() << "buffercb" << active << toggle;
-        if (!cs || active) {
-            return S_OK;
-        }
+        const qint64 arrivalTime = DSLatencyTracer::now();
 
-        if ((cs->StillMediaType.majortype != MEDIATYPE_Video) ||
-                (cs->StillMediaType.formattype != FORMAT_VideoInfo) ||
-                (cs->StillMediaType.cbFormat < sizeof(VIDEOINFOHEADER))) {
-            return VFW_E_INVALIDMEDIATYPE;
-        }
-
-        active = true;
-
-        toggle = !toggle;
-
-        if(toggle) {
-            active = false;
-            return S_OK;
-        }
-
-        bool check = false;
-        cs->mutex.lock();
-
-        qDebug() << "frames" << cs->frames.size();
-
-        if (cs->frames.size() > LIMIT_FRAME) {
-            check = true;
-        }
-
-        if (check) {
-            cs->mutex.unlock();
-            // Frames building up. We're going to drop some here
-            Sleep(100);
-            active = false;
-            return S_OK;
-        }
-        cs->mutex.unlock();
-
-        unsigned char* vidData = new unsigned char[BufferLen];
-        memcpy(vidData, pBuffer, BufferLen);
-
-        cs->mutex.lock();
-
-        video_buffer* buf = new video_buffer;
-        buf->buffer = vidData;
-        buf->length = BufferLen;
-        buf->time   = (qint64)Time;
-
-        cs->frames.append(buf);
-
-        cs->mutex.unlock();
-
-        QMetaObject::invokeMethod(cs, "captureFrame", Qt::QueuedConnection);
-
-        active = false;
-
-        return S_OK;
-    }
-    */
-
-    STDMETHODIMP BufferCB(double Time, BYTE *pBuffer, long BufferLen)
-    {
         if (!cs) {
             return S_OK;
         }
@@ -136,39 +395,38 @@ public:
             return VFW_E_INVALIDMEDIATYPE;
         }
 
-        cs->mutex.lock();
-
         /*
         VIDEOINFOHEADER *pvi = NULL;
         pvi = (VIDEOINFOHEADER*)cs->StillMediaType.pbFormat;
         qDebug() << "width, height:" << pvi->bmiHeader.biWidth << pvi->bmiHeader.biHeight;
         */
 
-        qDebug() << "frame time" << Time;
-
-        if(cs->mCaptureNextFrame)
+        if(cs->mStreaming.load() || cs->isRecording() || cs->mCaptureNextFrame.testAndSetOrdered(1, 0))
         {
-            cs->mCaptureNextFrame = false;
+            DSFrameHandle buf = cs->frameProcessor->acquireBuffer();
+            if (!buf.isNull() && BufferLen > buf->capacity)
+                buf.reset();
 
-            unsigned char* vidData = new unsigned char[BufferLen];
-            memcpy(vidData, pBuffer, BufferLen);
+            if (buf.isNull()) {
+                qWarning() << "dropping frame, no buffer for" << BufferLen << "bytes";
+                return S_OK;
+            }
 
-            video_buffer* buf = new video_buffer;
-            buf->buffer = vidData;
+            memcpy(buf->data, pBuffer, BufferLen);
             buf->length = BufferLen;
-            buf->time   = (qint64)Time;
+            // Time is the sample's stream time in seconds, at 100 ns resolution
+            buf->time   = qRound64(Time * 1e9);
+            buf->arrivalTime = arrivalTime;
 
-            cs->frames.append(buf);
-
-            QMetaObject::invokeMethod(cs, "captureFrame", Qt::QueuedConnection);
+            // If the consumer fell behind, the backpressure policy decides
+            // which frame goes; drops are counted in frameDropStatistics().
+            cs->frameProcessor->pushFrame(buf);
         }
         //else
         //{
             //qDebug() << "dropping frame" << Time;
         //}
 
-        cs->mutex.unlock();
-
         return S_OK;
     }
 
@@ -179,7 +437,7 @@ public:
 
 DSCameraSession::DSCameraSession(const QByteArray &device, QObject *parent)
     : QObject(parent)
-      ,m_currentImageId(0), mCaptureNextFrame(true)
+      ,m_currentImageId(0), mCaptureNextFrame(true), mStreaming(false)
 {
     pBuild = NULL;
     pGraph = NULL;
@@ -195,17 +453,36 @@ DSCameraSession::DSCameraSession(const QByteArray &device, QObject *parent)
     m_state = QCamera::UnloadedState;
     m_device = "default";
 
-    enumerateDevices(&m_devices, &m_descriptions);
+    enumerateDevices(&m_devices, &m_descriptions, &m_drivers);
 
     if(m_devices.contains(device))
         m_device = device;
 
+    // "default" opens the first device there is.
+    const int deviceIndex = m_device == "default" ? 0 : m_devices.indexOf(m_device);
+    if (deviceIndex >= 0 && deviceIndex < m_devices.size()) {
+        m_cacheDevice = m_devices.at(deviceIndex);
+        m_cacheDriver = m_drivers.at(deviceIndex);
+    }
+    connect(DSCapabilityCache::defaultCache(), SIGNAL(capabilitiesChanged(QByteArray)),
+            this, SLOT(cachedPropertiesChanged(QByteArray)));
+
+    frameProcessor = new DSFrameProcessor;
+    connect(frameProcessor, SIGNAL(cvFrameCaptured(cv::Mat)), this, SIGNAL(cvFrameCaptured(cv::Mat)));
+    connect(frameProcessor, SIGNAL(previewFrameCaptured(cv::Mat)), this, SIGNAL(previewFrameCaptured(cv::Mat)));
+    connect(frameProcessor, SIGNAL(regionCaptured(int,cv::Mat)), this, SIGNAL(regionCaptured(int,cv::Mat)));
+    connect(frameProcessor, SIGNAL(subscriptionFrameCaptured(int,cv::Mat)),
+            this, SIGNAL(subscriptionFrameCaptured(int,cv::Mat)));
+    m_recorder = new DSFrameRecorder;
+    frameProcessor->setRecorder(m_recorder);
+
     StillCapCB = new SampleGrabberCallbackPrivate;
     StillCapCB->cs = this;
     StillCapCB->active = false;
     StillCapCB->toggle = false;
 
     m_surface = 0;
+    m_source = 0;
 
     graph = createFilterGraph();
     active = false;
@@ -213,6 +490,10 @@ DSCameraSession::DSCameraSession(const QByteArray &device, QObject *parent)
 
 DSCameraSession::~DSCameraSession()
 {
+    // The source's thread pushes into frameProcessor until it has stopped.
+    if (m_source)
+        m_source->stop();
+
     if (opened) {
         closeStream();
     }
@@ -227,6 +508,9 @@ DSCameraSession::~DSCameraSession()
     if (StillCapCB) {
         delete StillCapCB;
     }
+
+    delete frameProcessor;
+    delete m_recorder;
 }
 
 int DSCameraSession::captureImage(const QString &fileName)
@@ -243,6 +527,163 @@ void DSCameraSession::setSurface(QAbstractVideoSurface* surface)
     m_surface = surface;
 }
 
+void DSCameraSession::setFrameSource(DSFrameSource *source)
+{
+    if (m_source == source)
+        return;
+
+    if (m_source) {
+        m_source->stop();
+        active = false;
+    }
+    m_source = source;
+}
+
+DSFrameSource *DSCameraSession::frameSource() const
+{
+    return m_source;
+}
+
+DSFramePoolStatistics DSCameraSession::framePoolStatistics() const
+{
+    return frameProcessor->inputPoolStatistics();
+}
+
+void DSCameraSession::setWorkerThreadEnabled(bool enabled)
+{
+    frameProcessor->setWorkerThreadEnabled(enabled);
+}
+
+bool DSCameraSession::isWorkerThreadEnabled() const
+{
+    return frameProcessor->isWorkerThreadEnabled();
+}
+
+void DSCameraSession::setConversionThreadCount(int threadCount)
+{
+    frameProcessor->setConversionThreadCount(threadCount);
+}
+
+int DSCameraSession::conversionThreadCount() const
+{
+    return frameProcessor->conversionThreadCount();
+}
+
+void DSCameraSession::setStreamingEnabled(bool enabled)
+{
+    mStreaming.store(enabled);
+}
+
+bool DSCameraSession::isStreamingEnabled() const
+{
+    return mStreaming.load();
+}
+
+void DSCameraSession::setQueueDepth(int depth)
+{
+    frameProcessor->setQueueDepth(depth);
+}
+
+int DSCameraSession::queueDepth() const
+{
+    return frameProcessor->queueDepth();
+}
+
+void DSCameraSession::setBackpressurePolicy(DSFrameProcessor::BackpressurePolicy policy, int timeout)
+{
+    frameProcessor->setBackpressurePolicy(policy, timeout);
+}
+
+DSFrameProcessor::BackpressurePolicy DSCameraSession::backpressurePolicy() const
+{
+    return frameProcessor->backpressurePolicy();
+}
+
+void DSCameraSession::setOutputFormat(DSFrameProcessor::OutputFormat format)
+{
+    frameProcessor->setOutputFormat(format);
+}
+
+DSFrameProcessor::OutputFormat DSCameraSession::outputFormat() const
+{
+    return frameProcessor->outputFormat();
+}
+
+void DSCameraSession::setJpegScale(int scale)
+{
+    frameProcessor->setJpegScale(scale);
+}
+
+int DSCameraSession::jpegScale() const
+{
+    return frameProcessor->jpegScale();
+}
+
+void DSCameraSession::setJpegRegion(const QRect &region)
+{
+    frameProcessor->setJpegRegion(region);
+}
+
+QRect DSCameraSession::jpegRegion() const
+{
+    return frameProcessor->jpegRegion();
+}
+
+void DSCameraSession::setPreviewScale(int scale)
+{
+    frameProcessor->setPreviewScale(scale);
+}
+
+int DSCameraSession::previewScale() const
+{
+    return frameProcessor->previewScale();
+}
+
+void DSCameraSession::setRegionsOfInterest(const QList<QRect> &regions)
+{
+    frameProcessor->setRegionsOfInterest(regions);
+}
+
+QList<QRect> DSCameraSession::regionsOfInterest() const
+{
+    return frameProcessor->regionsOfInterest();
+}
+
+int DSCameraSession::subscribe(const DSFrameProcessor::Subscription &subscription)
+{
+    return frameProcessor->subscribe(subscription);
+}
+
+void DSCameraSession::unsubscribe(int id)
+{
+    frameProcessor->unsubscribe(id);
+}
+
+DSFrameDropStatistics DSCameraSession::frameDropStatistics() const
+{
+    return frameProcessor->dropStatistics();
+}
+
+void DSCameraSession::setLatencyTracingEnabled(bool enabled)
+{
+    frameProcessor->latencyTracer()->setEnabled(enabled);
+}
+
+bool DSCameraSession::isLatencyTracingEnabled() const
+{
+    return frameProcessor->latencyTracer()->isEnabled();
+}
+
+DSLatencyStatistics DSCameraSession::latencyStatistics(DSLatencyTracer::Stage stage) const
+{
+    return frameProcessor->latencyTracer()->statistics(stage);
+}
+
+void DSCameraSession::resetLatencyStatistics()
+{
+    frameProcessor->latencyTracer()->reset();
+}
+
 bool DSCameraSession::deviceReady()
 {
     return available;
@@ -263,6 +704,38 @@ void DSCameraSession::setFormat(QVideoSurfaceFormat format)
     actualFormat = format;
 }
 
+bool DSCameraSession::negotiateFormat(const QSize &size, qreal frameRate, DSFrameProcessor::OutputFormat output)
+{
+    DSFormatRequest request;
+    request.size = size;
+    request.frameRate = frameRate;
+    request.outputFormat = output;
+
+    DSDeviceFormat chosen;
+    const bool reachesRate = m_negotiator.negotiate(m_deviceFormats, request, &chosen);
+    if (chosen.pixelFormat == DSFrameFormat::Invalid) {
+        qWarning() << "no format of size" << size;
+        return false;
+    }
+    if (!reachesRate)
+        qWarning() << "no format of size" << size << "reaches" << frameRate << "fps, taking" << chosen.frameRate;
+
+    QList<DSDeviceFormat> formats;
+    formats << chosen;
+    QVideoSurfaceFormat format = surfaceFormats(formats).first();
+    if (frameRate > 0 && frameRate < chosen.frameRate)
+        format.setFrameRate(frameRate);
+
+    setFormat(format);
+    setOutputFormat(output);
+    return reachesRate;
+}
+
+DSFormatNegotiator *DSCameraSession::formatNegotiator()
+{
+    return &m_negotiator;
+}
+
 QVideoSurfaceFormat DSCameraSession::format()
 {
     return actualFormat;
@@ -270,7 +743,27 @@ QVideoSurfaceFormat DSCameraSession::format()
 
 qint64 DSCameraSession::position() const
 {
-    return timeStamp.elapsed();
+    // milliseconds of stream time since startStream(), by the frames' own
+    // time stamps
+    const DSFramePacingStatistics pacing = frameProcessor->arrivalPacing();
+    if (!pacing.frames)
+        return 0;
+    return (pacing.lastCaptureTime - pacing.firstCaptureTime) / 1000000;
+}
+
+DSFramePacingStatistics DSCameraSession::arrivalPacing() const
+{
+    return frameProcessor->arrivalPacing();
+}
+
+DSFramePacingStatistics DSCameraSession::emitPacing() const
+{
+    return frameProcessor->emitPacing();
+}
+
+void DSCameraSession::resetPacingStatistics()
+{
+    frameProcessor->resetPacingStatistics();
 }
 
 int DSCameraSession::state() const
@@ -283,97 +776,66 @@ void DSCameraSession::pause()
     suspendStream();
 }
 
-void DSCameraSession::stop()
+bool DSCameraSession::setOutputLocation(const QUrl &sink)
 {
-    if(!opened) {
-        return;
+    if (!sink.isEmpty() && !sink.isLocalFile()) {
+        qWarning() << "only local files can be recorded to" << sink;
+        return false;
     }
 
-    stopStream();
-    opened = false;
+    m_sink = sink;
+    return true;
 }
 
-void DSCameraSession::captureFrame()
+QUrl DSCameraSession::outputLocation() const
 {
-    if(frames.count())
-    {
-        cv::Mat flipped, dst;
-        VIDEOINFOHEADER *pvi = NULL;
-
-        if(StillMediaType.subtype == MEDIASUBTYPE_RGB24) {
-            mutex.lock();
-
-            video_buffer* buf = frames.takeFirst();
-
-            pvi = (VIDEOINFOHEADER*)StillMediaType.pbFormat;
-
-            cv::Mat image(cv::Size(pvi->bmiHeader.biWidth, pvi->bmiHeader.biHeight), CV_8UC3, buf->buffer);
-            cv::flip(image, flipped, 0);
-            cv::cvtColor(flipped, dst, CV_BGR2RGB);
-
-            delete buf->buffer;
-            delete buf;
-
-            mutex.unlock();
-
-            emit cvFrameCaptured(dst);
-        }
-        else if(StillMediaType.subtype == MEDIASUBTYPE_YUY2 || StillMediaType.subtype == MEDIASUBTYPE_YUYV)
-        {
-            mutex.lock();
-
-            pvi = (VIDEOINFOHEADER*)StillMediaType.pbFormat;
-
-            quint8 *imgbuf = new quint8[pvi->bmiHeader.biWidth * pvi->bmiHeader.biHeight * 3];
-
-            cv::Mat image(cv::Size(pvi->bmiHeader.biWidth, pvi->bmiHeader.biHeight), CV_8UC3, imgbuf);
-
-            quint8 *pp;
-
-            video_buffer* buf = frames.takeFirst();
-
-            int j=0;
-            for(int i=0; i<buf->length; i+=4)
-            {
-                pp = reinterpret_cast<quint8*>(buf->buffer+i);
-                *reinterpret_cast<quint32*>(image.data+j) = yuv2rgb(pp[0], pp[1], pp[3]);
-                *reinterpret_cast<quint32*>(image.data+j+3) = yuv2rgb(pp[2], pp[1], pp[3]);
-                j+=6;
-            }
+    return m_sink;
+}
 
-            cv::flip(image, image, 0);
+void DSCameraSession::record()
+{
+    if (m_recorder->isRecording())
+        return;
 
-            delete buf->buffer;
-            delete buf;
+    if (m_sink.isEmpty()) {
+        qWarning() << "no output location to record to";
+        return;
+    }
 
-            mutex.unlock();
+    if (!active && !startStream())
+        return;
 
-            emit cvFrameCaptured(dst);
-        }
+    // Segments are named after the output location, see DSRecordFormat.
+    if (!m_recorder->start(m_sink.toLocalFile(), frameProcessor->format()))
+        qWarning() << "failed to start recording to" << m_sink;
+}
 
-    }
+bool DSCameraSession::isRecording() const
+{
+    return m_recorder->isRecording();
 }
 
-int DSCameraSession::yuv2rgb(int y, int u, int v)
+DSRecorderStatistics DSCameraSession::recorderStatistics() const
 {
-   quint32 pixel32;
-   quint8 *pixel = (unsigned char *)&pixel32;
-   qint32 r, g, b;
+    return m_recorder->statistics();
+}
 
-   r = y + (1.370705 * (v-128));
-   g = y - (0.698001 * (v-128)) - (0.337633 * (u-128));
-   b = y + (1.732446 * (u-128));
+void DSCameraSession::stop()
+{
+    m_recorder->stop();
 
-   r = r>255 ? 255 : r<0 ? 0 : r;
-   g = g>255 ? 255 : g<0 ? 0 : g;
-   b = b>255 ? 255 : b<0 ? 0 : b;
+    // A frame source never opens the graph.
+    if (m_source) {
+        m_source->stop();
+        active = false;
+    }
 
-   pixel[0] = r * 220 / 256;
-   pixel[1] = g * 220 / 256;
-   pixel[2] = b * 220 / 256;
-   pixel[3] = 0;
+    if(!opened) {
+        return;
+    }
 
-   return pixel32;
+    stopStream();
+    opened = false;
 }
 
 HRESULT DSCameraSession::getFilterAndPinInfo(IBaseFilter *pFilter)
@@ -550,15 +1012,21 @@ bool DSCameraSession::createFilterGraph()
     pSG->SetBufferSamples(TRUE);
     pSG->SetCallback(StillCapCB, 1); //0=SampleCB, 1=BufferCB
 
-    updateProperties();
+    // Start from the formats found last time if the driver is still the
+    // same; they are checked again in the background.
+    if (!cachedProperties())
+        updateProperties();
     CoUninitialize();
     return true;
 }
 
-void DSCameraSession::enumerateDevices(QList<QByteArray> *devices, QStringList *descriptions)
+void DSCameraSession::enumerateDevices(QList<QByteArray> *devices, QStringList *descriptions,
+                                       QList<QByteArray> *drivers)
 {
     devices->clear();
     descriptions->clear();
+    if (drivers)
+        drivers->clear();
 
     HRESULT hr;
     CoInitialize(NULL);
@@ -585,6 +1053,7 @@ void DSCameraSession::enumerateDevices(QList<QByteArray> *devices, QStringList *
                     mallocInterface->Free(strName);
                     devices->append(output.toUtf8().constData());
 
+                    QByteArray driver;
                     IPropertyBag *pPropBag;
                     if(SUCCEEDED(hr = pMoniker->BindToStorage(0, 0, IID_IPropertyBag, (void**)(&pPropBag)))) {
                         // Find the description
@@ -592,9 +1061,13 @@ void DSCameraSession::enumerateDevices(QList<QByteArray> *devices, QStringList *
                         varName.vt = VT_BSTR;
                         if(SUCCEEDED(hr = pPropBag->Read(L"FriendlyName", &varName, 0)))
                             output = QString::fromWCharArray(varName.bstrVal);
+                        if (drivers)
+                            driver = driverIdentity(pPropBag);
                         pPropBag->Release();
                     }
                     descriptions->append(output);
+                    if (drivers)
+                        drivers->append(driver);
                 }
                 pMoniker->Release();
             }
@@ -631,73 +1104,44 @@ QString DSCameraSession::deviceDescription(const QByteArray &device)
 
 void DSCameraSession::updateProperties()
 {
-    HRESULT hr;
-    AM_MEDIA_TYPE *pmt = NULL;
-    VIDEOINFOHEADER *pvi = NULL;
-    VIDEO_STREAM_CONFIG_CAPS scc;
-    IAMStreamConfig* pConfig = 0;
-
-    if(FAILED(hr = pBuild->FindInterface(&PIN_CATEGORY_CAPTURE, &MEDIATYPE_Video, pCap,
-                               IID_IAMStreamConfig, (void**)&pConfig)))
-    {
-        qWarning()<<"failed to get config on capture device";
+    DSDeviceCapabilities capabilities;
+    if (!streamCapabilities(pBuild, pCap, &capabilities.formats))
         return;
-    }
 
-    int iCount;
-    int iSize;
-    if(FAILED(hr = pConfig->GetNumberOfCapabilities(&iCount, &iSize))) {
-        qWarning() << "failed to get capabilities";
+    m_deviceFormats = capabilities.formats;
+    m_formats = surfaceFormats(capabilities.formats);
+
+    if (m_cacheDevice.isEmpty())
         return;
-    }
+    capabilities.device = m_cacheDevice;
+    capabilities.driver = m_cacheDriver;
+    capabilities.description = m_descriptions.value(m_devices.indexOf(m_cacheDevice));
+    DSCapabilityCache::defaultCache()->store(capabilities);
+}
 
-    m_formats.clear();
+bool DSCameraSession::cachedProperties()
+{
+    DSDeviceCapabilities capabilities;
+    if (m_cacheDevice.isEmpty() || !pCap
+            || !DSCapabilityCache::defaultCache()->lookup(m_cacheDevice, m_cacheDriver, &capabilities))
+        return false;
 
-    for (int iIndex = 0; iIndex < iCount; iIndex++)
-    {
-        if(SUCCEEDED(hr = pConfig->GetStreamCaps(iIndex, &pmt, reinterpret_cast<BYTE*>(&scc)))) {
-            pvi = (VIDEOINFOHEADER*)pmt->pbFormat;
-            if ((pmt->majortype == MEDIATYPE_Video) &&
-                    (pmt->formattype == FORMAT_VideoInfo))
-            {
-                // save each format available from the camera
-                if(pmt->subtype == MEDIASUBTYPE_RGB24) {
-                    QVideoSurfaceFormat sfmt(QSize(pvi->bmiHeader.biWidth, pvi->bmiHeader.biHeight), QVideoFrame::Format_RGB24);
-                    sfmt.setFrameRate(1000 / (pvi->AvgTimePerFrame / 10000));
-                    m_formats.append(sfmt);
-                } else if(pmt->subtype == MEDIASUBTYPE_RGB32) {
-                    QVideoSurfaceFormat sfmt(QSize(pvi->bmiHeader.biWidth, pvi->bmiHeader.biHeight), QVideoFrame::Format_RGB32);
-                    sfmt.setFrameRate(1000 / (pvi->AvgTimePerFrame / 10000));
-                    m_formats.append(sfmt);
-                } else if(pmt->subtype == MEDIASUBTYPE_YUY2) {
-                    QVideoSurfaceFormat sfmt(QSize(pvi->bmiHeader.biWidth, pvi->bmiHeader.biHeight), QVideoFrame::Format_YUYV);
-                    sfmt.setFrameRate(1000 / (pvi->AvgTimePerFrame / 10000));
-                    m_formats.append(sfmt);
-                } else if(pmt->subtype == MEDIASUBTYPE_MJPG) {
-                    QVideoSurfaceFormat sfmt(QSize(pvi->bmiHeader.biWidth, pvi->bmiHeader.biHeight), QVideoFrame::Format_User);
-                    sfmt.setFrameRate(1000 / (pvi->AvgTimePerFrame / 10000));
-                    m_formats.append(sfmt);
-                } else if(pmt->subtype == MEDIASUBTYPE_I420) {
-                    QVideoSurfaceFormat sfmt(QSize(pvi->bmiHeader.biWidth, pvi->bmiHeader.biHeight), QVideoFrame::Format_YUV420P);
-                    sfmt.setFrameRate(1000 / (pvi->AvgTimePerFrame / 10000));
-                    m_formats.append(sfmt);
-                } else if(pmt->subtype == MEDIASUBTYPE_RGB555) {
-                    QVideoSurfaceFormat sfmt(QSize(pvi->bmiHeader.biWidth, pvi->bmiHeader.biHeight), QVideoFrame::Format_RGB555);
-                    sfmt.setFrameRate(1000 / (pvi->AvgTimePerFrame / 10000));
-                    m_formats.append(sfmt);
-                } else if(pmt->subtype == MEDIASUBTYPE_UYVY) {
-                    QVideoSurfaceFormat sfmt(QSize(pvi->bmiHeader.biWidth, pvi->bmiHeader.biHeight), QVideoFrame::Format_UYVY);
-                    sfmt.setFrameRate(1000 / (pvi->AvgTimePerFrame / 10000));
-                    m_formats.append(sfmt);
-                } else if(pmt->subtype == MEDIASUBTYPE_H263) {
-                    qWarning() << "QVideoFrame does not have format for H263, frameSize: " << QSize(pvi->bmiHeader.biWidth, pvi->bmiHeader.biHeight);
-                } else {
-                    qWarning() << "UNKNOWN FORMAT: " << pmt->subtype.Data1 << " frameSize: " << QSize(pvi->bmiHeader.biWidth, pvi->bmiHeader.biHeight);
-                }
-            }
-        }
+    m_deviceFormats = capabilities.formats;
+    m_formats = surfaceFormats(capabilities.formats);
+    DSCapabilityCache::defaultCache()->revalidate(m_cacheDevice, capabilityProvider());
+    return true;
+}
+
+void DSCameraSession::cachedPropertiesChanged(const QByteArray &device)
+{
+    // A new driver shows up here as a miss; the formats walked for it are
+    // for the next session, this one keeps what it opened with.
+    DSDeviceCapabilities capabilities;
+    if (device == m_cacheDevice
+            && DSCapabilityCache::defaultCache()->lookup(m_cacheDevice, m_cacheDriver, &capabilities)) {
+        m_deviceFormats = capabilities.formats;
+        m_formats = surfaceFormats(capabilities.formats);
     }
-    pConfig->Release();
 }
 
 bool DSCameraSession::getCameraControlPropertyRange(tagCameraControlProperty property, tRange &range)
@@ -917,19 +1361,13 @@ bool DSCameraSession::setProperties()
     } else if (actualFormat.pixelFormat() == QVideoFrame::Format_YUYV) {
         in_mt.subtype = out_mt.subtype = MEDIASUBTYPE_YUY2;
     } else if(actualFormat.pixelFormat() == QVideoFrame::Format_User) {
-        if(FAILED(hr = CoCreateInstance(CLSID_MjpegDec, NULL, CLSCTX_INPROC, IID_IBaseFilter, (void**)&pIntermediateFilter))) {
-            qDebug() << "Cannot create MJPEG decoder" << QString::number(hr, 16);
-            return false;
-        }
-        in_mt.subtype = MEDIASUBTYPE_MJPG;
-        out_mt.subtype = MEDIASUBTYPE_RGB24;
+        // decoded by DSFrameProcessor, which can scale and crop while decoding
+        in_mt.subtype = out_mt.subtype = MEDIASUBTYPE_MJPG;
     } else if (actualFormat.pixelFormat() == QVideoFrame::Format_YUV420P) {
-        if(FAILED(hr = CoCreateInstance(CLSID_AVIDec, NULL, CLSCTX_INPROC, IID_IBaseFilter, (void**)&pIntermediateFilter))) {
-            qDebug() << "Cannot create AVI decoder" << QString::number(hr, 16);
-            return false;
-        }
-        in_mt.subtype = MEDIASUBTYPE_I420;
-        out_mt.subtype = MEDIASUBTYPE_RGB24;
+        // converted by DSFrameProcessor, no decoder filter needed
+        in_mt.subtype = out_mt.subtype = MEDIASUBTYPE_I420;
+    } else if (actualFormat.pixelFormat() == QVideoFrame::Format_NV12) {
+        in_mt.subtype = out_mt.subtype = MEDIASUBTYPE_NV12;
     } else if (actualFormat.pixelFormat() == QVideoFrame::Format_RGB555) {
         in_mt.subtype = out_mt.subtype = MEDIASUBTYPE_RGB555;
     } else if (actualFormat.pixelFormat() == QVideoFrame::Format_UYVY) {
@@ -939,29 +1377,43 @@ bool DSCameraSession::setProperties()
         return false;
     }
 
+    // Prefer the capability of the requested subtype, whose header describes
+    // its frames and whose rate is what the format reaches; only then take
+    // any of the right size, as drivers listing one entry per size need.
     bool setFormatOK = false;
-    for (int iIndex = 0; iIndex < iCount; iIndex++) {
-        if(SUCCEEDED(hr = pConfig->GetStreamCaps(iIndex, &pmt, reinterpret_cast<BYTE*>(&scc))))
-        {
-            pvi = (VIDEOINFOHEADER*)pmt->pbFormat;
+    for (int pass = 0; pass < 2 && !setFormatOK; pass++) {
+        for (int iIndex = 0; iIndex < iCount; iIndex++) {
+            if(SUCCEEDED(hr = pConfig->GetStreamCaps(iIndex, &pmt, reinterpret_cast<BYTE*>(&scc))))
+            {
+                pvi = (VIDEOINFOHEADER*)pmt->pbFormat;
+
+                if ((pmt->majortype == MEDIATYPE_Video) &&
+                    (pmt->formattype == FORMAT_VideoInfo) &&
+                    (pass == 1 || pmt->subtype == in_mt.subtype)) {
+                    if ((actualFormat.frameWidth() == pvi->bmiHeader.biWidth) &&
+                        (actualFormat.frameHeight() == pvi->bmiHeader.biHeight)) {
+
+                        // capture pin output must be set to a specificy media subtype
+                        pmt->subtype = in_mt.subtype;
+
+                        // ask for the format's rate if the device can do it,
+                        // negotiateFormat() may want less than the most
+                        if (actualFormat.frameRate() > 0) {
+                            const REFERENCE_TIME interval = REFERENCE_TIME(10000000 / actualFormat.frameRate());
+                            if (interval >= scc.MinFrameInterval && interval <= scc.MaxFrameInterval)
+                                pvi->AvgTimePerFrame = interval;
+                        }
 
-            if ((pmt->majortype == MEDIATYPE_Video) &&
-                (pmt->formattype == FORMAT_VideoInfo)) {
-                if ((actualFormat.frameWidth() == pvi->bmiHeader.biWidth) &&
-                    (actualFormat.frameHeight() == pvi->bmiHeader.biHeight)) {
-
-                    // capture pin output must be set to a specificy media subtype
-                    pmt->subtype = in_mt.subtype;
-
-                    hr = pConfig->SetFormat(pmt);
-                    _FreeMediaType(*pmt);
-                    if(FAILED(hr)) {
-                        qWarning() << "failed to set format: " << QString::number(hr,16);
-                        qWarning() << "but going to continue";
-                        continue; // We going to continue
-                    } else {
-                        setFormatOK = true;
-                        break;
+                        hr = pConfig->SetFormat(pmt);
+                        _FreeMediaType(*pmt);
+                        if(FAILED(hr)) {
+                            qWarning() << "failed to set format: " << QString::number(hr,16);
+                            qWarning() << "but going to continue";
+                            continue; // We going to continue
+                        } else {
+                            setFormatOK = true;
+                            break;
+                        }
                     }
                 }
             }
@@ -1098,6 +1550,9 @@ bool DSCameraSession::openStream()
         return false;
     }
 
+    // drops frames still queued in the previous format
+    frameProcessor->setFormat(frameFormatForMediaType(StillMediaType));
+
     pSG_Filter->Release();
 
     CoUninitialize();
@@ -1173,6 +1628,13 @@ bool DSCameraSession::startStream()
 {
     // Starts the stream, by emitting either QVideoPackets
     // or QvideoFrames, depending on Format chosen
+    frameProcessor->resetPacingStatistics();
+    if (m_source) {
+        frameProcessor->flush();
+        active = m_source->start(frameProcessor);
+        return active;
+    }
+
     if (!graph)
         graph = createFilterGraph();
 
@@ -1218,6 +1680,12 @@ bool DSCameraSession::startStream()
 void DSCameraSession::stopStream()
 {
     // Stops the stream from emitting packets
+    if (m_source) {
+        m_source->stop();
+        active = false;
+        return;
+    }
+
     HRESULT hr;
 
     IMediaControl* pControl = 0;
@@ -1243,6 +1711,12 @@ void DSCameraSession::stopStream()
 void DSCameraSession::suspendStream()
 {
     // Pauses the stream
+    if (m_source) {
+        m_source->stop();
+        active = false;
+        return;
+    }
+
     HRESULT hr;
 
     IMediaControl* pControl = 0;
@@ -1265,6 +1739,11 @@ void DSCameraSession::suspendStream()
 void DSCameraSession::resumeStream()
 {
     // Pauses the stream
+    if (m_source) {
+        active = m_source->start(frameProcessor);
+        return;
+    }
+
     HRESULT hr;
 
     IMediaControl* pControl = 0;
@@ -1286,7 +1765,7 @@ void DSCameraSession::resumeStream()
 
 void DSCameraSession::capture()
 {
-    mCaptureNextFrame = true;
+    mCaptureNextFrame.store(1);
 
     HRESULT hr;
     IAMVideoControl *pAMVidControl = NULL;
@@ -43,10 +43,8 @@
 #define DSCAMERASESSION_H
 
 #include <QtCore/qobject.h>
-#include <QTime>
 #include <QUrl>
 #include <QMap>
-#include <QMutex>
 
 #include <qcamera.h>
 #include <QtMultimedia/qvideoframe.h>
@@ -62,6 +60,7 @@
 #ifdef Q_CC_MSVC
 #  pragma comment(lib, "strmiids.lib")
 #  pragma comment(lib, "ole32.lib")
+#  pragma comment(lib, "setupapi.lib")
 #endif // Q_CC_MSVC
 #include <windows.h>
 
@@ -74,6 +73,11 @@
 #define __IDxtKey_INTERFACE_DEFINED__
 
 #include "directshowglobal.h"
+#include "dscapabilitycache.h"
+#include "dsformatnegotiator.h"
+#include "dsframeprocessor.h"
+#include "dsframesource.h"
+#include "dsframerecorder.h"
 
 struct ICaptureGraphBuilder2;
 struct ISampleGrabber;
@@ -84,12 +88,6 @@ QT_BEGIN_NAMESPACE
 
 class SampleGrabberCallbackPrivate;
 
-struct video_buffer {
-    unsigned char* buffer;
-    int            length;
-    qint64         time;
-};
-
 class DSCameraSession : public QObject
 {
     Q_OBJECT
@@ -105,13 +103,85 @@ public:
     void setFormat(QVideoSurfaceFormat format);
     QVideoSurfaceFormat format();
 
+    // Set the format by cost instead: the cheapest supported format of size
+    // that delivers frameRate, converted to output; see DSFormatNegotiator,
+    // whose bus and conversion costs may be adjusted. Sets the output format
+    // too. False if no format reaches the rate; the fastest one is set then.
+    bool negotiateFormat(const QSize &size, qreal frameRate, DSFrameProcessor::OutputFormat output);
+    DSFormatNegotiator *formatNegotiator();
+
     AM_MEDIA_TYPE StillMediaType;
-    QList<video_buffer*> frames;
+    DSFrameProcessor* frameProcessor;
     SampleGrabberCallbackPrivate* StillCapCB;
 
-    QMutex mutex;
-
-    bool mCaptureNextFrame;
+    QAtomicInt mCaptureNextFrame;
+    QAtomicInt mStreaming;
+
+    DSFramePoolStatistics framePoolStatistics() const;
+
+    // Convert frames on a thread of their own instead of the session's.
+    void setWorkerThreadEnabled(bool enabled);
+    bool isWorkerThreadEnabled() const;
+
+    // Split the conversion of large frames across this many cores, <= 0
+    // for all of them.
+    void setConversionThreadCount(int threadCount);
+    int conversionThreadCount() const;
+
+    // Keep every frame instead of only the ones asked for with capture().
+    void setStreamingEnabled(bool enabled);
+    bool isStreamingEnabled() const;
+
+    // How many frames may wait for conversion and what happens to the next
+    // one once they do. Change the depth while the stream is stopped.
+    void setQueueDepth(int depth);
+    int queueDepth() const;
+    void setBackpressurePolicy(DSFrameProcessor::BackpressurePolicy policy, int timeout = 100);
+    DSFrameProcessor::BackpressurePolicy backpressurePolicy() const;
+    DSFrameDropStatistics frameDropStatistics() const;
+
+    // RGB24, I420 and NV12 frames as the camera delivers them, or grey.
+    void setOutputFormat(DSFrameProcessor::OutputFormat format);
+    DSFrameProcessor::OutputFormat outputFormat() const;
+
+    // Decode MJPG frames at 1 / scale of their size and only within region,
+    // see DSFrameProcessor. Cheaper than decoding everything and resizing.
+    void setJpegScale(int scale);
+    int jpegScale() const;
+    void setJpegRegion(const QRect &region);
+    QRect jpegRegion() const;
+
+    // Also emit every frame shrunk by 2 or 4 on previewFrameCaptured, made in
+    // the same pass as the full size frame; 0 for no preview.
+    void setPreviewScale(int scale);
+    int previewScale() const;
+
+    // Convert and emit only these parts of each frame, on regionCaptured()
+    // with their index and instead of cvFrameCaptured(); the work done
+    // shrinks with their area. See DSFrameProcessor. Empty for whole frames.
+    void setRegionsOfInterest(const QList<QRect> &regions);
+    QList<QRect> regionsOfInterest() const;
+
+    // Several consumers wanting different formats, sizes or rates: each
+    // distinct format and size is made once per frame and shared, formats
+    // nobody takes are not made. Frames arrive on subscriptionFrameCaptured()
+    // instead of cvFrameCaptured() while anyone is subscribed. See
+    // DSFrameProcessor.
+    int subscribe(const DSFrameProcessor::Subscription &subscription);
+    void unsubscribe(int id);
+
+    // Where the time goes between BufferCB() and cvFrameCaptured, per stage.
+    void setLatencyTracingEnabled(bool enabled);
+    bool isLatencyTracingEnabled() const;
+    DSLatencyStatistics latencyStatistics(DSLatencyTracer::Stage stage) const;
+    void resetLatencyStatistics();
+
+    // Frame intervals and jitter as frames arrive from the camera and as
+    // they are emitted, over the last frames; reset by startStream(). See
+    // DSFramePacing.
+    DSFramePacingStatistics arrivalPacing() const;
+    DSFramePacingStatistics emitPacing() const;
+    void resetPacingStatistics();
 
     bool deviceReady();
     bool pictureInProgress();
@@ -140,6 +210,8 @@ public:
     bool setGain(long value, bool aut=false);
 
     // media control
+    // record() writes the raw frames to segmented files named after sink,
+    // which has to be a local file; stop() ends the recording.
     bool setOutputLocation(const QUrl &sink);
     QUrl outputLocation() const;
     qint64 position() const;
@@ -147,9 +219,17 @@ public:
     void record();
     void pause();
     void stop();
+    bool isRecording() const;
+    DSRecorderStatistics recorderStatistics() const;
 
     void setSurface(QAbstractVideoSurface* surface);
 
+    // Take frames from source instead of the capture device while set, e.g. a
+    // DSSyntheticFrameSource. Every frame the source delivers is processed;
+    // the session does not take ownership.
+    void setFrameSource(DSFrameSource *source);
+    DSFrameSource *frameSource() const;
+
     int captureImage(const QString &fileName);
 
     bool startStream();
@@ -163,8 +243,9 @@ public:
 private:
     QVideoSurfaceFormat actualFormat;
     QList<QVideoSurfaceFormat> m_formats;
+    QList<DSDeviceFormat> m_deviceFormats;
+    DSFormatNegotiator m_negotiator;
 
-    QTime timeStamp;
     bool graph;
     bool active;
     bool opened;
@@ -173,6 +254,8 @@ private:
     QByteArray m_device;
     QUrl m_sink;
     QAbstractVideoSurface* m_surface;
+    DSFrameSource* m_source;
+    DSFrameRecorder* m_recorder;
 
     ICaptureGraphBuilder2* pBuild;
     IGraphBuilder* pGraph;
@@ -187,13 +270,19 @@ private:
 
     QList<QByteArray> m_devices;
     QStringList m_descriptions;
+    QList<QByteArray> m_drivers;
 
-    static void enumerateDevices(QList<QByteArray> *devices, QStringList *descriptions);
-    int yuv2rgb(int y, int u, int v);
+    // Key of the device's formats in DSCapabilityCache::defaultCache().
+    QByteArray m_cacheDevice;
+    QByteArray m_cacheDriver;
+
+    static void enumerateDevices(QList<QByteArray> *devices, QStringList *descriptions,
+                                 QList<QByteArray> *drivers = 0);
 
     HRESULT getPin(IBaseFilter *pFilter, QString type, PIN_DIRECTION PinDir, IPin **ppPin);
     bool createFilterGraph();
     void updateProperties();
+    bool cachedProperties();
     bool setProperties();
     bool openStream();
     void closeStream();
@@ -203,11 +292,14 @@ private:
 
     HRESULT getFilterAndPinInfo(IBaseFilter *pFilter);
 
+private Q_SLOTS:
+    void cachedPropertiesChanged(const QByteArray &device);
+
 Q_SIGNALS:
     void cvFrameCaptured(cv::Mat frame);
-
-private Q_SLOTS:
-    void captureFrame();
+    void previewFrameCaptured(cv::Mat frame);
+    void regionCaptured(int index, cv::Mat frame);
+    void subscriptionFrameCaptured(int id, cv::Mat frame);
 };
 
 QT_END_NAMESPACE
@@ -0,0 +1,273 @@
+#include <QDebug>
+#include <QtCore/qdatastream.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qsavefile.h>
+#include <QtCore/qstandardpaths.h>
+#include <QtCore/qthread.h>
+
+#include "dscapabilitycache.h"
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+const quint32 CacheMagic = 0x44534343; // "DSCC"
+const quint32 CacheVersion = 2;  // 2: frame rates no longer rounded down
+
+QString defaultCacheFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+            + QLatin1String("/dscapabilities.cache");
+}
+
+} // end namespace
+
+Q_GLOBAL_STATIC_WITH_ARGS(DSCapabilityCache, defaultCapabilityCache, (defaultCacheFileName()))
+
+class DSCapabilityRevalidator : public QThread
+{
+public:
+    explicit DSCapabilityRevalidator(DSCapabilityCache *cache)
+        : m_cache(cache)
+    {
+    }
+
+protected:
+    void run()
+    {
+        DSCapabilityCache::Request request;
+        while (m_cache->takeRequest(&request)) {
+            DSDeviceCapabilities capabilities;
+            if (request.provider->query(request.device, &capabilities))
+                m_cache->revalidated(capabilities);
+        }
+    }
+
+private:
+    DSCapabilityCache *m_cache;
+};
+
+DSCapabilityCache::DSCapabilityCache(const QString &fileName, QObject *parent)
+    : QObject(parent)
+    , m_fileName(fileName)
+    , m_revalidator(0)
+    , m_revalidating(false)
+{
+    if (QFile::exists(m_fileName))
+        load();
+}
+
+DSCapabilityCache::~DSCapabilityCache()
+{
+    m_mutex.lock();
+    m_requests.clear();
+    m_mutex.unlock();
+
+    if (m_revalidator) {
+        m_revalidator->wait();
+        delete m_revalidator;
+    }
+}
+
+bool DSCapabilityCache::load()
+{
+    QMutexLocker fileLocker(&m_fileMutex);
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "cannot open capability cache" << m_fileName << file.errorString();
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 count = 0;
+    in >> magic >> version;
+    if (magic != CacheMagic || version != CacheVersion) {
+        qWarning() << "ignoring capability cache" << m_fileName << "of an unknown version";
+        return false;
+    }
+
+    QMap<QByteArray, DSDeviceCapabilities> entries;
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        DSDeviceCapabilities capabilities;
+        quint32 formatCount = 0;
+        in >> capabilities.device >> capabilities.driver >> capabilities.description >> formatCount;
+        for (quint32 j = 0; j < formatCount && in.status() == QDataStream::Ok; ++j) {
+            qint32 pixelFormat = 0;
+            qint32 width = 0;
+            qint32 height = 0;
+            double frameRate = 0;
+            in >> pixelFormat >> width >> height >> frameRate;
+            if (pixelFormat <= DSFrameFormat::Invalid || pixelFormat > DSFrameFormat::MJPG)
+                in.setStatus(QDataStream::ReadCorruptData);
+
+            DSDeviceFormat format;
+            format.pixelFormat = DSFrameFormat::PixelFormat(pixelFormat);
+            format.width = width;
+            format.height = height;
+            format.frameRate = frameRate;
+            capabilities.formats.append(format);
+        }
+        entries.insert(capabilities.device, capabilities);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "ignoring corrupt capability cache" << m_fileName;
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_entries = entries;
+    return true;
+}
+
+bool DSCapabilityCache::save() const
+{
+    QMutexLocker fileLocker(&m_fileMutex);
+
+    m_mutex.lock();
+    const QMap<QByteArray, DSDeviceCapabilities> entries = m_entries;
+    m_mutex.unlock();
+
+    QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "cannot write capability cache" << m_fileName << file.errorString();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << CacheMagic << CacheVersion << quint32(entries.size());
+    foreach (const DSDeviceCapabilities &capabilities, entries) {
+        out << capabilities.device << capabilities.driver << capabilities.description
+            << quint32(capabilities.formats.size());
+        foreach (const DSDeviceFormat &format, capabilities.formats) {
+            out << qint32(format.pixelFormat) << qint32(format.width) << qint32(format.height)
+                << double(format.frameRate);
+        }
+    }
+
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        qWarning() << "cannot write capability cache" << m_fileName << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool DSCapabilityCache::lookup(const QByteArray &device, const QByteArray &driver,
+                               DSDeviceCapabilities *capabilities) const
+{
+    QMutexLocker locker(&m_mutex);
+    QMap<QByteArray, DSDeviceCapabilities>::const_iterator it = m_entries.constFind(device);
+    if (it == m_entries.constEnd() || it.value().driver != driver)
+        return false;
+
+    *capabilities = it.value();
+    return true;
+}
+
+void DSCapabilityCache::store(const DSDeviceCapabilities &capabilities)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        QMap<QByteArray, DSDeviceCapabilities>::const_iterator it = m_entries.constFind(capabilities.device);
+        if (it != m_entries.constEnd() && it.value() == capabilities)
+            return;
+        m_entries.insert(capabilities.device, capabilities);
+    }
+    save();
+}
+
+void DSCapabilityCache::remove(const QByteArray &device)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_entries.remove(device))
+            return;
+    }
+    save();
+}
+
+QList<QByteArray> DSCapabilityCache::devices() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_entries.keys();
+}
+
+void DSCapabilityCache::revalidate(const QByteArray &device, DSCapabilityProvider *provider)
+{
+    QMutexLocker locker(&m_mutex);
+    foreach (const Request &request, m_requests) {
+        if (request.device == device)
+            return;
+    }
+
+    Request request;
+    request.device = device;
+    request.provider = provider;
+    m_requests.append(request);
+
+    if (m_revalidating)
+        return;
+
+    // The thread quits once it runs out of requests; takeRequest() said so
+    // under the lock, so waiting for the old one is only a formality.
+    if (m_revalidator) {
+        m_revalidator->wait();
+        delete m_revalidator;
+    }
+    m_revalidating = true;
+    m_revalidator = new DSCapabilityRevalidator(this);
+    m_revalidator->start(QThread::LowPriority);
+}
+
+bool DSCapabilityCache::waitForRevalidation(unsigned long msecs)
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_revalidating) {
+        if (!m_requestsDone.wait(&m_mutex, msecs))
+            return false;
+    }
+    return true;
+}
+
+DSCapabilityCache *DSCapabilityCache::defaultCache()
+{
+    return defaultCapabilityCache();
+}
+
+bool DSCapabilityCache::takeRequest(Request *request)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_requests.isEmpty()) {
+        m_revalidating = false;
+        m_requestsDone.wakeAll();
+        return false;
+    }
+
+    *request = m_requests.takeFirst();
+    return true;
+}
+
+void DSCapabilityCache::revalidated(const DSDeviceCapabilities &capabilities)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        QMap<QByteArray, DSDeviceCapabilities>::const_iterator it = m_entries.constFind(capabilities.device);
+        if (it != m_entries.constEnd() && it.value() == capabilities)
+            return;
+        m_entries.insert(capabilities.device, capabilities);
+    }
+    save();
+    emit capabilitiesChanged(capabilities.device);
+}
+
+QT_END_NAMESPACE
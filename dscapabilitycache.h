@@ -0,0 +1,178 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSCAPABILITYCACHE_H
+#define DSCAPABILITYCACHE_H
+
+#include <QtCore/qobject.h>
+#include <QtCore/qbytearray.h>
+#include <QtCore/qstring.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qmap.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qwaitcondition.h>
+
+#include <climits>
+
+#include "dsframeformat.h"
+
+QT_BEGIN_NAMESPACE
+
+class DSCapabilityRevalidator;
+
+// One stream capability of a capture device.
+struct DSDeviceFormat
+{
+    DSDeviceFormat()
+        : pixelFormat(DSFrameFormat::Invalid)
+        , width(0)
+        , height(0)
+        , frameRate(0)
+    {
+    }
+
+    bool operator==(const DSDeviceFormat &other) const
+    {
+        return pixelFormat == other.pixelFormat && width == other.width
+                && height == other.height && frameRate == other.frameRate;
+    }
+
+    DSFrameFormat::PixelFormat pixelFormat;
+    int width;
+    int height;
+    qreal frameRate;
+};
+
+struct DSDeviceCapabilities
+{
+    bool operator==(const DSDeviceCapabilities &other) const
+    {
+        return device == other.device && driver == other.driver
+                && description == other.description && formats == other.formats;
+    }
+    bool operator!=(const DSDeviceCapabilities &other) const { return !(*this == other); }
+
+    QByteArray device;          // moniker display name, the device path
+    QByteArray driver;          // changes when the driver does, see DSCapabilityProvider
+    QString description;
+    QList<DSDeviceFormat> formats;
+};
+
+// Asks a device what it can do, the slow way. DSCameraSession has one walking
+// the stream capabilities of the capture pin. query() is called on the
+// cache's background thread and fills in everything, driver included; false
+// if the device is not there.
+class DSCapabilityProvider
+{
+public:
+    virtual ~DSCapabilityProvider() {}
+    virtual bool query(const QByteArray &device, DSDeviceCapabilities *capabilities) = 0;
+};
+
+// Capabilities of capture devices kept on disk, so a session starts with the
+// formats it found last time instead of walking every stream capability,
+// which takes hundreds of milliseconds per camera.
+//
+// Entries are keyed by device path and only match while the driver identity
+// is the one they were found with; a new driver means a new walk. Since a
+// device may also change behind an unchanged driver, revalidate() walks it
+// again in the background and updates the cache, emitting
+// capabilitiesChanged() if anything is different.
+//
+// The file is written whole through a temporary and renamed, so a crash never
+// leaves half of it; one that does not parse is ignored.
+class DSCapabilityCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DSCapabilityCache(const QString &fileName, QObject *parent = 0);
+    ~DSCapabilityCache();
+
+    // Loaded by the constructor, saved by store() and revalidation.
+    QString fileName() const { return m_fileName; }
+    bool load();
+    bool save() const;
+
+    bool lookup(const QByteArray &device, const QByteArray &driver,
+                DSDeviceCapabilities *capabilities) const;
+    void store(const DSDeviceCapabilities &capabilities);
+    void remove(const QByteArray &device);
+    QList<QByteArray> devices() const;
+
+    // Queries provider for device on a background thread. Requests for a
+    // device already waiting are merged; provider has to outlive the cache or
+    // waitForRevalidation().
+    void revalidate(const QByteArray &device, DSCapabilityProvider *provider);
+    bool waitForRevalidation(unsigned long msecs = ULONG_MAX);
+
+    // Shared by all sessions, in the user's cache directory.
+    static DSCapabilityCache *defaultCache();
+
+Q_SIGNALS:
+    void capabilitiesChanged(const QByteArray &device);
+
+private:
+    Q_DISABLE_COPY(DSCapabilityCache)
+
+    struct Request
+    {
+        QByteArray device;
+        DSCapabilityProvider *provider;
+    };
+
+    bool takeRequest(Request *request);
+    void revalidated(const DSDeviceCapabilities &capabilities);
+
+    QString m_fileName;
+    mutable QMutex m_fileMutex;     // one save() at a time, the last one wins
+    mutable QMutex m_mutex;
+    QWaitCondition m_requestsDone;
+    QMap<QByteArray, DSDeviceCapabilities> m_entries;
+    QList<Request> m_requests;
+    DSCapabilityRevalidator *m_revalidator;
+    bool m_revalidating;
+
+    friend class DSCapabilityRevalidator;
+};
+
+QT_END_NAMESPACE
+
+#endif
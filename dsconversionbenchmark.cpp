@@ -0,0 +1,597 @@
+#include "dsconversionbenchmark.h"
+#include "dsbandconverter.h"
+#include "dsframeprocessor.h"
+#include "dsframescheduler.h"
+#include "dsjpegdecoder.h"
+#include "dssyntheticframesource.h"
+
+#include <QDebug>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qvector.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+// The per pixel conversion DSCameraSession used before DSFrameConverter,
+// kept verbatim as the baseline.
+int legacyYuv2rgb(int y, int u, int v)
+{
+   quint32 pixel32;
+   quint8 *pixel = (unsigned char *)&pixel32;
+   qint32 r, g, b;
+
+   r = y + (1.370705 * (v-128));
+   g = y - (0.698001 * (v-128)) - (0.337633 * (u-128));
+   b = y + (1.732446 * (u-128));
+
+   r = r>255 ? 255 : r<0 ? 0 : r;
+   g = g>255 ? 255 : g<0 ? 0 : g;
+   b = b>255 ? 255 : b<0 ? 0 : b;
+
+   pixel[0] = r * 220 / 256;
+   pixel[1] = g * 220 / 256;
+   pixel[2] = b * 220 / 256;
+   pixel[3] = 0;
+
+   return pixel32;
+}
+
+void legacyYuy2(const quint8 *src, quint8 *dst, int width, int height)
+{
+    cv::Mat image(cv::Size(width, height), CV_8UC3, dst);
+
+    int j = 0;
+    const int length = width * height * 2;
+    for (int i = 0; i < length; i += 4) {
+        const quint8 *pp = src + i;
+        // writes a fourth byte, dst has one to spare
+        const int first = legacyYuv2rgb(pp[0], pp[1], pp[3]);
+        const int second = legacyYuv2rgb(pp[2], pp[1], pp[3]);
+        memcpy(image.data + j, &first, 4);
+        memcpy(image.data + j + 3, &second, 4);
+        j += 6;
+    }
+
+    cv::flip(image, image, 0);
+}
+
+void legacyBgr24(const quint8 *src, quint8 *dst, int width, int height)
+{
+    cv::Mat image(cv::Size(width, height), CV_8UC3, const_cast<quint8 *>(src));
+    cv::Mat flipped, rgb;
+    cv::flip(image, flipped, 0);
+    cv::cvtColor(flipped, rgb, CV_BGR2RGB);
+    memcpy(dst, rgb.data, width * height * 3);
+}
+
+// Formats that had no path before are measured against OpenCV.
+void legacyBgr32(const quint8 *src, quint8 *dst, int width, int height)
+{
+    cv::Mat image(cv::Size(width, height), CV_8UC4, const_cast<quint8 *>(src));
+    cv::Mat flipped, rgb;
+    cv::flip(image, flipped, 0);
+    cv::cvtColor(flipped, rgb, CV_BGRA2RGB);
+    memcpy(dst, rgb.data, width * height * 3);
+}
+
+void legacyRgb555(const quint8 *src, quint8 *dst, int width, int height)
+{
+    cv::Mat image(cv::Size(width, height), CV_8UC2, const_cast<quint8 *>(src));
+    cv::Mat flipped, rgb;
+    cv::flip(image, flipped, 0);
+    cv::cvtColor(flipped, rgb, CV_BGR5552RGB);
+    memcpy(dst, rgb.data, width * height * 3);
+}
+
+void legacyUyvy(const quint8 *src, quint8 *dst, int width, int height)
+{
+    cv::Mat image(cv::Size(width, height), CV_8UC2, const_cast<quint8 *>(src));
+    cv::Mat rgb(cv::Size(width, height), CV_8UC3, dst);
+    cv::cvtColor(image, rgb, CV_YUV2RGB_UYVY);
+}
+
+// I420 used to go through the AVI decoder filter, which cannot be timed
+// outside a graph.
+void legacyI420(const quint8 *src, quint8 *dst, int width, int height)
+{
+    cv::Mat image(cv::Size(width, height * 3 / 2), CV_8UC1, const_cast<quint8 *>(src));
+    cv::Mat rgb(cv::Size(width, height), CV_8UC3, dst);
+    cv::cvtColor(image, rgb, CV_YUV2RGB_I420);
+}
+
+void legacyNv12(const quint8 *src, quint8 *dst, int width, int height)
+{
+    cv::Mat image(cv::Size(width, height * 3 / 2), CV_8UC1, const_cast<quint8 *>(src));
+    cv::Mat rgb(cv::Size(width, height), CV_8UC3, dst);
+    cv::cvtColor(image, rgb, CV_YUV2RGB_NV12);
+}
+
+// BGR output had no path before either.
+void legacyYuy2Bgr(const quint8 *src, quint8 *dst, int width, int height)
+{
+    cv::Mat image(cv::Size(width, height), CV_8UC2, const_cast<quint8 *>(src));
+    cv::Mat bgr(cv::Size(width, height), CV_8UC3, dst);
+    cv::cvtColor(image, bgr, CV_YUV2BGR_YUY2);
+}
+
+void legacyUyvyBgr(const quint8 *src, quint8 *dst, int width, int height)
+{
+    cv::Mat image(cv::Size(width, height), CV_8UC2, const_cast<quint8 *>(src));
+    cv::Mat bgr(cv::Size(width, height), CV_8UC3, dst);
+    cv::cvtColor(image, bgr, CV_YUV2BGR_UYVY);
+}
+
+void legacyI420Bgr(const quint8 *src, quint8 *dst, int width, int height)
+{
+    cv::Mat image(cv::Size(width, height * 3 / 2), CV_8UC1, const_cast<quint8 *>(src));
+    cv::Mat bgr(cv::Size(width, height), CV_8UC3, dst);
+    cv::cvtColor(image, bgr, CV_YUV2BGR_I420);
+}
+
+void legacyNv12Bgr(const quint8 *src, quint8 *dst, int width, int height)
+{
+    cv::Mat image(cv::Size(width, height * 3 / 2), CV_8UC1, const_cast<quint8 *>(src));
+    cv::Mat bgr(cv::Size(width, height), CV_8UC3, dst);
+    cv::cvtColor(image, bgr, CV_YUV2BGR_NV12);
+}
+
+// Grey output is measured against what receivers had to do without it: take
+// RGB24 from the kernels and let OpenCV turn it grey.
+void rgbToGrey(const cv::Mat &rgb, quint8 *dst)
+{
+    cv::Mat grey(rgb.size(), CV_8UC1, dst);
+    cv::cvtColor(rgb, grey, CV_RGB2GRAY);
+}
+
+const DSColorMatrix &benchmarkMatrix()
+{
+    return DSColorMatrix::matrix(DSColorMatrix::BT601, DSColorMatrix::LimitedRange);
+}
+
+void rgbGreyYuy2(const quint8 *src, quint8 *dst, int width, int height)
+{
+    cv::Mat rgb(cv::Size(width, height), CV_8UC3);
+    DSFrameConverter::yuy2ToRgb24(src, width * 2, rgb.data, width * 3,
+                                  width, height, benchmarkMatrix());
+    rgbToGrey(rgb, dst);
+}
+
+void rgbGreyUyvy(const quint8 *src, quint8 *dst, int width, int height)
+{
+    cv::Mat rgb(cv::Size(width, height), CV_8UC3);
+    DSFrameConverter::uyvyToRgb24(src, width * 2, rgb.data, width * 3,
+                                  width, height, benchmarkMatrix());
+    rgbToGrey(rgb, dst);
+}
+
+void rgbGreyI420(const quint8 *src, quint8 *dst, int width, int height)
+{
+    cv::Mat rgb(cv::Size(width, height), CV_8UC3);
+    const quint8 *u = src + width * height;
+    DSFrameConverter::i420ToRgb24(src, width, u, u + width * height / 4, width / 2,
+                                  rgb.data, width * 3, width, height, benchmarkMatrix());
+    rgbToGrey(rgb, dst);
+}
+
+// A preview made in the conversion pass is measured against converting and
+// then resizing with OpenCV, which reads the whole converted frame again.
+void yuy2ThenResize(const quint8 *src, quint8 *dst, int width, int height, int factor)
+{
+    DSFrameConverter::yuy2ToRgb24(src, width * 2, dst, width * 3,
+                                  width, height, benchmarkMatrix());
+    cv::Mat rgb(cv::Size(width, height), CV_8UC3, dst);
+    cv::Mat preview;
+    cv::resize(rgb, preview, cv::Size(width / factor, height / factor), 0, 0, cv::INTER_AREA);
+}
+
+void yuy2ThenResize2(const quint8 *src, quint8 *dst, int width, int height)
+{
+    yuy2ThenResize(src, dst, width, height, 2);
+}
+
+void yuy2ThenResize4(const quint8 *src, quint8 *dst, int width, int height)
+{
+    yuy2ThenResize(src, dst, width, height, 4);
+}
+
+void scalarYuy2(const DSConversionJob &job)
+{
+    DSFrameConverter::yuy2ToRgb24Scalar(job.src, job.srcStride, job.dst, job.dstStride,
+                                        job.width, job.height, *job.matrix, job.bgr);
+}
+
+void scalarUyvy(const DSConversionJob &job)
+{
+    DSFrameConverter::uyvyToRgb24Scalar(job.src, job.srcStride, job.dst, job.dstStride,
+                                        job.width, job.height, *job.matrix, job.bgr);
+}
+
+void scalarI420(const DSConversionJob &job)
+{
+    DSFrameConverter::i420ToRgb24Scalar(job.src, job.srcStride, job.srcU, job.srcV, job.srcUVStride,
+                                        job.dst, job.dstStride, job.width, job.height, *job.matrix,
+                                        job.bgr);
+}
+
+void scalarNv12(const DSConversionJob &job)
+{
+    DSFrameConverter::nv12ToRgb24Scalar(job.src, job.srcStride, job.srcU, job.srcUVStride,
+                                        job.dst, job.dstStride, job.width, job.height, *job.matrix,
+                                        job.bgr);
+}
+
+struct Conversion
+{
+    const char *name;
+    DSConversionJob::Kind kind;
+    int srcBitsPerPixel;
+    int dstBytesPerPixel;
+    bool bottomUp;      // rows are read backwards to flip the image
+    void (*legacy)(const quint8 *src, quint8 *dst, int width, int height);
+    void (*scalar)(const DSConversionJob &job);
+    int previewFactor;  // also shrink into a preview
+    bool bgr;           // BGR24 out instead of RGB24
+};
+
+// Orientation follows what DSFrameProcessor does with each format.
+const Conversion conversions[] = {
+    { "YUY2 -> RGB24", DSConversionJob::Yuy2ToRgb24, 16, 3, false, legacyYuy2, scalarYuy2 },
+    { "UYVY -> RGB24", DSConversionJob::UyvyToRgb24, 16, 3, false, legacyUyvy, scalarUyvy },
+    { "I420 -> RGB24", DSConversionJob::I420ToRgb24, 12, 3, false, legacyI420, scalarI420 },
+    { "NV12 -> RGB24", DSConversionJob::Nv12ToRgb24, 12, 3, false, legacyNv12, scalarNv12 },
+    { "YUY2 -> BGR24", DSConversionJob::Yuy2ToRgb24, 16, 3, false, legacyYuy2Bgr, scalarYuy2, 0, true },
+    { "UYVY -> BGR24", DSConversionJob::UyvyToRgb24, 16, 3, false, legacyUyvyBgr, scalarUyvy, 0, true },
+    { "I420 -> BGR24", DSConversionJob::I420ToRgb24, 12, 3, false, legacyI420Bgr, scalarI420, 0, true },
+    { "NV12 -> BGR24", DSConversionJob::Nv12ToRgb24, 12, 3, false, legacyNv12Bgr, scalarNv12, 0, true },
+    { "RGB24 -> RGB24", DSConversionJob::Bgr24ToRgb24, 24, 3, true, legacyBgr24, 0 },
+    { "RGB32 -> RGB24", DSConversionJob::Bgr32ToRgb24, 32, 3, true, legacyBgr32, 0 },
+    { "RGB555 -> RGB24", DSConversionJob::Rgb555ToRgb24, 16, 3, true, legacyRgb555, 0 },
+    { "YUY2 -> GREY", DSConversionJob::Yuy2ToLuma, 16, 1, false, rgbGreyYuy2, 0 },
+    { "UYVY -> GREY", DSConversionJob::UyvyToLuma, 16, 1, false, rgbGreyUyvy, 0 },
+    // the copy made for padded rows; without padding the frame is shared
+    { "I420 -> GREY", DSConversionJob::PlaneToLuma, 12, 1, false, rgbGreyI420, 0 },
+    { "YUY2 -> RGB24+1/2", DSConversionJob::Yuy2ToRgb24, 16, 3, false, yuy2ThenResize2, 0, 2 },
+    { "YUY2 -> RGB24+1/4", DSConversionJob::Yuy2ToRgb24, 16, 3, false, yuy2ThenResize4, 0, 4 }
+};
+
+// Fills a frame with a gradient so the kernels see a realistic mix of values.
+void fillSource(QVector<quint8> &buffer)
+{
+    for (int i = 0; i < buffer.size(); ++i)
+        buffer[i] = quint8((i * 7 + i / 4093) & 0xff);
+}
+
+// Repeats convert until minimumTime has passed, returns ns per call.
+template <typename Convert>
+double measure(Convert convert, int minimumTime)
+{
+    convert(); // warm up caches and the thread pool
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 iterations = 0;
+    do {
+        convert();
+        ++iterations;
+    } while (timer.elapsed() < minimumTime);
+
+    return double(timer.nsecsElapsed()) / iterations;
+}
+
+struct LegacyRun
+{
+    const Conversion *conversion;
+    const quint8 *src;
+    quint8 *dst;
+    int width;
+    int height;
+    void operator()() const { conversion->legacy(src, dst, width, height); }
+};
+
+struct ScalarRun
+{
+    const Conversion *conversion;
+    const DSConversionJob *job;
+    void operator()() const { conversion->scalar(*job); }
+};
+
+struct BandedRun
+{
+    DSBandConverter *converter;
+    const DSConversionJob *job;
+    void operator()() const { converter->run(*job); }
+};
+
+// Decodes the frames in turn, each call one frame.
+struct JpegRun
+{
+    DSJpegDecoder *decoder;
+    const QList<QByteArray> *frames;
+    quint8 *dst;
+    int *next;
+    cv::Mat *resized;   // resized to this size if not empty
+    void operator()() const
+    {
+        const QByteArray &frame = frames->at(*next);
+        *next = (*next + 1) % frames->size();
+
+        const QSize size = decoder->start(reinterpret_cast<const quint8 *>(frame.constData()),
+                                          frame.size());
+        decoder->decode(dst, size.width() * 3);
+        if (!resized->empty()) {
+            cv::Mat image(size.height(), size.width(), CV_8UC3, dst);
+            cv::resize(image, *resized, resized->size(), 0, 0, cv::INTER_AREA);
+        }
+    }
+};
+
+DSBenchmarkResult makeResult(const Conversion &conversion, const QString &variant,
+                             const QSize &size, int threads, double nsPerFrame, double legacyNs)
+{
+    const double pixels = double(size.width()) * size.height();
+    const double bytes = pixels * conversion.srcBitsPerPixel / 8;
+
+    DSBenchmarkResult result;
+    result.conversion = QString::fromLatin1(conversion.name);
+    result.variant = variant;
+    result.size = size;
+    result.threads = threads;
+    result.nsPerPixel = nsPerFrame / pixels;
+    result.megabytesPerSecond = bytes / nsPerFrame * 1000.0; // bytes/ns to MB/s
+    result.speedup = legacyNs / nsPerFrame;
+    return result;
+}
+
+} // end namespace
+
+DSConversionBenchmark::DSConversionBenchmark()
+    : m_minimumTime(200)
+{
+    m_sizes << QSize(640, 480) << QSize(1280, 720) << QSize(1920, 1080) << QSize(3840, 2160);
+
+    // 2 and 4 even on smaller machines, so results from different machines
+    // line up, then every core
+    const int cores = qMax(1, QThread::idealThreadCount());
+    m_threadCounts << 2 << 4;
+    for (int threads = 8; threads < cores; threads *= 2)
+        m_threadCounts << threads;
+    if (cores > 4)
+        m_threadCounts << cores;
+}
+
+void DSConversionBenchmark::setSizes(const QList<QSize> &sizes)
+{
+    m_sizes = sizes;
+}
+
+void DSConversionBenchmark::setThreadCounts(const QList<int> &threadCounts)
+{
+    m_threadCounts = threadCounts;
+}
+
+QList<DSBenchmarkResult> DSConversionBenchmark::run() const
+{
+    QList<DSBenchmarkResult> results;
+    const DSColorMatrix &matrix = DSColorMatrix::matrix(DSColorMatrix::BT601, DSColorMatrix::LimitedRange);
+    const QString instructionSet = QString::fromLatin1(DSFrameConverter::instructionSet());
+
+    for (int c = 0; c < int(sizeof(conversions) / sizeof(conversions[0])); ++c) {
+        const Conversion &conversion = conversions[c];
+
+        foreach (const QSize &size, m_sizes) {
+            // planar formats: the Y plane, chroma follows
+            const bool planar = conversion.srcBitsPerPixel == 12;
+            const int width = size.width() & ~1;
+            const int height = planar ? size.height() & ~1 : size.height();
+            const int srcStride = planar ? width : width * conversion.srcBitsPerPixel / 8;
+            const int dstStride = width * conversion.dstBytesPerPixel;
+
+            QVector<quint8> src(width * height * conversion.srcBitsPerPixel / 8);
+            QVector<quint8> dst(dstStride * height + 1);
+            fillSource(src);
+
+            DSConversionJob job;
+            job.kind = conversion.kind;
+            job.width = width;
+            job.height = height;
+            job.matrix = &matrix;
+            job.bgr = conversion.bgr;
+            job.dst = dst.data();
+            job.dstStride = dstStride;
+            if (conversion.bottomUp) {
+                job.src = src.constData() + (height - 1) * srcStride;
+                job.srcStride = -srcStride;
+            } else {
+                job.src = src.constData();
+                job.srcStride = srcStride;
+            }
+            if (planar) {
+                job.srcU = src.constData() + width * height;
+                job.srcV = job.srcU + width * height / 4;
+                job.srcUVStride = conversion.kind == DSConversionJob::Nv12ToRgb24 ? width : width / 2;
+            }
+            QVector<quint8> preview;
+            if (conversion.previewFactor) {
+                const int factor = conversion.previewFactor;
+                preview.resize((width / factor) * (height / factor) * conversion.dstBytesPerPixel);
+                job.preview = preview.data();
+                job.previewStride = (width / factor) * conversion.dstBytesPerPixel;
+                job.previewFactor = factor;
+            }
+
+            const LegacyRun legacy = { &conversion, src.constData(), dst.data(), width, height };
+            const double legacyNs = measure(legacy, m_minimumTime);
+            results << makeResult(conversion, QLatin1String("legacy"), size, 1, legacyNs, legacyNs);
+
+            if (conversion.scalar) {
+                const ScalarRun scalar = { &conversion, &job };
+                results << makeResult(conversion, QLatin1String("C"), size, 1,
+                                      measure(scalar, m_minimumTime), legacyNs);
+            }
+
+            DSBandConverter converter(1);
+            const BandedRun single = { &converter, &job };
+            results << makeResult(conversion, QString::fromLatin1("%1 x1").arg(instructionSet), size, 1,
+                                  measure(single, m_minimumTime), legacyNs);
+
+            foreach (int threads, m_threadCounts) {
+                converter.setThreadCount(threads);
+                const BandedRun banded = { &converter, &job };
+                const QString variant = QString::fromLatin1("%1 x%2").arg(instructionSet).arg(threads);
+                results << makeResult(conversion, variant, size, threads,
+                                      measure(banded, m_minimumTime), legacyNs);
+            }
+        }
+    }
+
+    return results;
+}
+
+QList<DSBenchmarkResult> DSConversionBenchmark::runJpeg(const QList<QByteArray> &frames) const
+{
+    QList<DSBenchmarkResult> results;
+    if (frames.isEmpty())
+        return results;
+
+    DSJpegDecoder decoder;
+    const QSize size = decoder.start(reinterpret_cast<const quint8 *>(frames.first().constData()),
+                                     frames.first().size());
+    if (size.isEmpty()) {
+        qWarning() << "DSConversionBenchmark: not a JPEG frame";
+        return results;
+    }
+
+    const Conversion conversion = { "MJPG -> RGB24", DSConversionJob::Bgr24ToRgb24, 0, 3, false, 0, 0 };
+    qint64 bytes = 0;
+    foreach (const QByteArray &frame, frames)
+        bytes += frame.size();
+    const double bytesPerFrame = double(bytes) / frames.size();
+
+    struct Variant {
+        const char *name;
+        int scale;
+        bool crop;
+        bool resize;
+    };
+    const Variant variants[] = {
+        { "1/1", 1, false, false },
+        { "1/2", 2, false, false },
+        { "1/4", 4, false, false },
+        { "1/8", 8, false, false },
+        { "1/1+resize", 1, false, true },
+        { "crop", 1, true, false }
+    };
+
+    QVector<quint8> dst(size.width() * size.height() * 3);
+    double fullNs = 0;
+    for (int v = 0; v < int(sizeof(variants) / sizeof(variants[0])); ++v) {
+        const Variant &variant = variants[v];
+        decoder.setScale(variant.scale);
+        decoder.setRegion(variant.crop ? QRect(size.width() / 4, size.height() / 4,
+                                               size.width() / 2, size.height() / 2)
+                                       : QRect());
+
+        cv::Mat resized;
+        if (variant.resize)
+            resized.create(size.height() / 4, size.width() / 4, CV_8UC3);
+
+        int next = 0;
+        const JpegRun run = { &decoder, &frames, dst.data(), &next, &resized };
+        const double ns = measure(run, m_minimumTime);
+        if (v == 0)
+            fullNs = ns;
+
+        // per pixel of the full frame, so the variants compare directly;
+        // throughput counts compressed bytes
+        DSBenchmarkResult result = makeResult(conversion, QLatin1String(variant.name), size, 1, ns, fullNs);
+        result.megabytesPerSecond = bytesPerFrame / ns * 1000.0;
+        results << result;
+    }
+
+    return results;
+}
+
+QList<DSBenchmarkResult> DSConversionBenchmark::runCameras(int cameraCount) const
+{
+    QList<DSBenchmarkResult> results;
+    if (cameraCount < 1)
+        return results;
+
+    const QByteArray name = QByteArray::number(cameraCount) + " x YUY2 -> RGB24";
+    const Conversion conversion = { name.constData(), DSConversionJob::Yuy2ToRgb24, 16, 3, false, 0, 0, 0 };
+    const int cores = qMax(1, QThread::idealThreadCount());
+
+    foreach (const QSize &size, m_sizes) {
+        double perCameraNs = 0;
+        for (int shared = 0; shared < 2; ++shared) {
+            DSFrameScheduler *scheduler = shared ? new DSFrameScheduler(cores) : 0;
+            QList<DSFrameProcessor *> processors;
+            QList<DSSyntheticFrameSource *> sources;
+            for (int i = 0; i < cameraCount; ++i) {
+                // a source blocks until its camera takes the frame, so each
+                // one delivers as fast as it is served
+                DSFrameProcessor *processor = new DSFrameProcessor;
+                processor->setBackpressurePolicy(DSFrameProcessor::BlockWithTimeout, 1000);
+                if (scheduler)
+                    scheduler->add(processor);
+                else
+                    processor->setWorkerThreadEnabled(true);
+
+                DSSyntheticFrameSource *source =
+                        new DSSyntheticFrameSource(DSFrameFormat::YUY2, size.width(), size.height(), 0);
+                source->start(processor);
+                processors << processor;
+                sources << source;
+            }
+
+            // frames emitted by all cameras together once they are under way
+            QThread::msleep(qMax(20, m_minimumTime / 10));
+            foreach (DSFrameProcessor *processor, processors)
+                processor->latencyTracer()->reset();
+            QElapsedTimer timer;
+            timer.start();
+            QThread::msleep(qMax(1, m_minimumTime));
+            qint64 frames = 0;
+            foreach (DSFrameProcessor *processor, processors)
+                frames += processor->latencyTracer()->statistics(DSLatencyTracer::IngestToEmit).count;
+            const qint64 elapsed = timer.nsecsElapsed();
+
+            foreach (DSSyntheticFrameSource *source, sources)
+                source->stop();
+            qDeleteAll(processors);
+            qDeleteAll(sources);
+            delete scheduler;
+
+            const double ns = frames ? double(elapsed) / frames : double(elapsed);
+            if (!shared)
+                perCameraNs = ns;
+            results << makeResult(conversion,
+                                  QLatin1String(shared ? "shared" : "per camera"), size,
+                                  shared ? cores : cores * cameraCount, ns, perCameraNs);
+        }
+    }
+
+    return results;
+}
+
+QString DSConversionBenchmark::toText(const QList<DSBenchmarkResult> &results)
+{
+    QString text;
+    foreach (const DSBenchmarkResult &result, results) {
+        text += QString::fromLatin1("%1 %2 %3 %4 ns/px %5 MB/s %6x\n")
+                .arg(result.conversion, -18)
+                .arg(QString::fromLatin1("%1x%2").arg(result.size.width()).arg(result.size.height()), -10)
+                .arg(result.variant, -10)
+                .arg(result.nsPerPixel, 8, 'f', 3)
+                .arg(result.megabytesPerSecond, 9, 'f', 1)
+                .arg(result.speedup, 6, 'f', 1);
+    }
+    return text;
+}
+
+QT_END_NAMESPACE
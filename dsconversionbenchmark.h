@@ -0,0 +1,124 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSCONVERSIONBENCHMARK_H
+#define DSCONVERSIONBENCHMARK_H
+
+#include <QtCore/qglobal.h>
+#include <QtCore/qbytearray.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qsize.h>
+#include <QtCore/qstring.h>
+
+QT_BEGIN_NAMESPACE
+
+struct DSBenchmarkResult
+{
+    QString conversion;         // e.g. "YUY2 -> RGB24"
+    QString variant;            // "legacy", "C", "SSE2 x1", "AVX2 x4", ...
+    QSize size;
+    int threads;
+    double nsPerPixel;
+    double megabytesPerSecond;  // source bytes
+    double speedup;             // relative to the legacy path
+};
+
+// Times every conversion DSFrameProcessor knows, at a set of resolutions.
+//
+// Each conversion is measured on the code path captureFrame() used before the
+// kernels existed (per pixel floating point yuv2rgb(), cv::flip() and
+// cv::cvtColor()), on the portable C kernel where there is one, on the kernel
+// dispatched for this CPU and on that kernel split into bands over the given
+// thread counts. Grey output is compared with RGB24 conversion followed by
+// cv::cvtColor(), what receivers wanting grey did before. Only QtCore and
+// OpenCV are needed, so it runs on any machine the session's dependencies
+// build on.
+//
+// MJPEG decoding is timed separately by runJpeg() on frames the caller
+// supplies, typically taken from a recording of the camera in question:
+// compressed frames depend too much on the scene to be made up here.
+class DSConversionBenchmark
+{
+public:
+    DSConversionBenchmark();
+
+    // defaults to VGA, 720p, 1080p and 2160p
+    void setSizes(const QList<QSize> &sizes);
+    QList<QSize> sizes() const { return m_sizes; }
+
+    // Thread counts for the banded runs, by default 2, 4, the powers of two
+    // below idealThreadCount() and idealThreadCount() itself. A single
+    // threaded banded run always happens.
+    void setThreadCounts(const QList<int> &threadCounts);
+    QList<int> threadCounts() const { return m_threadCounts; }
+
+    // How long each measurement repeats its conversion for.
+    void setMinimumTime(int msecs) { m_minimumTime = msecs; }
+    int minimumTime() const { return m_minimumTime; }
+
+    QList<DSBenchmarkResult> run() const;
+
+    // Decodes frames, all of one size, in full, at 1/2, 1/4 and 1/8 scale,
+    // in full followed by a resize to 1/4 and cropped to their centre
+    // quarter. The speedup is relative to the full decode.
+    QList<DSBenchmarkResult> runJpeg(const QList<QByteArray> &frames) const;
+
+    // Runs cameraCount synthetic YUY2 cameras of each size into RGB24, every
+    // one as fast as its frames are taken, for minimumTime: once with a
+    // worker thread and banded conversion per camera, as sessions do on their
+    // own, and once on one DSFrameScheduler with a thread per core. Results
+    // are for all cameras together, time per frame over the frames of every
+    // camera; the speedup is relative to the threads per camera, threads
+    // counts the threads converting.
+    QList<DSBenchmarkResult> runCameras(int cameraCount) const;
+
+    // One line per result, aligned for reading on a console.
+    static QString toText(const QList<DSBenchmarkResult> &results);
+
+private:
+    QList<QSize> m_sizes;
+    QList<int> m_threadCounts;
+    int m_minimumTime;
+};
+
+QT_END_NAMESPACE
+
+#endif
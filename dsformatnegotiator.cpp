@@ -0,0 +1,214 @@
+#include <QtCore/qalgorithms.h>
+#include <QtCore/qstring.h>
+
+#include "dsformatnegotiator.h"
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+// 3072 bytes per microframe, 8000 microframes a second
+const double Usb2IsochronousBandwidth = 3072.0 * 8000;
+
+// A typical webcam at its default quality; scenes with much detail take more.
+const double DefaultJpegBytesPerPixel = 0.25;
+
+// Nanoseconds per pixel on one core, RgbOutput, PlanarYuvOutput, LumaOutput.
+// Formats the processor hands out as RGB cost the same for every output.
+const double DefaultConversionCosts[DSFrameFormat::MJPG + 1][DSFrameProcessor::LumaOutput + 1] = {
+    { 0.0, 0.0, 0.0 },  // Invalid
+    { 0.4, 0.4, 0.4 },  // BGR24
+    { 0.5, 0.5, 0.5 },  // BGR32
+    { 0.8, 0.8, 0.8 },  // RGB555
+    { 1.0, 1.0, 0.3 },  // YUY2
+    { 1.0, 1.0, 0.3 },  // UYVY
+    { 0.9, 0.1, 0.1 },  // I420
+    { 0.9, 0.1, 0.1 },  // NV12
+    { 6.0, 6.0, 4.0 }   // MJPG
+};
+
+DSFrameFormat::PixelFormat pixelFormatNamed(const QString &name)
+{
+    static const char *const names[] = {
+        "", "RGB24", "RGB32", "RGB555", "YUY2", "UYVY", "I420", "NV12", "MJPG"
+    };
+    for (int i = DSFrameFormat::BGR24; i <= DSFrameFormat::MJPG; ++i) {
+        if (name == QLatin1String(names[i]))
+            return DSFrameFormat::PixelFormat(i);
+    }
+    return DSFrameFormat::Invalid;
+}
+
+bool isPlanarYuv(DSFrameFormat::PixelFormat format)
+{
+    return format == DSFrameFormat::I420 || format == DSFrameFormat::NV12;
+}
+
+bool isRgb(DSFrameFormat::PixelFormat format)
+{
+    return format == DSFrameFormat::BGR24 || format == DSFrameFormat::BGR32
+            || format == DSFrameFormat::RGB555;
+}
+
+bool cheaperThan(const DSFormatCandidate &a, const DSFormatCandidate &b)
+{
+    if (a.meetsTarget != b.meetsTarget)
+        return a.meetsTarget;
+
+    const double costA = a.busLoad + a.cpuLoad;
+    const double costB = b.busLoad + b.cpuLoad;
+    if (!a.meetsTarget && a.frameRate != b.frameRate)
+        return a.frameRate > b.frameRate;
+    if (costA != costB)
+        return costA < costB;
+    return a.frameRate > b.frameRate;
+}
+
+} // end namespace
+
+DSFormatNegotiator::DSFormatNegotiator()
+    : m_busBandwidth(Usb2IsochronousBandwidth)
+    , m_jpegBytesPerPixel(DefaultJpegBytesPerPixel)
+{
+    memcpy(m_conversionCosts, DefaultConversionCosts, sizeof(m_conversionCosts));
+}
+
+void DSFormatNegotiator::setConversionCost(DSFrameFormat::PixelFormat source,
+                                           DSFrameProcessor::OutputFormat output, double nsPerPixel)
+{
+    if (source > DSFrameFormat::Invalid && source < PixelFormatCount && output < OutputFormatCount)
+        m_conversionCosts[source][output] = nsPerPixel;
+}
+
+double DSFormatNegotiator::conversionCost(DSFrameFormat::PixelFormat source,
+                                          DSFrameProcessor::OutputFormat output) const
+{
+    if (source <= DSFrameFormat::Invalid || source >= PixelFormatCount || output >= OutputFormatCount)
+        return 0;
+    return m_conversionCosts[source][output];
+}
+
+void DSFormatNegotiator::setConversionCosts(const QList<DSBenchmarkResult> &results)
+{
+    double sums[PixelFormatCount][OutputFormatCount];
+    int counts[PixelFormatCount][OutputFormatCount];
+    memset(sums, 0, sizeof(sums));
+    memset(counts, 0, sizeof(counts));
+
+    const QLatin1String arrow(" -> ");
+    foreach (const DSBenchmarkResult &result, results) {
+        // "YUY2 -> RGB24"; previews ("+1/2") and multithreaded runs do not
+        // say what a frame costs
+        const int split = result.conversion.indexOf(arrow);
+        if (split < 0 || result.conversion.contains(QLatin1Char('+')) || result.threads != 1)
+            continue;
+
+        const DSFrameFormat::PixelFormat source = pixelFormatNamed(result.conversion.left(split));
+        const QString target = result.conversion.mid(split + 4);
+        if (source == DSFrameFormat::Invalid)
+            continue;
+        if (source == DSFrameFormat::MJPG ? result.variant != QLatin1String("1/1")
+                : result.variant == QLatin1String("legacy") || result.variant == QLatin1String("C"))
+            continue;
+
+        DSFrameProcessor::OutputFormat output;
+        if (target == QLatin1String("RGB24"))
+            output = DSFrameProcessor::RgbOutput;
+        else if (target == QLatin1String("GREY"))
+            output = DSFrameProcessor::LumaOutput;
+        else
+            continue;
+
+        sums[source][output] += result.nsPerPixel;
+        ++counts[source][output];
+    }
+
+    for (int source = DSFrameFormat::BGR24; source < PixelFormatCount; ++source) {
+        if (counts[source][DSFrameProcessor::RgbOutput]) {
+            const double rgb = sums[source][DSFrameProcessor::RgbOutput] / counts[source][DSFrameProcessor::RgbOutput];
+            const double defaultRgb = DefaultConversionCosts[source][DSFrameProcessor::RgbOutput];
+
+            m_conversionCosts[source][DSFrameProcessor::RgbOutput] = rgb;
+            if (!isPlanarYuv(DSFrameFormat::PixelFormat(source)))
+                m_conversionCosts[source][DSFrameProcessor::PlanarYuvOutput] = rgb;
+            // decoding to grey is not measured; it keeps its share of the
+            // decode to RGB
+            if (isRgb(DSFrameFormat::PixelFormat(source)))
+                m_conversionCosts[source][DSFrameProcessor::LumaOutput] = rgb;
+            else if (source == DSFrameFormat::MJPG)
+                m_conversionCosts[source][DSFrameProcessor::LumaOutput] =
+                        rgb * DefaultConversionCosts[source][DSFrameProcessor::LumaOutput] / defaultRgb;
+        }
+        if (counts[source][DSFrameProcessor::LumaOutput]) {
+            m_conversionCosts[source][DSFrameProcessor::LumaOutput] =
+                    sums[source][DSFrameProcessor::LumaOutput] / counts[source][DSFrameProcessor::LumaOutput];
+        }
+    }
+}
+
+double DSFormatNegotiator::frameBytes(const DSDeviceFormat &format) const
+{
+    const double pixels = double(format.width) * qAbs(format.height);
+    switch (format.pixelFormat) {
+    case DSFrameFormat::BGR24:
+        return pixels * 3;
+    case DSFrameFormat::BGR32:
+        return pixels * 4;
+    case DSFrameFormat::RGB555:
+    case DSFrameFormat::YUY2:
+    case DSFrameFormat::UYVY:
+        return pixels * 2;
+    case DSFrameFormat::I420:
+    case DSFrameFormat::NV12:
+        return pixels * 3 / 2;
+    case DSFrameFormat::MJPG:
+        return pixels * m_jpegBytesPerPixel;
+    default:
+        return 0;
+    }
+}
+
+QList<DSFormatCandidate> DSFormatNegotiator::rank(const QList<DSDeviceFormat> &formats,
+                                                  const DSFormatRequest &request) const
+{
+    QList<DSFormatCandidate> candidates;
+    foreach (const DSDeviceFormat &format, formats) {
+        if (!request.size.isEmpty() && (format.width != request.size.width()
+                                        || qAbs(format.height) != request.size.height()))
+            continue;
+
+        const double bytes = frameBytes(format);
+        if (bytes <= 0)
+            continue;
+
+        DSFormatCandidate candidate;
+        candidate.format = format;
+        candidate.frameRate = qMin(format.frameRate, qreal(m_busBandwidth / bytes));
+        candidate.meetsTarget = candidate.frameRate >= request.frameRate;
+
+        // what it costs to deliver the request, or all the format can
+        const double rate = request.frameRate > 0 ? qMin(request.frameRate, candidate.frameRate)
+                                                  : candidate.frameRate;
+        const double pixels = double(format.width) * qAbs(format.height);
+        candidate.busBytesPerSecond = bytes * rate;
+        candidate.busLoad = candidate.busBytesPerSecond / m_busBandwidth;
+        candidate.cpuLoad = conversionCost(format.pixelFormat, request.outputFormat) * pixels * rate / 1e9;
+        candidates.append(candidate);
+    }
+
+    qStableSort(candidates.begin(), candidates.end(), cheaperThan);
+    return candidates;
+}
+
+bool DSFormatNegotiator::negotiate(const QList<DSDeviceFormat> &formats, const DSFormatRequest &request,
+                                   DSDeviceFormat *format) const
+{
+    const QList<DSFormatCandidate> candidates = rank(formats, request);
+    if (candidates.isEmpty())
+        return false;
+
+    *format = candidates.first().format;
+    return candidates.first().meetsTarget;
+}
+
+QT_END_NAMESPACE
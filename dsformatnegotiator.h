@@ -0,0 +1,143 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSFORMATNEGOTIATOR_H
+#define DSFORMATNEGOTIATOR_H
+
+#include <QtCore/qglobal.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qsize.h>
+
+#include "dscapabilitycache.h"
+#include "dsconversionbenchmark.h"
+#include "dsframeprocessor.h"
+
+QT_BEGIN_NAMESPACE
+
+// What the consumer of a session wants.
+struct DSFormatRequest
+{
+    DSFormatRequest()
+        : frameRate(0)
+        , outputFormat(DSFrameProcessor::RgbOutput)
+    {
+    }
+
+    QSize size;                 // empty for any size
+    qreal frameRate;            // at least, 0 for any rate
+    DSFrameProcessor::OutputFormat outputFormat;
+};
+
+// A device format as DSFormatNegotiator sees it.
+struct DSFormatCandidate
+{
+    DSDeviceFormat format;
+    qreal frameRate;            // the advertised rate as far as the bus carries it
+    double busBytesPerSecond;   // at the requested rate, or frameRate without one
+    double busLoad;             // share of the bus bandwidth that takes
+    double cpuLoad;             // cores busy converting at the same rate
+    bool meetsTarget;
+};
+
+// Picks the capture format that delivers a size and rate for the least cost,
+// instead of the first one of the right size.
+//
+// Formats of the requested size are ranked by what they cost at the requested
+// rate: the share of the bus their frames take plus the cores the processor
+// keeps busy converting them to the output format. YUY2 at 1080p costs little
+// CPU but does not fit through USB 2 at 30 fps; MJPG fits easily and costs a
+// decode. A bus taken up entirely weighs as much as a core kept busy, so on
+// USB 2 MJPG tends to win even where a raw format would just fit, leaving
+// room for other devices on the bus. The rate a format reaches is the one it
+// advertises, cut down to what the bus can carry. Formats that reach the
+// requested rate come first, cheapest first; the rest follow, fastest first.
+//
+// Conversion costs start out as rough estimates for one core of a desktop CPU;
+// setConversionCosts() replaces them with what DSConversionBenchmark measured
+// on the machine at hand. Only QtCore is needed, the ranking works on any list
+// of formats.
+class DSFormatNegotiator
+{
+public:
+    DSFormatNegotiator();
+
+    // Bytes per second the device may move, by default the 24.576 MB/s of
+    // isochronous transfers on USB 2.
+    void setBusBandwidth(double bytesPerSecond) { m_busBandwidth = bytesPerSecond; }
+    double busBandwidth() const { return m_busBandwidth; }
+
+    // Size of an MJPG frame per pixel; depends on the camera and the scene,
+    // the average of a recording is a good value.
+    void setJpegBytesPerPixel(double bytesPerPixel) { m_jpegBytesPerPixel = bytesPerPixel; }
+    double jpegBytesPerPixel() const { return m_jpegBytesPerPixel; }
+
+    // Nanoseconds per pixel of making output from frames of source.
+    void setConversionCost(DSFrameFormat::PixelFormat source, DSFrameProcessor::OutputFormat output,
+                           double nsPerPixel);
+    double conversionCost(DSFrameFormat::PixelFormat source, DSFrameProcessor::OutputFormat output) const;
+
+    // Takes the single threaded results of DSConversionBenchmark::run() and
+    // the full decode of runJpeg(), averaged over their sizes.
+    void setConversionCosts(const QList<DSBenchmarkResult> &results);
+
+    // Bytes one frame of format takes on the bus.
+    double frameBytes(const DSDeviceFormat &format) const;
+
+    QList<DSFormatCandidate> rank(const QList<DSDeviceFormat> &formats, const DSFormatRequest &request) const;
+
+    // The first of rank(), true if it meets the request.
+    bool negotiate(const QList<DSDeviceFormat> &formats, const DSFormatRequest &request,
+                   DSDeviceFormat *format) const;
+
+private:
+    enum {
+        PixelFormatCount = DSFrameFormat::MJPG + 1,
+        OutputFormatCount = DSFrameProcessor::LumaOutput + 1
+    };
+
+    double m_busBandwidth;
+    double m_jpegBytesPerPixel;
+    double m_conversionCosts[PixelFormatCount][OutputFormatCount];
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,1126 @@
+#include "dsframeconverter.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define DS_HAVE_SSE2
+#  include <emmintrin.h>
+#  if defined(Q_CC_MSVC) || defined(Q_CC_GNU) || defined(Q_CC_CLANG)
+#    define DS_HAVE_AVX2
+#    include <immintrin.h>
+#    ifdef Q_CC_MSVC
+#      include <intrin.h>
+#    endif
+#  endif
+#endif
+
+#if defined(DS_HAVE_AVX2) && !defined(Q_CC_MSVC)
+#  define DS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#  define DS_TARGET_AVX2
+#endif
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+// Coefficients are 3.13 fixed point. Inputs are shifted left by 7 before the
+// 16 bit high multiply, which leaves every term with 4 fractional bits; the
+// terms are summed, rounded and shifted once. The scalar code performs exactly
+// the same integer operations as the SIMD code, so all paths are bit-exact.
+//
+//            y               yOffset  rv     gu     gv     bu
+const DSColorMatrix colorMatrices[2][2] = {
+    { { 9539, 16, 13075, -3209, -6660, 16525 },   // BT.601 limited range
+      { 8192,  0, 11485, -2819, -5850, 14516 } }, // BT.601 full range
+    { { 9539, 16, 14686, -1747, -4366, 17305 },   // BT.709 limited range
+      { 8192,  0, 12901, -1535, -3835, 15201 } }  // BT.709 full range
+};
+
+const int FractionBits = 4;
+const int Rounding = 1 << (FractionBits - 1);
+
+inline int mulhi(int x, int coeff)
+{
+    return (x * 128 * coeff) >> 16;
+}
+
+inline quint8 clampByte(int x)
+{
+    return quint8(x > 255 ? 255 : x < 0 ? 0 : x);
+}
+
+inline void yuvToRgb(int y, int u, int v, const DSColorMatrix &m, quint8 *r, quint8 *g, quint8 *b)
+{
+    u -= 128;
+    v -= 128;
+    const int yy = mulhi(y - m.yOffset, m.y) + Rounding;
+    *r = clampByte((yy + mulhi(v, m.rv)) >> FractionBits);
+    *g = clampByte((yy + mulhi(u, m.gu) + mulhi(v, m.gv)) >> FractionBits);
+    *b = clampByte((yy + mulhi(u, m.bu)) >> FractionBits);
+}
+
+// Converts one row of 4:2:2 macropixels, two output pixels each. yi is the
+// offset of the first Y byte: 0 for YUY2 (Y0 U Y1 V), 1 for UYVY (U Y0 V Y1).
+inline void yuv422RowScalar(const quint8 *src, quint8 *dst, int pairs,
+                            const DSColorMatrix &m, int yi, int ri, int bi)
+{
+    const int ci = 1 - yi;
+    for (int i = 0; i < pairs; ++i) {
+        const int u = src[ci];
+        const int v = src[ci + 2];
+        yuvToRgb(src[yi], u, v, m, dst + ri, dst + 1, dst + bi);
+        yuvToRgb(src[yi + 2], u, v, m, dst + 3 + ri, dst + 4, dst + 3 + bi);
+        src += 4;
+        dst += 6;
+    }
+}
+
+inline void bgr24RowScalar(const quint8 *src, quint8 *dst, int pixels)
+{
+    for (int i = 0; i < pixels; ++i) {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+        src += 3;
+        dst += 3;
+    }
+}
+
+inline void bgr32RowScalar(const quint8 *src, quint8 *dst, int pixels)
+{
+    for (int i = 0; i < pixels; ++i) {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+        src += 4;
+        dst += 3;
+    }
+}
+
+// Widens a 5 bit channel so that 0 maps to 0 and 31 to 255.
+inline quint8 expand5(int c)
+{
+    return quint8((c << 3) | (c >> 2));
+}
+
+inline void rgb555RowScalar(const quint8 *src, quint8 *dst, int pixels)
+{
+    for (int i = 0; i < pixels; ++i) {
+        const int px = src[0] | (src[1] << 8);
+        dst[0] = expand5((px >> 10) & 0x1f);
+        dst[1] = expand5((px >> 5) & 0x1f);
+        dst[2] = expand5(px & 0x1f);
+        src += 2;
+        dst += 3;
+    }
+}
+
+// Converts one row of 4:2:0 pixels. Chroma sample i is u[i * chromaStep], so
+// the same code reads separate I420 planes (step 1) and NV12 pairs (step 2).
+inline void yuv420RowScalar(const quint8 *y, const quint8 *u, const quint8 *v, int chromaStep,
+                            quint8 *dst, int width, const DSColorMatrix &m, int ri, int bi)
+{
+    for (int x = 0; x < width; ++x) {
+        const int c = (x >> 1) * chromaStep;
+        yuvToRgb(y[x], u[c], v[c], m, dst + ri, dst + 1, dst + bi);
+        dst += 3;
+    }
+}
+
+// Picks the Y bytes out of a row of 4:2:2 pixels, yi as for yuv422RowScalar().
+inline void yuv422LumaRowScalar(const quint8 *src, quint8 *dst, int pixels, int yi)
+{
+    src += yi;
+    for (int x = 0; x < pixels; ++x)
+        dst[x] = src[2 * x];
+}
+
+#ifdef DS_HAVE_SSE2
+
+struct Sse2Matrix
+{
+    explicit Sse2Matrix(const DSColorMatrix &m)
+        : y(_mm_set1_epi16(m.y))
+        , yOffset(_mm_set1_epi16(m.yOffset))
+        , rv(_mm_set1_epi16(m.rv))
+        , gu(_mm_set1_epi16(m.gu))
+        , gv(_mm_set1_epi16(m.gv))
+        , bu(_mm_set1_epi16(m.bu))
+    {
+    }
+
+    __m128i y;
+    __m128i yOffset;
+    __m128i rv;
+    __m128i gu;
+    __m128i gv;
+    __m128i bu;
+};
+
+// 8 pixels of 16 bit Y, U and V in, 8 unclamped 16 bit R, G and B values out.
+inline void yuvToRgbSse2(__m128i y, __m128i u, __m128i v, const Sse2Matrix &m,
+                         __m128i *r, __m128i *g, __m128i *b)
+{
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i rounding = _mm_set1_epi16(Rounding);
+
+    y = _mm_slli_epi16(_mm_sub_epi16(y, m.yOffset), 7);
+    u = _mm_slli_epi16(_mm_sub_epi16(u, bias), 7);
+    v = _mm_slli_epi16(_mm_sub_epi16(v, bias), 7);
+
+    const __m128i yy = _mm_add_epi16(_mm_mulhi_epi16(y, m.y), rounding);
+    *r = _mm_srai_epi16(_mm_add_epi16(yy, _mm_mulhi_epi16(v, m.rv)), FractionBits);
+    *g = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(yy, _mm_mulhi_epi16(u, m.gu)),
+                                      _mm_mulhi_epi16(v, m.gv)), FractionBits);
+    *b = _mm_srai_epi16(_mm_add_epi16(yy, _mm_mulhi_epi16(u, m.bu)), FractionBits);
+}
+
+// Splits 8 YUY2 pixels into 16 bit Y and per pixel U and V. UYVY is turned
+// into YUY2 first by swapping the bytes of every 16 bit word.
+inline void unpackYuy2Sse2(__m128i px, bool uyvy, __m128i *y, __m128i *u, __m128i *v)
+{
+    const __m128i lowByte = _mm_set1_epi16(0x00ff);
+    if (uyvy)
+        px = _mm_or_si128(_mm_slli_epi16(px, 8), _mm_srli_epi16(px, 8));
+
+    const __m128i lowWord = _mm_set1_epi32(0x0000ffff);
+
+    *y = _mm_and_si128(px, lowByte);
+    const __m128i uv = _mm_srli_epi16(px, 8);
+    const __m128i uu = _mm_and_si128(uv, lowWord);
+    const __m128i vv = _mm_srli_epi32(uv, 16);
+    *u = _mm_or_si128(uu, _mm_slli_epi32(uu, 16));
+    *v = _mm_or_si128(vv, _mm_slli_epi32(vv, 16));
+}
+
+// Interleaves 16 bytes of each plane into 48 bytes of c0 c1 c2 triplets. SSE2
+// has no byte shuffle, so this goes through the stack.
+inline void storeInterleaved3Sse2(quint8 *dst, __m128i c0, __m128i c1, __m128i c2)
+{
+    union { __m128i v[3]; quint8 c[3][16]; } planes;
+    planes.v[0] = c0;
+    planes.v[1] = c1;
+    planes.v[2] = c2;
+    for (int p = 0; p < 16; ++p) {
+        dst[0] = planes.c[0][p];
+        dst[1] = planes.c[1][p];
+        dst[2] = planes.c[2][p];
+        dst += 3;
+    }
+}
+
+void yuv422ToRgb24Sse2(const quint8 *src, int srcStride, quint8 *dst, int dstStride,
+                       int width, int height, const DSColorMatrix &matrix,
+                       bool uyvy, int ri, int bi)
+{
+    const Sse2Matrix m(matrix);
+    const int blocks = width / 16;
+    const int tail = (width - blocks * 16) / 2;
+
+    for (int row = 0; row < height; ++row) {
+        const quint8 *s = src + row * srcStride;
+        quint8 *d = dst + row * dstStride;
+
+        for (int i = 0; i < blocks; ++i) {
+            __m128i y, u, v, r0, g0, b0, r1, g1, b1;
+            unpackYuy2Sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s)), uyvy, &y, &u, &v);
+            yuvToRgbSse2(y, u, v, m, &r0, &g0, &b0);
+            unpackYuy2Sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 16)), uyvy, &y, &u, &v);
+            yuvToRgbSse2(y, u, v, m, &r1, &g1, &b1);
+
+            const __m128i r = _mm_packus_epi16(r0, r1);
+            const __m128i b = _mm_packus_epi16(b0, b1);
+            storeInterleaved3Sse2(d, ri == 0 ? r : b, _mm_packus_epi16(g0, g1), ri == 0 ? b : r);
+            s += 32;
+            d += 48;
+        }
+        yuv422RowScalar(s, d, tail, matrix, uyvy ? 1 : 0, ri, bi);
+    }
+}
+
+// Chroma row r / 2 serves output rows r and r + 1. For NV12 u points at the
+// interleaved plane and v at the byte after it.
+void yuv420ToRgb24Sse2(const quint8 *y, int yStride, const quint8 *u, const quint8 *v,
+                       int uvStride, bool interleaved, quint8 *dst, int dstStride,
+                       int width, int height, const DSColorMatrix &matrix, int ri, int bi)
+{
+    const Sse2Matrix m(matrix);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lowByte = _mm_set1_epi16(0x00ff);
+    const int chromaStep = interleaved ? 2 : 1;
+    const int blocks = width / 16;
+
+    for (int row = 0; row < height; ++row) {
+        const quint8 *ys = y + row * yStride;
+        const quint8 *us = u + (row >> 1) * uvStride;
+        const quint8 *vs = v + (row >> 1) * uvStride;
+        quint8 *d = dst + row * dstStride;
+
+        for (int i = 0; i < blocks; ++i) {
+            // 8 chroma samples as 16 bit values
+            __m128i uu, vv;
+            if (interleaved) {
+                const __m128i uv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(us));
+                uu = _mm_and_si128(uv, lowByte);
+                vv = _mm_srli_epi16(uv, 8);
+            } else {
+                uu = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(us)), zero);
+                vv = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(vs)), zero);
+            }
+
+            const __m128i yy = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ys));
+            __m128i r0, g0, b0, r1, g1, b1;
+            yuvToRgbSse2(_mm_unpacklo_epi8(yy, zero), _mm_unpacklo_epi16(uu, uu),
+                         _mm_unpacklo_epi16(vv, vv), m, &r0, &g0, &b0);
+            yuvToRgbSse2(_mm_unpackhi_epi8(yy, zero), _mm_unpackhi_epi16(uu, uu),
+                         _mm_unpackhi_epi16(vv, vv), m, &r1, &g1, &b1);
+
+            const __m128i r = _mm_packus_epi16(r0, r1);
+            const __m128i b = _mm_packus_epi16(b0, b1);
+            storeInterleaved3Sse2(d, ri == 0 ? r : b, _mm_packus_epi16(g0, g1), ri == 0 ? b : r);
+            ys += 16;
+            us += 8 * chromaStep;
+            vs += 8 * chromaStep;
+            d += 48;
+        }
+        yuv420RowScalar(ys, us, vs, chromaStep, d, width - blocks * 16, matrix, ri, bi);
+    }
+}
+
+// Splits 8 X1R5G5B5 pixels into 16 bit R, G and B widened to 8 bits each.
+inline void unpackRgb555Sse2(__m128i px, __m128i *r, __m128i *g, __m128i *b)
+{
+    const __m128i mask = _mm_set1_epi16(0x1f);
+    const __m128i r5 = _mm_and_si128(_mm_srli_epi16(px, 10), mask);
+    const __m128i g5 = _mm_and_si128(_mm_srli_epi16(px, 5), mask);
+    const __m128i b5 = _mm_and_si128(px, mask);
+
+    *r = _mm_or_si128(_mm_slli_epi16(r5, 3), _mm_srli_epi16(r5, 2));
+    *g = _mm_or_si128(_mm_slli_epi16(g5, 3), _mm_srli_epi16(g5, 2));
+    *b = _mm_or_si128(_mm_slli_epi16(b5, 3), _mm_srli_epi16(b5, 2));
+}
+
+void rgb555ToRgb24Sse2(const quint8 *src, int srcStride, quint8 *dst, int dstStride,
+                       int width, int height)
+{
+    const int blocks = width / 16;
+    const int tail = width - blocks * 16;
+
+    for (int row = 0; row < height; ++row) {
+        const quint8 *s = src + row * srcStride;
+        quint8 *d = dst + row * dstStride;
+
+        for (int i = 0; i < blocks; ++i) {
+            __m128i r0, g0, b0, r1, g1, b1;
+            unpackRgb555Sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s)), &r0, &g0, &b0);
+            unpackRgb555Sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 16)), &r1, &g1, &b1);
+            storeInterleaved3Sse2(d, _mm_packus_epi16(r0, r1), _mm_packus_epi16(g0, g1),
+                                  _mm_packus_epi16(b0, b1));
+            s += 32;
+            d += 48;
+        }
+        rgb555RowScalar(s, d, tail);
+    }
+}
+
+void yuv422ToLumaSse2(const quint8 *src, int srcStride, quint8 *dst, int dstStride,
+                      int width, int height, bool uyvy)
+{
+    const __m128i lowByte = _mm_set1_epi16(0x00ff);
+    const int blocks = width / 16;
+    const int tail = width - blocks * 16;
+
+    for (int row = 0; row < height; ++row) {
+        const quint8 *s = src + row * srcStride;
+        quint8 *d = dst + row * dstStride;
+
+        for (int i = 0; i < blocks; ++i) {
+            __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+            __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 16));
+            if (uyvy) {
+                p0 = _mm_srli_epi16(p0, 8);
+                p1 = _mm_srli_epi16(p1, 8);
+            } else {
+                p0 = _mm_and_si128(p0, lowByte);
+                p1 = _mm_and_si128(p1, lowByte);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(d), _mm_packus_epi16(p0, p1));
+            s += 32;
+            d += 16;
+        }
+        yuv422LumaRowScalar(s, d, tail, uyvy ? 1 : 0);
+    }
+}
+
+#endif // DS_HAVE_SSE2
+
+#ifdef DS_HAVE_AVX2
+
+struct Avx2Matrix
+{
+    DS_TARGET_AVX2 explicit Avx2Matrix(const DSColorMatrix &m)
+        : y(_mm256_set1_epi16(m.y))
+        , yOffset(_mm256_set1_epi16(m.yOffset))
+        , rv(_mm256_set1_epi16(m.rv))
+        , gu(_mm256_set1_epi16(m.gu))
+        , gv(_mm256_set1_epi16(m.gv))
+        , bu(_mm256_set1_epi16(m.bu))
+    {
+    }
+
+    __m256i y;
+    __m256i yOffset;
+    __m256i rv;
+    __m256i gu;
+    __m256i gv;
+    __m256i bu;
+};
+
+// 16 pixels of 16 bit Y, U and V in, 16 unclamped 16 bit R, G and B values out.
+DS_TARGET_AVX2 inline void yuvToRgbAvx2(__m256i y, __m256i u, __m256i v, const Avx2Matrix &m,
+                                        __m256i *r, __m256i *g, __m256i *b)
+{
+    const __m256i bias = _mm256_set1_epi16(128);
+    const __m256i rounding = _mm256_set1_epi16(Rounding);
+
+    y = _mm256_slli_epi16(_mm256_sub_epi16(y, m.yOffset), 7);
+    u = _mm256_slli_epi16(_mm256_sub_epi16(u, bias), 7);
+    v = _mm256_slli_epi16(_mm256_sub_epi16(v, bias), 7);
+
+    const __m256i yy = _mm256_add_epi16(_mm256_mulhi_epi16(y, m.y), rounding);
+    *r = _mm256_srai_epi16(_mm256_add_epi16(yy, _mm256_mulhi_epi16(v, m.rv)), FractionBits);
+    *g = _mm256_srai_epi16(_mm256_add_epi16(_mm256_add_epi16(yy, _mm256_mulhi_epi16(u, m.gu)),
+                                            _mm256_mulhi_epi16(v, m.gv)), FractionBits);
+    *b = _mm256_srai_epi16(_mm256_add_epi16(yy, _mm256_mulhi_epi16(u, m.bu)), FractionBits);
+}
+
+// Splits 16 YUY2 or UYVY pixels into 16 bit Y and per pixel U and V.
+DS_TARGET_AVX2 inline void unpackYuy2Avx2(__m256i px, bool uyvy, __m256i *y, __m256i *u, __m256i *v)
+{
+    const __m256i lowByte = _mm256_set1_epi16(0x00ff);
+    if (uyvy)
+        px = _mm256_or_si256(_mm256_slli_epi16(px, 8), _mm256_srli_epi16(px, 8));
+
+    const __m256i lowWord = _mm256_set1_epi32(0x0000ffff);
+
+    *y = _mm256_and_si256(px, lowByte);
+    const __m256i uv = _mm256_srli_epi16(px, 8);
+    const __m256i uu = _mm256_and_si256(uv, lowWord);
+    const __m256i vv = _mm256_srli_epi32(uv, 16);
+    *u = _mm256_or_si256(uu, _mm256_slli_epi32(uu, 16));
+    *v = _mm256_or_si256(vv, _mm256_slli_epi32(vv, 16));
+}
+
+// Interleaves 16 bytes of each plane c0, c1, c2 into 48 bytes of c0 c1 c2 triplets.
+DS_TARGET_AVX2 inline void storeInterleaved3(quint8 *dst, __m128i c0, __m128i c1, __m128i c2)
+{
+    const __m128i m00 = _mm_setr_epi8(0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5);
+    const __m128i m01 = _mm_setr_epi8(-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1);
+    const __m128i m02 = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+    const __m128i m10 = _mm_setr_epi8(-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1);
+    const __m128i m11 = _mm_setr_epi8(5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10);
+    const __m128i m12 = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1);
+    const __m128i m20 = _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1);
+    const __m128i m21 = _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1);
+    const __m128i m22 = _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15);
+
+    __m128i *d = reinterpret_cast<__m128i *>(dst);
+    _mm_storeu_si128(d, _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(c0, m00), _mm_shuffle_epi8(c1, m01)),
+                                     _mm_shuffle_epi8(c2, m02)));
+    _mm_storeu_si128(d + 1, _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(c0, m10), _mm_shuffle_epi8(c1, m11)),
+                                         _mm_shuffle_epi8(c2, m12)));
+    _mm_storeu_si128(d + 2, _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(c0, m20), _mm_shuffle_epi8(c1, m21)),
+                                         _mm_shuffle_epi8(c2, m22)));
+}
+
+DS_TARGET_AVX2 void yuv422ToRgb24Avx2(const quint8 *src, int srcStride, quint8 *dst, int dstStride,
+                                      int width, int height, const DSColorMatrix &matrix,
+                                      bool uyvy, int ri, int bi)
+{
+    const Avx2Matrix m(matrix);
+    const int blocks = width / 32;
+    const int tail = (width - blocks * 32) / 2;
+
+    for (int row = 0; row < height; ++row) {
+        const quint8 *s = src + row * srcStride;
+        quint8 *d = dst + row * dstStride;
+
+        for (int i = 0; i < blocks; ++i) {
+            __m256i y, u, v, r0, g0, b0, r1, g1, b1;
+            unpackYuy2Avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(s)), uyvy, &y, &u, &v);
+            yuvToRgbAvx2(y, u, v, m, &r0, &g0, &b0);
+            unpackYuy2Avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 32)), uyvy, &y, &u, &v);
+            yuvToRgbAvx2(y, u, v, m, &r1, &g1, &b1);
+
+            // packus works per 128 bit lane, restore pixel order afterwards
+            const __m256i r = _mm256_permute4x64_epi64(_mm256_packus_epi16(r0, r1), 0xd8);
+            const __m256i g = _mm256_permute4x64_epi64(_mm256_packus_epi16(g0, g1), 0xd8);
+            const __m256i b = _mm256_permute4x64_epi64(_mm256_packus_epi16(b0, b1), 0xd8);
+            const __m256i c0 = ri == 0 ? r : b;
+            const __m256i c2 = ri == 0 ? b : r;
+
+            storeInterleaved3(d, _mm256_castsi256_si128(c0), _mm256_castsi256_si128(g),
+                              _mm256_castsi256_si128(c2));
+            storeInterleaved3(d + 48, _mm256_extracti128_si256(c0, 1), _mm256_extracti128_si256(g, 1),
+                              _mm256_extracti128_si256(c2, 1));
+            s += 64;
+            d += 96;
+        }
+        yuv422RowScalar(s, d, tail, matrix, uyvy ? 1 : 0, ri, bi);
+    }
+}
+
+DS_TARGET_AVX2 void yuv420ToRgb24Avx2(const quint8 *y, int yStride, const quint8 *u, const quint8 *v,
+                                      int uvStride, bool interleaved, quint8 *dst, int dstStride,
+                                      int width, int height, const DSColorMatrix &matrix, int ri, int bi)
+{
+    const Avx2Matrix m(matrix);
+    // doubles every U or V byte of 8 NV12 pairs
+    const __m128i pickU = _mm_setr_epi8(0, 0, 2, 2, 4, 4, 6, 6, 8, 8, 10, 10, 12, 12, 14, 14);
+    const __m128i pickV = _mm_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7, 9, 9, 11, 11, 13, 13, 15, 15);
+    const int chromaStep = interleaved ? 2 : 1;
+    const int blocks = width / 32;
+
+    for (int row = 0; row < height; ++row) {
+        const quint8 *ys = y + row * yStride;
+        const quint8 *us = u + (row >> 1) * uvStride;
+        const quint8 *vs = v + (row >> 1) * uvStride;
+        quint8 *d = dst + row * dstStride;
+
+        for (int i = 0; i < blocks; ++i) {
+            // 16 chroma samples per plane, each repeated for its two pixels
+            __m128i u0, u1, v0, v1;
+            if (interleaved) {
+                const __m128i uv0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(us));
+                const __m128i uv1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(us + 16));
+                u0 = _mm_shuffle_epi8(uv0, pickU);
+                u1 = _mm_shuffle_epi8(uv1, pickU);
+                v0 = _mm_shuffle_epi8(uv0, pickV);
+                v1 = _mm_shuffle_epi8(uv1, pickV);
+            } else {
+                const __m128i uu = _mm_loadu_si128(reinterpret_cast<const __m128i *>(us));
+                const __m128i vv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(vs));
+                u0 = _mm_unpacklo_epi8(uu, uu);
+                u1 = _mm_unpackhi_epi8(uu, uu);
+                v0 = _mm_unpacklo_epi8(vv, vv);
+                v1 = _mm_unpackhi_epi8(vv, vv);
+            }
+
+            __m256i r0, g0, b0, r1, g1, b1;
+            yuvToRgbAvx2(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ys))),
+                         _mm256_cvtepu8_epi16(u0), _mm256_cvtepu8_epi16(v0), m, &r0, &g0, &b0);
+            yuvToRgbAvx2(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ys + 16))),
+                         _mm256_cvtepu8_epi16(u1), _mm256_cvtepu8_epi16(v1), m, &r1, &g1, &b1);
+
+            const __m256i r = _mm256_permute4x64_epi64(_mm256_packus_epi16(r0, r1), 0xd8);
+            const __m256i g = _mm256_permute4x64_epi64(_mm256_packus_epi16(g0, g1), 0xd8);
+            const __m256i b = _mm256_permute4x64_epi64(_mm256_packus_epi16(b0, b1), 0xd8);
+            const __m256i c0 = ri == 0 ? r : b;
+            const __m256i c2 = ri == 0 ? b : r;
+
+            storeInterleaved3(d, _mm256_castsi256_si128(c0), _mm256_castsi256_si128(g),
+                              _mm256_castsi256_si128(c2));
+            storeInterleaved3(d + 48, _mm256_extracti128_si256(c0, 1), _mm256_extracti128_si256(g, 1),
+                              _mm256_extracti128_si256(c2, 1));
+            ys += 32;
+            us += 16 * chromaStep;
+            vs += 16 * chromaStep;
+            d += 96;
+        }
+        yuv420RowScalar(ys, us, vs, chromaStep, d, width - blocks * 32, matrix, ri, bi);
+    }
+}
+
+DS_TARGET_AVX2 void bgr24ToRgb24Avx2(const quint8 *src, int srcStride, quint8 *dst, int dstStride,
+                                     int width, int height)
+{
+    // reverses the byte order of each of the first four triplets
+    const __m128i swap = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 12, 13, 14, 15);
+
+    // 16 bytes are loaded and stored per 4 pixels, stop early enough that
+    // neither reaches past the end of the row
+    const int blocks = width >= 6 ? (width - 2) / 4 : 0;
+    const int tail = width - blocks * 4;
+
+    for (int row = 0; row < height; ++row) {
+        const quint8 *s = src + row * srcStride;
+        quint8 *d = dst + row * dstStride;
+
+        for (int i = 0; i < blocks; ++i) {
+            const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(d), _mm_shuffle_epi8(px, swap));
+            s += 12;
+            d += 12;
+        }
+        bgr24RowScalar(s, d, tail);
+    }
+}
+
+DS_TARGET_AVX2 void bgr32ToRgb24Avx2(const quint8 *src, int srcStride, quint8 *dst, int dstStride,
+                                     int width, int height)
+{
+    // drops the fourth byte of each of four pixels and swaps the other three
+    const __m128i pick = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    // 12 bytes are produced per 4 pixels but 16 stored, stop early enough
+    // that the last store stays within the row
+    const int blocks = width >= 2 ? (width * 3 - 4) / 12 : 0;
+    const int tail = width - blocks * 4;
+
+    for (int row = 0; row < height; ++row) {
+        const quint8 *s = src + row * srcStride;
+        quint8 *d = dst + row * dstStride;
+
+        for (int i = 0; i < blocks; ++i) {
+            const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(d), _mm_shuffle_epi8(px, pick));
+            s += 16;
+            d += 12;
+        }
+        bgr32RowScalar(s, d, tail);
+    }
+}
+
+// Splits 16 X1R5G5B5 pixels into 16 bit R, G and B widened to 8 bits each.
+DS_TARGET_AVX2 inline void unpackRgb555Avx2(__m256i px, __m256i *r, __m256i *g, __m256i *b)
+{
+    const __m256i mask = _mm256_set1_epi16(0x1f);
+    const __m256i r5 = _mm256_and_si256(_mm256_srli_epi16(px, 10), mask);
+    const __m256i g5 = _mm256_and_si256(_mm256_srli_epi16(px, 5), mask);
+    const __m256i b5 = _mm256_and_si256(px, mask);
+
+    *r = _mm256_or_si256(_mm256_slli_epi16(r5, 3), _mm256_srli_epi16(r5, 2));
+    *g = _mm256_or_si256(_mm256_slli_epi16(g5, 3), _mm256_srli_epi16(g5, 2));
+    *b = _mm256_or_si256(_mm256_slli_epi16(b5, 3), _mm256_srli_epi16(b5, 2));
+}
+
+DS_TARGET_AVX2 void rgb555ToRgb24Avx2(const quint8 *src, int srcStride, quint8 *dst, int dstStride,
+                                      int width, int height)
+{
+    const int blocks = width / 32;
+    const int tail = width - blocks * 32;
+
+    for (int row = 0; row < height; ++row) {
+        const quint8 *s = src + row * srcStride;
+        quint8 *d = dst + row * dstStride;
+
+        for (int i = 0; i < blocks; ++i) {
+            __m256i r0, g0, b0, r1, g1, b1;
+            unpackRgb555Avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(s)), &r0, &g0, &b0);
+            unpackRgb555Avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 32)), &r1, &g1, &b1);
+
+            const __m256i r = _mm256_permute4x64_epi64(_mm256_packus_epi16(r0, r1), 0xd8);
+            const __m256i g = _mm256_permute4x64_epi64(_mm256_packus_epi16(g0, g1), 0xd8);
+            const __m256i b = _mm256_permute4x64_epi64(_mm256_packus_epi16(b0, b1), 0xd8);
+
+            storeInterleaved3(d, _mm256_castsi256_si128(r), _mm256_castsi256_si128(g),
+                              _mm256_castsi256_si128(b));
+            storeInterleaved3(d + 48, _mm256_extracti128_si256(r, 1), _mm256_extracti128_si256(g, 1),
+                              _mm256_extracti128_si256(b, 1));
+            s += 64;
+            d += 96;
+        }
+        rgb555RowScalar(s, d, tail);
+    }
+}
+
+DS_TARGET_AVX2 void yuv422ToLumaAvx2(const quint8 *src, int srcStride, quint8 *dst, int dstStride,
+                                     int width, int height, bool uyvy)
+{
+    const __m256i lowByte = _mm256_set1_epi16(0x00ff);
+    const int blocks = width / 32;
+    const int tail = width - blocks * 32;
+
+    for (int row = 0; row < height; ++row) {
+        const quint8 *s = src + row * srcStride;
+        quint8 *d = dst + row * dstStride;
+
+        for (int i = 0; i < blocks; ++i) {
+            __m256i p0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+            __m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 32));
+            if (uyvy) {
+                p0 = _mm256_srli_epi16(p0, 8);
+                p1 = _mm256_srli_epi16(p1, 8);
+            } else {
+                p0 = _mm256_and_si256(p0, lowByte);
+                p1 = _mm256_and_si256(p1, lowByte);
+            }
+            const __m256i y = _mm256_permute4x64_epi64(_mm256_packus_epi16(p0, p1), 0xd8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(d), y);
+            s += 64;
+            d += 32;
+        }
+        yuv422LumaRowScalar(s, d, tail, uyvy ? 1 : 0);
+    }
+}
+
+// Gathers the first pixel of every block from averageBlocks() output, 16
+// bytes in and as many whole pixels as they hold out per shuffle. Stops where
+// a 16 byte store would pass the last pixel; returns the pixels done.
+DS_TARGET_AVX2 int compactBlocksAvx2(const quint8 *averages, quint8 *out, int pixels,
+                                     int channels, int factor)
+{
+    const int block = channels * factor;
+    const int perShuffle = (16 - channels) / block + 1;
+
+    union { __m128i v; qint8 b[16]; } pick;
+    for (int j = 0; j < 16; ++j)
+        pick.b[j] = j < perShuffle * channels ? qint8((j / channels) * block + j % channels) : -1;
+
+    int x = 0;
+    for (; x + perShuffle <= pixels && (x * channels + 16) <= pixels * channels; x += perShuffle) {
+        const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(averages + x * block));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x * channels), _mm_shuffle_epi8(px, pick.v));
+    }
+    return x;
+}
+
+bool cpuHasAvx2()
+{
+#ifdef Q_CC_MSVC
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    // OSXSAVE and AVX, then check the OS saves the YMM state
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+        return false;
+    if ((_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // DS_HAVE_AVX2
+
+enum InstructionSet {
+    ScalarSet,
+    Sse2Set,
+    Avx2Set
+};
+
+InstructionSet detectInstructionSet()
+{
+#if defined(DS_HAVE_AVX2)
+    if (cpuHasAvx2())
+        return Avx2Set;
+#endif
+#if defined(DS_HAVE_SSE2)
+    return Sse2Set;
+#else
+    return ScalarSet;
+#endif
+}
+
+InstructionSet detectedInstructionSet()
+{
+    static const InstructionSet set = detectInstructionSet();
+    return set;
+}
+
+// Set by DSFrameConverter::setInstructionSet(), -1 for the detected one.
+int forcedInstructionSet = -1;
+
+InstructionSet instructionSetInUse()
+{
+    if (forcedInstructionSet >= 0)
+        return InstructionSet(forcedInstructionSet);
+    return detectedInstructionSet();
+}
+
+void yuv422ToRgb24Scalar(const quint8 *src, int srcStride, quint8 *dst, int dstStride,
+                         int width, int height, const DSColorMatrix &matrix, bool uyvy, bool bgr)
+{
+    const int ri = bgr ? 2 : 0;
+    const int bi = bgr ? 0 : 2;
+    for (int row = 0; row < height; ++row)
+        yuv422RowScalar(src + row * srcStride, dst + row * dstStride, width / 2, matrix,
+                        uyvy ? 1 : 0, ri, bi);
+}
+
+void yuv420ToRgb24Scalar(const quint8 *y, int yStride, const quint8 *u, const quint8 *v,
+                         int uvStride, bool interleaved, quint8 *dst, int dstStride,
+                         int width, int height, const DSColorMatrix &matrix, bool bgr)
+{
+    const int ri = bgr ? 2 : 0;
+    const int bi = bgr ? 0 : 2;
+    for (int row = 0; row < height; ++row)
+        yuv420RowScalar(y + row * yStride, u + (row >> 1) * uvStride, v + (row >> 1) * uvStride,
+                        interleaved ? 2 : 1, dst + row * dstStride, width, matrix, ri, bi);
+}
+
+void yuv420ToRgb24(const quint8 *y, int yStride, const quint8 *u, const quint8 *v,
+                   int uvStride, bool interleaved, quint8 *dst, int dstStride,
+                   int width, int height, const DSColorMatrix &matrix, bool bgr)
+{
+    const int ri = bgr ? 2 : 0;
+    const int bi = bgr ? 0 : 2;
+
+    switch (instructionSetInUse()) {
+#ifdef DS_HAVE_AVX2
+    case Avx2Set:
+        yuv420ToRgb24Avx2(y, yStride, u, v, uvStride, interleaved, dst, dstStride,
+                          width, height, matrix, ri, bi);
+        return;
+#endif
+#ifdef DS_HAVE_SSE2
+    case Sse2Set:
+        yuv420ToRgb24Sse2(y, yStride, u, v, uvStride, interleaved, dst, dstStride,
+                          width, height, matrix, ri, bi);
+        return;
+#endif
+    default:
+        yuv420ToRgb24Scalar(y, yStride, u, v, uvStride, interleaved, dst, dstStride,
+                            width, height, matrix, bgr);
+        return;
+    }
+}
+
+void yuv422ToRgb24(const quint8 *src, int srcStride, quint8 *dst, int dstStride,
+                   int width, int height, const DSColorMatrix &matrix, bool uyvy, bool bgr)
+{
+    const int ri = bgr ? 2 : 0;
+    const int bi = bgr ? 0 : 2;
+
+    switch (instructionSetInUse()) {
+#ifdef DS_HAVE_AVX2
+    case Avx2Set:
+        yuv422ToRgb24Avx2(src, srcStride, dst, dstStride, width, height, matrix, uyvy, ri, bi);
+        return;
+#endif
+#ifdef DS_HAVE_SSE2
+    case Sse2Set:
+        yuv422ToRgb24Sse2(src, srcStride, dst, dstStride, width, height, matrix, uyvy, ri, bi);
+        return;
+#endif
+    default:
+        yuv422ToRgb24Scalar(src, srcStride, dst, dstStride, width, height, matrix, uyvy, bgr);
+        return;
+    }
+}
+
+void yuv422ToLuma(const quint8 *src, int srcStride, quint8 *dst, int dstStride,
+                  int width, int height, bool uyvy)
+{
+    switch (instructionSetInUse()) {
+#ifdef DS_HAVE_AVX2
+    case Avx2Set:
+        yuv422ToLumaAvx2(src, srcStride, dst, dstStride, width, height, uyvy);
+        return;
+#endif
+#ifdef DS_HAVE_SSE2
+    case Sse2Set:
+        yuv422ToLumaSse2(src, srcStride, dst, dstStride, width, height, uyvy);
+        return;
+#endif
+    default:
+        for (int row = 0; row < height; ++row)
+            yuv422LumaRowScalar(src + row * srcStride, dst + row * dstStride, width, uyvy ? 1 : 0);
+        return;
+    }
+}
+
+// Adds factor rows of bytes into 16 bit sums.
+inline void sumRows(const quint8 *src, int srcStride, quint16 *sums, int bytes, int factor)
+{
+    int i = 0;
+#ifdef DS_HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i lo = zero;
+        __m128i hi = zero;
+        for (int r = 0; r < factor; ++r) {
+            const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + r * srcStride + i));
+            lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(px, zero));
+            hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(px, zero));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + i), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + i + 8), hi);
+    }
+#endif
+    for (; i < bytes; ++i) {
+        int sum = 0;
+        for (int r = 0; r < factor; ++r)
+            sum += src[r * srcStride + i];
+        sums[i] = quint16(sum);
+    }
+}
+
+// Adds each sum to the Factor - 1 sums that follow it a pixel apart and
+// rounds the totals to bytes. The bytes at the start of every block, one per
+// channel, are the block averages.
+template <int Channels, int Factor>
+inline void averageBlocks(const quint16 *sums, quint8 *averages, int bytes)
+{
+    const int shift = Factor == 4 ? 4 : 2;
+    const int last = bytes - (Factor - 1) * Channels;
+
+    int i = 0;
+#ifdef DS_HAVE_SSE2
+    const __m128i rounding = _mm_set1_epi16(1 << (shift - 1));
+    for (; i + 16 <= last; i += 16) {
+        __m128i lo = rounding;
+        __m128i hi = rounding;
+        for (int k = 0; k < Factor; ++k) {
+            const quint16 *s = sums + i + k * Channels;
+            lo = _mm_add_epi16(lo, _mm_loadu_si128(reinterpret_cast<const __m128i *>(s)));
+            hi = _mm_add_epi16(hi, _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 8)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(averages + i),
+                         _mm_packus_epi16(_mm_srli_epi16(lo, shift), _mm_srli_epi16(hi, shift)));
+    }
+#endif
+    for (; i < last; ++i) {
+        int total = 1 << (shift - 1);
+        for (int k = 0; k < Factor; ++k)
+            total += sums[i + k * Channels];
+        averages[i] = quint8(total >> shift);
+    }
+}
+
+template <int Channels, int Factor>
+void downscaleBoxT(const quint8 *src, int srcStride, quint8 *dst, int dstStride,
+                   int width, int height)
+{
+    // Columns are summed a chunk at a time so the sums stay in L1. Each sum
+    // holds at most 16 bytes and cannot overflow.
+    const int chunkPixels = 256;
+    quint16 sums[chunkPixels * Factor * Channels];
+    quint8 averages[chunkPixels * Factor * Channels + 16];
+
+    const int outWidth = width / Factor;
+    const int outHeight = height / Factor;
+
+    for (int row = 0; row < outHeight; ++row) {
+        const quint8 *s = src + qptrdiff(row) * Factor * srcStride;
+        quint8 *d = dst + qptrdiff(row) * dstStride;
+
+        for (int x0 = 0; x0 < outWidth; x0 += chunkPixels) {
+            const int pixels = qMin(chunkPixels, outWidth - x0);
+            const int bytes = pixels * Factor * Channels;
+            sumRows(s + x0 * Factor * Channels, srcStride, sums, bytes, Factor);
+            averageBlocks<Channels, Factor>(sums, averages, bytes);
+
+            quint8 *out = d + x0 * Channels;
+            int x = 0;
+#ifdef DS_HAVE_AVX2
+            if (instructionSetInUse() == Avx2Set)
+                x = compactBlocksAvx2(averages, out, pixels, Channels, Factor);
+#endif
+            for (; x < pixels; ++x) {
+                for (int c = 0; c < Channels; ++c)
+                    out[x * Channels + c] = averages[x * Factor * Channels + c];
+            }
+        }
+    }
+}
+
+} // end namespace
+
+const DSColorMatrix &DSColorMatrix::matrix(Standard standard, Range range)
+{
+    return colorMatrices[standard == BT709 ? 1 : 0][range == FullRange ? 1 : 0];
+}
+
+void DSFrameConverter::yuy2ToRgb24Scalar(const quint8 *src, int srcStride,
+                                         quint8 *dst, int dstStride,
+                                         int width, int height,
+                                         const DSColorMatrix &matrix, bool bgr)
+{
+    yuv422ToRgb24Scalar(src, srcStride, dst, dstStride, width, height, matrix, false, bgr);
+}
+
+void DSFrameConverter::yuy2ToRgb24(const quint8 *src, int srcStride,
+                                   quint8 *dst, int dstStride,
+                                   int width, int height,
+                                   const DSColorMatrix &matrix, bool bgr)
+{
+    yuv422ToRgb24(src, srcStride, dst, dstStride, width, height, matrix, false, bgr);
+}
+
+void DSFrameConverter::uyvyToRgb24Scalar(const quint8 *src, int srcStride,
+                                         quint8 *dst, int dstStride,
+                                         int width, int height,
+                                         const DSColorMatrix &matrix, bool bgr)
+{
+    yuv422ToRgb24Scalar(src, srcStride, dst, dstStride, width, height, matrix, true, bgr);
+}
+
+void DSFrameConverter::uyvyToRgb24(const quint8 *src, int srcStride,
+                                   quint8 *dst, int dstStride,
+                                   int width, int height,
+                                   const DSColorMatrix &matrix, bool bgr)
+{
+    yuv422ToRgb24(src, srcStride, dst, dstStride, width, height, matrix, true, bgr);
+}
+
+void DSFrameConverter::i420ToRgb24(const quint8 *y, int yStride,
+                                   const quint8 *u, const quint8 *v, int uvStride,
+                                   quint8 *dst, int dstStride,
+                                   int width, int height,
+                                   const DSColorMatrix &matrix, bool bgr)
+{
+    yuv420ToRgb24(y, yStride, u, v, uvStride, false, dst, dstStride, width, height, matrix, bgr);
+}
+
+void DSFrameConverter::i420ToRgb24Scalar(const quint8 *y, int yStride,
+                                         const quint8 *u, const quint8 *v, int uvStride,
+                                         quint8 *dst, int dstStride,
+                                         int width, int height,
+                                         const DSColorMatrix &matrix, bool bgr)
+{
+    yuv420ToRgb24Scalar(y, yStride, u, v, uvStride, false, dst, dstStride, width, height, matrix, bgr);
+}
+
+void DSFrameConverter::nv12ToRgb24(const quint8 *y, int yStride,
+                                   const quint8 *uv, int uvStride,
+                                   quint8 *dst, int dstStride,
+                                   int width, int height,
+                                   const DSColorMatrix &matrix, bool bgr)
+{
+    yuv420ToRgb24(y, yStride, uv, uv + 1, uvStride, true, dst, dstStride, width, height, matrix, bgr);
+}
+
+void DSFrameConverter::nv12ToRgb24Scalar(const quint8 *y, int yStride,
+                                         const quint8 *uv, int uvStride,
+                                         quint8 *dst, int dstStride,
+                                         int width, int height,
+                                         const DSColorMatrix &matrix, bool bgr)
+{
+    yuv420ToRgb24Scalar(y, yStride, uv, uv + 1, uvStride, true, dst, dstStride, width, height, matrix, bgr);
+}
+
+void DSFrameConverter::bgr24ToRgb24(const quint8 *src, int srcStride,
+                                    quint8 *dst, int dstStride,
+                                    int width, int height)
+{
+#ifdef DS_HAVE_AVX2
+    if (instructionSetInUse() == Avx2Set) {
+        bgr24ToRgb24Avx2(src, srcStride, dst, dstStride, width, height);
+        return;
+    }
+#endif
+    for (int row = 0; row < height; ++row)
+        bgr24RowScalar(src + row * srcStride, dst + row * dstStride, width);
+}
+
+void DSFrameConverter::bgr32ToRgb24(const quint8 *src, int srcStride,
+                                    quint8 *dst, int dstStride,
+                                    int width, int height)
+{
+#ifdef DS_HAVE_AVX2
+    if (instructionSetInUse() == Avx2Set) {
+        bgr32ToRgb24Avx2(src, srcStride, dst, dstStride, width, height);
+        return;
+    }
+#endif
+    for (int row = 0; row < height; ++row)
+        bgr32RowScalar(src + row * srcStride, dst + row * dstStride, width);
+}
+
+void DSFrameConverter::rgb555ToRgb24(const quint8 *src, int srcStride,
+                                     quint8 *dst, int dstStride,
+                                     int width, int height)
+{
+    switch (instructionSetInUse()) {
+#ifdef DS_HAVE_AVX2
+    case Avx2Set:
+        rgb555ToRgb24Avx2(src, srcStride, dst, dstStride, width, height);
+        return;
+#endif
+#ifdef DS_HAVE_SSE2
+    case Sse2Set:
+        rgb555ToRgb24Sse2(src, srcStride, dst, dstStride, width, height);
+        return;
+#endif
+    default:
+        for (int row = 0; row < height; ++row)
+            rgb555RowScalar(src + row * srcStride, dst + row * dstStride, width);
+        return;
+    }
+}
+
+void DSFrameConverter::yuy2ToLuma(const quint8 *src, int srcStride,
+                                  quint8 *dst, int dstStride,
+                                  int width, int height)
+{
+    yuv422ToLuma(src, srcStride, dst, dstStride, width, height, false);
+}
+
+void DSFrameConverter::uyvyToLuma(const quint8 *src, int srcStride,
+                                  quint8 *dst, int dstStride,
+                                  int width, int height)
+{
+    yuv422ToLuma(src, srcStride, dst, dstStride, width, height, true);
+}
+
+void DSFrameConverter::copyPlane(const quint8 *src, int srcStride,
+                                 quint8 *dst, int dstStride,
+                                 int width, int height)
+{
+    for (int row = 0; row < height; ++row)
+        memcpy(dst + row * dstStride, src + row * srcStride, width);
+}
+
+void DSFrameConverter::downscaleBox(const quint8 *src, int srcStride,
+                                    quint8 *dst, int dstStride,
+                                    int width, int height, int channels, int factor)
+{
+    Q_ASSERT((channels == 1 || channels == 3) && (factor == 2 || factor == 4));
+
+    if (channels == 1) {
+        if (factor == 2)
+            downscaleBoxT<1, 2>(src, srcStride, dst, dstStride, width, height);
+        else
+            downscaleBoxT<1, 4>(src, srcStride, dst, dstStride, width, height);
+    } else {
+        if (factor == 2)
+            downscaleBoxT<3, 2>(src, srcStride, dst, dstStride, width, height);
+        else
+            downscaleBoxT<3, 4>(src, srcStride, dst, dstStride, width, height);
+    }
+}
+
+const char *DSFrameConverter::instructionSet()
+{
+    switch (instructionSetInUse()) {
+    case Avx2Set:
+        return "AVX2";
+    case Sse2Set:
+        return "SSE2";
+    default:
+        return "C";
+    }
+}
+
+bool DSFrameConverter::setInstructionSet(const char *name)
+{
+    if (!name || !*name) {
+        forcedInstructionSet = -1;
+        return true;
+    }
+
+    InstructionSet set;
+    if (!strcmp(name, "AVX2"))
+        set = Avx2Set;
+    else if (!strcmp(name, "SSE2"))
+        set = Sse2Set;
+    else if (!strcmp(name, "C"))
+        set = ScalarSet;
+    else
+        return false;
+
+    // every set below the detected one is built in as well
+    if (set > detectedInstructionSet())
+        return false;
+    forcedInstructionSet = set;
+    return true;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,185 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSFRAMECONVERTER_H
+#define DSFRAMECONVERTER_H
+
+#include <QtCore/qglobal.h>
+
+QT_BEGIN_NAMESPACE
+
+// Integer YUV to RGB matrix. The coefficients are stored in 3.13 fixed point
+// and come from fixed tables, so every build produces the same output.
+struct DSColorMatrix
+{
+    enum Standard {
+        BT601,
+        BT709
+    };
+
+    enum Range {
+        LimitedRange, // Y in 16..235, chroma in 16..240
+        FullRange     // Y and chroma in 0..255
+    };
+
+    qint16 y;
+    qint16 yOffset;
+    qint16 rv;
+    qint16 gu;
+    qint16 gv;
+    qint16 bu;
+
+    static const DSColorMatrix &matrix(Standard standard, Range range);
+};
+
+// Pixel conversion kernels used by DSFrameProcessor.
+//
+// The kernels only depend on QtCore so they can be built and verified on any
+// platform. Strides are given in bytes and may be negative, which lets the
+// caller flip the image vertically while converting.
+namespace DSFrameConverter
+{
+    // Converts packed YUY2 (Y0 U Y1 V) rows into 24 bit RGB, or BGR when bgr
+    // is set. width has to be even.
+    void yuy2ToRgb24(const quint8 *src, int srcStride,
+                     quint8 *dst, int dstStride,
+                     int width, int height,
+                     const DSColorMatrix &matrix, bool bgr = false);
+
+    // Plain C++ version of yuy2ToRgb24(), the reference for the SIMD paths.
+    void yuy2ToRgb24Scalar(const quint8 *src, int srcStride,
+                           quint8 *dst, int dstStride,
+                           int width, int height,
+                           const DSColorMatrix &matrix, bool bgr = false);
+
+    // Same as yuy2ToRgb24() for packed UYVY (U Y0 V Y1) rows.
+    void uyvyToRgb24(const quint8 *src, int srcStride,
+                     quint8 *dst, int dstStride,
+                     int width, int height,
+                     const DSColorMatrix &matrix, bool bgr = false);
+
+    void uyvyToRgb24Scalar(const quint8 *src, int srcStride,
+                           quint8 *dst, int dstStride,
+                           int width, int height,
+                           const DSColorMatrix &matrix, bool bgr = false);
+
+    // Converts planar I420 into 24 bit RGB. u and v are the chroma planes,
+    // subsampled by two in both directions; swap them for YV12.
+    void i420ToRgb24(const quint8 *y, int yStride,
+                     const quint8 *u, const quint8 *v, int uvStride,
+                     quint8 *dst, int dstStride,
+                     int width, int height,
+                     const DSColorMatrix &matrix, bool bgr = false);
+
+    void i420ToRgb24Scalar(const quint8 *y, int yStride,
+                           const quint8 *u, const quint8 *v, int uvStride,
+                           quint8 *dst, int dstStride,
+                           int width, int height,
+                           const DSColorMatrix &matrix, bool bgr = false);
+
+    // Same for NV12, whose chroma plane holds interleaved U V pairs.
+    void nv12ToRgb24(const quint8 *y, int yStride,
+                     const quint8 *uv, int uvStride,
+                     quint8 *dst, int dstStride,
+                     int width, int height,
+                     const DSColorMatrix &matrix, bool bgr = false);
+
+    void nv12ToRgb24Scalar(const quint8 *y, int yStride,
+                           const quint8 *uv, int uvStride,
+                           quint8 *dst, int dstStride,
+                           int width, int height,
+                           const DSColorMatrix &matrix, bool bgr = false);
+
+    // Swaps the first and third byte of every 24 bit pixel, BGR to RGB or back.
+    // With a negative srcStride this turns a bottom-up DIB into a top-down
+    // image in a single pass.
+    void bgr24ToRgb24(const quint8 *src, int srcStride,
+                      quint8 *dst, int dstStride,
+                      int width, int height);
+
+    // Drops the unused fourth byte of 32 bit BGRX pixels and swaps to RGB.
+    void bgr32ToRgb24(const quint8 *src, int srcStride,
+                      quint8 *dst, int dstStride,
+                      int width, int height);
+
+    // Widens 16 bit X1R5G5B5 pixels to 24 bit RGB, 31 becomes 255.
+    void rgb555ToRgb24(const quint8 *src, int srcStride,
+                       quint8 *dst, int dstStride,
+                       int width, int height);
+
+    // Copies the Y bytes out of packed YUY2 or UYVY rows, one byte per pixel,
+    // leaving chroma behind.
+    void yuy2ToLuma(const quint8 *src, int srcStride,
+                    quint8 *dst, int dstStride,
+                    int width, int height);
+
+    void uyvyToLuma(const quint8 *src, int srcStride,
+                    quint8 *dst, int dstStride,
+                    int width, int height);
+
+    // Copies width bytes of every row, e.g. the Y plane of I420 or NV12 out
+    // of a frame with padded rows.
+    void copyPlane(const quint8 *src, int srcStride,
+                   quint8 *dst, int dstStride,
+                   int width, int height);
+
+    // Shrinks an image of 1 or 3 interleaved 8 bit channels by factor, 2 or
+    // 4, in both directions, averaging each factor x factor block. The output
+    // is width / factor by height / factor; pixels left over on the right and
+    // bottom are dropped.
+    void downscaleBox(const quint8 *src, int srcStride,
+                      quint8 *dst, int dstStride,
+                      int width, int height, int channels, int factor);
+
+    // Name of the instruction set the dispatching kernels use on this machine:
+    // "AVX2", "SSE2" or "C".
+    const char *instructionSet();
+
+    // Makes the dispatching kernels use the named instruction set instead,
+    // so tests can check every path the machine can run. Returns false for
+    // one it cannot; 0 goes back to the detected one. Call while nothing is
+    // being converted.
+    bool setInstructionSet(const char *name);
+}
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,133 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSFRAMEFORMAT_H
+#define DSFRAMEFORMAT_H
+
+#include <QtCore/qglobal.h>
+
+#include "dsframeconverter.h"
+
+QT_BEGIN_NAMESPACE
+
+// Layout of the raw frames handed to DSFrameProcessor, independent of where
+// they come from. Pixel formats name the bytes in memory order.
+struct DSFrameFormat
+{
+    enum PixelFormat {
+        Invalid,
+        BGR24,  // MEDIASUBTYPE_RGB24
+        BGR32,  // MEDIASUBTYPE_RGB32
+        RGB555, // MEDIASUBTYPE_RGB555
+        YUY2,
+        UYVY,
+        I420,
+        NV12,
+        MJPG
+    };
+
+    DSFrameFormat()
+        : pixelFormat(Invalid)
+        , width(0)
+        , height(0)
+        , stride(0)
+        , bottomUp(false)
+        , sampleSize(0)
+        , colorStandard(DSColorMatrix::BT601)
+        , colorRange(DSColorMatrix::LimitedRange)
+    {
+    }
+
+    bool isValid() const { return pixelFormat != Invalid && width > 0 && height > 0; }
+
+    // Bytes of one frame without padding beyond stride, 0 for compressed formats.
+    int frameSize() const
+    {
+        switch (pixelFormat) {
+        case I420:
+        case NV12:
+            return stride * height * 3 / 2;
+        case MJPG:
+        case Invalid:
+            return 0;
+        default:
+            return stride * height;
+        }
+    }
+
+    // Bytes per pixel of the first plane, 0 for compressed formats.
+    int bytesPerPixel() const
+    {
+        switch (pixelFormat) {
+        case BGR24:
+            return 3;
+        case BGR32:
+            return 4;
+        case RGB555:
+        case YUY2:
+        case UYVY:
+            return 2;
+        case I420:
+        case NV12:
+            return 1;
+        default:
+            return 0;
+        }
+    }
+
+    const DSColorMatrix &colorMatrix() const
+    {
+        return DSColorMatrix::matrix(colorStandard, colorRange);
+    }
+
+    PixelFormat pixelFormat;
+    int width;
+    int height;
+    int stride;     // bytes per row of the first plane
+    bool bottomUp;  // first row in memory is the bottom one, as in RGB DIBs
+    int sampleSize; // largest frame in bytes, sizes the buffer pool
+    DSColorMatrix::Standard colorStandard;
+    DSColorMatrix::Range colorRange;
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,143 @@
+#include "dsframemat.h"
+
+#include <new>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+#if CV_MAJOR_VERSION < 3
+
+// OpenCV 2 keeps a bare int reference count next to the data. Pooled Mats put
+// it in the buffer attachment, Mats created through the virtual allocate()
+// (a receiver reallocating a shared Mat) behind their own heap block. The
+// kind just in front of the count tells deallocate() which one it got.
+enum RefKind {
+    HeapRef,
+    PooledRef
+};
+
+struct PooledMatRef
+{
+    int kind;
+    int refcount;
+    DSFrameBuffer *buffer;
+};
+
+Q_STATIC_ASSERT(sizeof(PooledMatRef) <= DSFrameBuffer::AttachmentSize);
+
+#else
+
+Q_STATIC_ASSERT(sizeof(cv::UMatData) <= DSFrameBuffer::AttachmentSize);
+
+#endif
+
+} // end namespace
+
+DSMatAllocator *DSMatAllocator::instance()
+{
+    // Never destroyed, Mats may well outlive static destruction.
+    static DSMatAllocator *allocator = new DSMatAllocator;
+    return allocator;
+}
+
+cv::Mat DSMatAllocator::allocate(DSFramePool *pool, int rows, int cols, int type)
+{
+    const size_t step = size_t(cols) * CV_ELEM_SIZE(type);
+    Q_ASSERT(rows * step <= size_t(pool->bufferSize()));
+
+    DSFrameHandle buffer = pool->acquire();
+    buffer->length = int(rows * step);
+    return wrap(buffer, 0, rows, cols, type, step);
+}
+
+cv::Mat DSMatAllocator::wrap(const DSFrameHandle &buffer, int offset,
+                             int rows, int cols, int type, size_t step)
+{
+    // The Mats together hold one reference to the buffer.
+    DSFrameHandle ref(buffer);
+    uchar *data = ref->data + offset;
+    cv::Mat mat(rows, cols, type, data, step);
+
+#if CV_MAJOR_VERSION < 3
+    PooledMatRef *matRef = new (ref->attachment) PooledMatRef;
+    matRef->kind = PooledRef;
+    matRef->refcount = 1;
+    matRef->buffer = ref.take();
+    mat.refcount = &matRef->refcount;
+#else
+    cv::UMatData *u = new (ref->attachment) cv::UMatData(instance());
+    u->data = u->origdata = data;
+    u->size = rows * step;
+    u->refcount = 1;
+    u->handle = ref.take();
+    mat.u = u;
+#endif
+    mat.allocator = instance();
+    return mat;
+}
+
+#if CV_MAJOR_VERSION < 3
+
+void DSMatAllocator::allocate(int dims, const int *sizes, int type, int *&refcount,
+                              uchar *&datastart, uchar *&data, size_t *step)
+{
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; --i) {
+        step[i] = total;
+        total *= sizes[i];
+    }
+    total = cv::alignSize(total, int(sizeof(int)));
+
+    data = datastart = static_cast<uchar *>(cv::fastMalloc(total + 2 * sizeof(int)));
+    int *counts = reinterpret_cast<int *>(data + total);
+    counts[0] = HeapRef;
+    refcount = counts + 1;
+    *refcount = 1;
+}
+
+void DSMatAllocator::deallocate(int *refcount, uchar *datastart, uchar *data)
+{
+    Q_UNUSED(data)
+
+    if (refcount[-1] != PooledRef) {
+        cv::fastFree(datastart);
+        return;
+    }
+
+    PooledMatRef *matRef = reinterpret_cast<PooledMatRef *>(refcount - 1);
+    DSFrameBuffer *buffer = matRef->buffer;
+    matRef->~PooledMatRef();
+    DSFrameHandle::adopt(buffer).reset();
+}
+
+#else
+
+// Anything not created by wrap() is plain heap memory owned by the standard
+// allocator, which then also frees it.
+cv::UMatData *DSMatAllocator::allocate(int dims, const int *sizes, int type, void *data,
+                                       size_t *step, AccessFlags flags,
+                                       cv::UMatUsageFlags usageFlags) const
+{
+    return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+}
+
+bool DSMatAllocator::allocate(cv::UMatData *data, AccessFlags accessFlags,
+                              cv::UMatUsageFlags usageFlags) const
+{
+    return cv::Mat::getStdAllocator()->allocate(data, accessFlags, usageFlags);
+}
+
+void DSMatAllocator::deallocate(cv::UMatData *data) const
+{
+    if (!data)
+        return;
+
+    DSFrameBuffer *buffer = static_cast<DSFrameBuffer *>(data->handle);
+    data->~UMatData();
+    DSFrameHandle::adopt(buffer).reset();
+}
+
+#endif
+
+QT_END_NAMESPACE
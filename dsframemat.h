@@ -0,0 +1,97 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSFRAMEMAT_H
+#define DSFRAMEMAT_H
+
+#include <QtCore/qglobal.h>
+
+#include <opencv2/core/core.hpp>
+
+#include "dsframepool.h"
+
+QT_BEGIN_NAMESPACE
+
+// cv::MatAllocator that lets cv::Mat share pooled frame buffers.
+//
+// A Mat made by wrap() or allocate() references its buffer through the
+// ordinary OpenCV reference count, so copies, queued signal arguments and
+// ROIs all share the pixels without copying. The buffer goes back to its pool
+// when the last Mat referring to it is released, from whichever thread that
+// happens on.
+class DSMatAllocator : public cv::MatAllocator
+{
+public:
+    static DSMatAllocator *instance();
+
+    // Returns a Mat backed by a fresh buffer from pool, which must be large
+    // enough for rows * cols pixels of type. Call from the pool's acquiring
+    // thread.
+    static cv::Mat allocate(DSFramePool *pool, int rows, int cols, int type);
+
+    // Returns a Mat viewing the pixels of buffer starting at offset. A buffer
+    // can be wrapped once; share the resulting Mat to get more references.
+    static cv::Mat wrap(const DSFrameHandle &buffer, int offset,
+                        int rows, int cols, int type, size_t step);
+
+#if CV_MAJOR_VERSION < 3
+    void allocate(int dims, const int *sizes, int type, int *&refcount,
+                  uchar *&datastart, uchar *&data, size_t *step);
+    void deallocate(int *refcount, uchar *datastart, uchar *data);
+#else
+#  if CV_MAJOR_VERSION < 4
+    typedef int AccessFlags;
+#  else
+    typedef cv::AccessFlag AccessFlags;
+#  endif
+    cv::UMatData *allocate(int dims, const int *sizes, int type, void *data,
+                           size_t *step, AccessFlags flags, cv::UMatUsageFlags usageFlags) const;
+    bool allocate(cv::UMatData *data, AccessFlags accessFlags, cv::UMatUsageFlags usageFlags) const;
+    void deallocate(cv::UMatData *data) const;
+#endif
+
+private:
+    DSMatAllocator() {}
+};
+
+QT_END_NAMESPACE
+
+#endif
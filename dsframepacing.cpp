@@ -0,0 +1,118 @@
+#include <QtCore/qalgorithms.h>
+#include <QtCore/qmath.h>
+
+#include "dsframepacing.h"
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+struct IntervalStatistics
+{
+    int count;
+    qint64 mean;
+    qint64 min;
+    qint64 max;
+    qint64 deviation;
+    int outliers;       // over 1.5 times the median
+};
+
+IntervalStatistics intervalStatistics(const qint64 *intervals, int count)
+{
+    IntervalStatistics statistics;
+    memset(&statistics, 0, sizeof(statistics));
+
+    qint64 sorted[DSFramePacing::Window];
+    double sum = 0;
+    for (int i = 0; i < count; ++i) {
+        if (intervals[i] < 0)
+            continue;
+        sorted[statistics.count++] = intervals[i];
+        sum += intervals[i];
+    }
+    if (!statistics.count)
+        return statistics;
+
+    qSort(sorted, sorted + statistics.count);
+    const double mean = sum / statistics.count;
+    double squares = 0;
+    for (int i = 0; i < statistics.count; ++i)
+        squares += (sorted[i] - mean) * (sorted[i] - mean);
+
+    const qint64 median = sorted[statistics.count / 2];
+    for (int i = statistics.count - 1; i >= 0 && 2 * sorted[i] > 3 * median; --i)
+        ++statistics.outliers;
+
+    statistics.mean = qint64(mean);
+    statistics.min = sorted[0];
+    statistics.max = sorted[statistics.count - 1];
+    statistics.deviation = qint64(qSqrt(squares / statistics.count));
+    return statistics;
+}
+
+} // end namespace
+
+DSFramePacing::DSFramePacing()
+{
+    reset();
+}
+
+void DSFramePacing::record(qint64 captureTime, qint64 time)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_frames++) {
+        m_intervals[m_next] = time - m_lastTime;
+        m_captureIntervals[m_next] = captureTime >= m_lastCaptureTime ? captureTime - m_lastCaptureTime : -1;
+        m_next = (m_next + 1) % Window;
+        m_count = qMin(m_count + 1, int(Window));
+    } else {
+        m_firstCaptureTime = captureTime;
+    }
+    if (captureTime < m_lastCaptureTime)
+        m_firstCaptureTime = captureTime;
+    m_lastTime = time;
+    m_lastCaptureTime = captureTime;
+}
+
+DSFramePacingStatistics DSFramePacing::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    DSFramePacingStatistics statistics;
+    memset(&statistics, 0, sizeof(statistics));
+    statistics.frames = m_frames;
+    statistics.firstCaptureTime = m_firstCaptureTime;
+    statistics.lastCaptureTime = m_lastCaptureTime;
+
+    const IntervalStatistics arrival = intervalStatistics(m_intervals, m_count);
+    statistics.intervals = arrival.count;
+    statistics.meanInterval = arrival.mean;
+    statistics.minInterval = arrival.min;
+    statistics.maxInterval = arrival.max;
+    statistics.jitter = arrival.deviation;
+    statistics.late = arrival.outliers;
+    if (arrival.mean > 0)
+        statistics.frameRate = 1e9 / arrival.mean;
+
+    const IntervalStatistics capture = intervalStatistics(m_captureIntervals, m_count);
+    statistics.captureJitter = capture.deviation;
+    statistics.skipped = capture.outliers;
+    if (capture.mean > 0)
+        statistics.captureFrameRate = 1e9 / capture.mean;
+
+    return statistics;
+}
+
+void DSFramePacing::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_next = 0;
+    m_count = 0;
+    m_frames = 0;
+    m_lastTime = 0;
+    m_firstCaptureTime = 0;
+    m_lastCaptureTime = 0;
+}
+
+QT_END_NAMESPACE
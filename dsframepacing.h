@@ -0,0 +1,105 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSFRAMEPACING_H
+#define DSFRAMEPACING_H
+
+#include <QtCore/qglobal.h>
+#include <QtCore/qmutex.h>
+
+QT_BEGIN_NAMESPACE
+
+// How evenly frames come, over the last DSFramePacing::Window of them. Times
+// are in nanoseconds.
+struct DSFramePacingStatistics
+{
+    qint64 frames;              // recorded since the last reset
+    int intervals;              // the rest is over this many
+    double frameRate;           // as the frames came, 0 without intervals
+    qint64 meanInterval;
+    qint64 minInterval;
+    qint64 maxInterval;
+    qint64 jitter;              // standard deviation of the interval
+    int late;                   // intervals over 1.5 times the median
+    double captureFrameRate;    // by the frames' own time stamps
+    qint64 captureJitter;
+    int skipped;                // capture intervals over 1.5 times the median:
+                                // frames the camera dropped or never took
+    qint64 firstCaptureTime;    // time stamps of the first and latest frame
+    qint64 lastCaptureTime;     // since the last reset
+};
+
+// Rolling inter-frame interval and jitter statistics of one point in the
+// pipeline, both by the monotonic time frames pass it and by the capture
+// time stamps they carry. The first tell what a consumer sees under load,
+// the second whether the camera kept its rate. Capture times going backwards,
+// as a replay looping does, start the capture intervals over.
+//
+// record() takes a lock held for a few instructions; one thread records,
+// any may read.
+class DSFramePacing
+{
+public:
+    enum { Window = 128 };
+
+    DSFramePacing();
+
+    void record(qint64 captureTime, qint64 time);
+    DSFramePacingStatistics statistics() const;
+    void reset();
+
+private:
+    Q_DISABLE_COPY(DSFramePacing)
+
+    mutable QMutex m_mutex;
+    qint64 m_intervals[Window];
+    qint64 m_captureIntervals[Window];  // -1 where the capture time went back
+    int m_next;
+    int m_count;
+    qint64 m_frames;
+    qint64 m_lastTime;
+    qint64 m_firstCaptureTime;
+    qint64 m_lastCaptureTime;
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,164 @@
+#include "dsframepool.h"
+
+#include <new>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+// Buffers are cache line aligned, which the SIMD converters and aligned file
+// writes both benefit from. The header and attachment live in front of the
+// data so every buffer costs exactly one heap allocation.
+const int BufferAlignment = 64;
+const int HeaderSize = (sizeof(DSFrameBuffer) + DSFrameBuffer::AttachmentSize
+                        + BufferAlignment - 1) & ~(BufferAlignment - 1);
+
+} // end namespace
+
+DSFrameHandle::DSFrameHandle(const DSFrameHandle &other)
+    : d(other.d)
+{
+    if (d)
+        d->ref.ref();
+}
+
+DSFrameHandle::~DSFrameHandle()
+{
+    reset();
+}
+
+DSFrameHandle &DSFrameHandle::operator=(const DSFrameHandle &other)
+{
+    if (other.d)
+        other.d->ref.ref();
+    reset();
+    d = other.d;
+    return *this;
+}
+
+void DSFrameHandle::reset()
+{
+    if (d && !d->ref.deref())
+        d->pool->recycle(d);
+    d = 0;
+}
+
+DSFrameBuffer *DSFrameHandle::take()
+{
+    DSFrameBuffer *buffer = d;
+    d = 0;
+    return buffer;
+}
+
+DSFrameHandle DSFrameHandle::adopt(DSFrameBuffer *buffer)
+{
+    return DSFrameHandle(buffer);
+}
+
+DSFramePool::DSFramePool(int bufferSize, int preallocate)
+    : m_bufferSize(bufferSize)
+    , m_ref(1)
+    , m_allocations(0)
+    , m_acquisitions(0)
+    , m_free(0)
+    , m_returned(0)
+{
+    for (int i = 0; i < preallocate; ++i) {
+        DSFrameBuffer *buffer = allocate();
+        buffer->next = m_free;
+        m_free = buffer;
+    }
+}
+
+DSFramePool::~DSFramePool()
+{
+    freeList(m_free);
+    freeList(m_returned.load());
+}
+
+void DSFramePool::release()
+{
+    if (!m_ref.deref())
+        delete this;
+}
+
+DSFramePoolStatistics DSFramePool::statistics() const
+{
+    DSFramePoolStatistics stats;
+    stats.bufferSize = m_bufferSize;
+    stats.allocations = m_allocations.load();
+    stats.acquisitions = m_acquisitions.load();
+    stats.outstanding = m_ref.load() - 1;
+    return stats;
+}
+
+DSFrameHandle DSFramePool::acquire()
+{
+    // Take everything returned so far in one go. Only this thread pops, so
+    // swapping the whole list out cannot suffer from ABA.
+    if (!m_free)
+        m_free = m_returned.fetchAndStoreAcquire(0);
+
+    DSFrameBuffer *buffer = m_free;
+    if (buffer)
+        m_free = buffer->next;
+    else
+        buffer = allocate();
+
+    buffer->ref.store(1);
+    buffer->length = 0;
+    buffer->time = 0;
+    buffer->arrivalTime = 0;
+    buffer->ingestTime = 0;
+    buffer->enqueueTime = 0;
+    buffer->next = 0;
+
+    m_ref.ref();
+    m_acquisitions.fetchAndAddRelaxed(1);
+
+    return DSFrameHandle(buffer);
+}
+
+DSFrameBuffer *DSFramePool::allocate()
+{
+    void *memory = qMallocAligned(HeaderSize + m_bufferSize, BufferAlignment);
+    Q_CHECK_PTR(memory);
+
+    DSFrameBuffer *buffer = new (memory) DSFrameBuffer;
+    buffer->data = static_cast<quint8 *>(memory) + HeaderSize;
+    buffer->attachment = static_cast<quint8 *>(memory) + sizeof(DSFrameBuffer);
+    buffer->capacity = m_bufferSize;
+    buffer->length = 0;
+    buffer->time = 0;
+    buffer->arrivalTime = 0;
+    buffer->ingestTime = 0;
+    buffer->enqueueTime = 0;
+    buffer->pool = this;
+    buffer->next = 0;
+
+    m_allocations.fetchAndAddRelaxed(1);
+    return buffer;
+}
+
+void DSFramePool::recycle(DSFrameBuffer *buffer)
+{
+    DSFrameBuffer *head;
+    do {
+        head = m_returned.loadAcquire();
+        buffer->next = head;
+    } while (!m_returned.testAndSetRelease(head, buffer));
+
+    release();
+}
+
+void DSFramePool::freeList(DSFrameBuffer *list)
+{
+    while (list) {
+        DSFrameBuffer *next = list->next;
+        list->~DSFrameBuffer();
+        qFreeAligned(list);
+        list = next;
+    }
+}
+
+QT_END_NAMESPACE
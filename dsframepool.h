@@ -0,0 +1,163 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSFRAMEPOOL_H
+#define DSFRAMEPOOL_H
+
+#include <QtCore/qglobal.h>
+#include <QtCore/qatomic.h>
+
+QT_BEGIN_NAMESPACE
+
+class DSFramePool;
+
+struct DSFrameBuffer
+{
+    enum { AttachmentSize = 192 };
+
+    quint8 *data;
+    int capacity;
+    int length;
+    qint64 time;        // capture time stamp in nanoseconds, the source's clock
+
+    // monotonic nanoseconds, see DSLatencyTracer::now(); arrivalTime is when
+    // the frame reached the host and always set, the others only while
+    // tracing latency
+    qint64 arrivalTime;
+    qint64 ingestTime;
+    qint64 enqueueTime;
+
+    // AttachmentSize bytes of scratch space for bookkeeping that lives exactly
+    // as long as the buffer is handed out, e.g. the cv::Mat reference count.
+    void *attachment;
+
+    QAtomicInt ref;
+    DSFramePool *pool;
+    DSFrameBuffer *next;
+};
+
+// Owning reference to a pooled frame buffer. The buffer goes back to its pool
+// when the last handle referring to it is destroyed.
+class DSFrameHandle
+{
+public:
+    DSFrameHandle() : d(0) {}
+    DSFrameHandle(const DSFrameHandle &other);
+    ~DSFrameHandle();
+
+    DSFrameHandle &operator=(const DSFrameHandle &other);
+
+    bool isNull() const { return d == 0; }
+    DSFrameBuffer *buffer() const { return d; }
+    DSFrameBuffer *operator->() const { return d; }
+
+    void reset();
+
+    // Hands the reference over to the caller as a raw pointer, e.g. to pass it
+    // through a queue; adopt() turns it back into a handle.
+    DSFrameBuffer *take();
+    static DSFrameHandle adopt(DSFrameBuffer *buffer);
+
+private:
+    explicit DSFrameHandle(DSFrameBuffer *buffer) : d(buffer) {}
+
+    DSFrameBuffer *d;
+
+    friend class DSFramePool;
+};
+
+Q_DECLARE_TYPEINFO(DSFrameHandle, Q_MOVABLE_TYPE);
+
+struct DSFramePoolStatistics
+{
+    int bufferSize;
+    int allocations;  // buffers allocated from the heap
+    int acquisitions; // buffers handed out by acquire()
+    int outstanding;  // buffers currently held through handles
+};
+
+// Recycling allocator for fixed size frame buffers.
+//
+// Buffers are handed out by acquire(), which must always be called from the
+// same thread, and can be returned from any thread without locking. Once the
+// pool has grown to the number of buffers in flight, streaming does no heap
+// allocation at all.
+//
+// The pool is destroyed through release() rather than delete: it stays alive
+// until the last outstanding buffer has come back. A pool of bufferSize 0 hands
+// out bare buffers whose data the caller points at memory of its own; such a
+// pool is subclassed to keep that memory alive until it is destroyed.
+class DSFramePool
+{
+public:
+    explicit DSFramePool(int bufferSize, int preallocate = 0);
+
+    void release();
+
+    int bufferSize() const { return m_bufferSize; }
+    DSFramePoolStatistics statistics() const;
+
+    DSFrameHandle acquire();
+
+protected:
+    virtual ~DSFramePool();
+
+private:
+    Q_DISABLE_COPY(DSFramePool)
+
+    DSFrameBuffer *allocate();
+    void recycle(DSFrameBuffer *buffer);
+    static void freeList(DSFrameBuffer *list);
+
+    const int m_bufferSize;
+    QAtomicInt m_ref;
+    QAtomicInt m_allocations;
+    QAtomicInt m_acquisitions;
+
+    DSFrameBuffer *m_free;                   // owned by the acquiring thread
+    QAtomicPointer<DSFrameBuffer> m_returned; // pushed to from any thread
+
+    friend class DSFrameHandle;
+};
+
+QT_END_NAMESPACE
+
+#endif
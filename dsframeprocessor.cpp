@@ -0,0 +1,1093 @@
+#include <QDebug>
+#include <QtCore/qthread.h>
+#include <QtCore/qmetatype.h>
+#include <QtCore/qelapsedtimer.h>
+
+#include "dsframeprocessor.h"
+#include "dsframemat.h"
+#include "dsframerecorder.h"
+#include "dsframescheduler.h"
+
+QT_BEGIN_NAMESPACE
+
+// If frames come in quicker than we display them, we allow the queue to build
+// up to this number before the backpressure policy kicks in.
+const int LIMIT_FRAME = 5;
+
+namespace {
+
+// Mats handed out keep their buffer until the last receiver lets go, so the
+// pool of the previous size lives on until then.
+DSFramePool *sizedPool(DSFramePool *&pool, int bufferSize)
+{
+    if (!pool || pool->bufferSize() != bufferSize) {
+        if (pool)
+            pool->release();
+        pool = new DSFramePool(bufferSize);
+    }
+    return pool;
+}
+
+// Subscribers asking for the same format at the same scale share a frame.
+int outputKey(int output, int scale)
+{
+    return output * 8 + scale;
+}
+
+} // end namespace
+
+class DSFrameWorker : public QThread
+{
+public:
+    DSFrameWorker(DSFrameProcessor *processor)
+        : m_processor(processor)
+        , m_stop(0)
+    {
+    }
+
+    void stop()
+    {
+        m_stop.store(1);
+        m_processor->m_wakeMutex.lock();
+        m_processor->m_wakeCondition.wakeAll();
+        m_processor->m_wakeMutex.unlock();
+        wait();
+    }
+
+protected:
+    void run()
+    {
+        while (!m_stop.load()) {
+            DSFrameHandle frame = m_processor->popFrame();
+            if (!frame.isNull()) {
+                m_processor->processFrame(frame);
+                continue;
+            }
+
+            // Announce that we are about to sleep before looking at the queue
+            // one last time; pushFrame() does the opposite, so one of the two
+            // always notices the other.
+            QMutexLocker locker(&m_processor->m_wakeMutex);
+            m_processor->m_workerWaiting.fetchAndStoreOrdered(1);
+            if (m_processor->m_queue->isEmpty() && !m_stop.load())
+                m_processor->m_wakeCondition.wait(&m_processor->m_wakeMutex, 100);
+            m_processor->m_workerWaiting.fetchAndStoreOrdered(0);
+        }
+    }
+
+private:
+    DSFrameProcessor *m_processor;
+    QAtomicInt m_stop;
+};
+
+DSFrameProcessor::DSFrameProcessor(QObject *parent)
+    : QObject(parent)
+    , m_queue(new DSFrameQueue(LIMIT_FRAME))
+    , m_inputPool(0)
+    , m_outputPool(0)
+    , m_previewPool(0)
+    , m_outputFormat(RgbOutput)
+    , m_previewScale(0)
+    , m_jpegScale(1)
+    , m_nextSubscription(1)
+    , m_decodeErrors(0)
+    , m_shortFrames(0)
+    , m_recorder(0)
+    , m_worker(0)
+    , m_scheduler(0)
+    , m_workerWaiting(0)
+    , m_policy(DropNewest)
+    , m_blockTimeout(100)
+    , m_producerWaiting(0)
+    , m_suspended(0)
+    , m_producing(0)
+    , m_queued(0)
+    , m_droppedOldest(0)
+    , m_droppedNewest(0)
+    , m_timedOut(0)
+    , m_convertedAt(0)
+{
+    qRegisterMetaType<cv::Mat>("cv::Mat");
+}
+
+DSFrameProcessor::~DSFrameProcessor()
+{
+    if (DSFrameScheduler *scheduler = m_scheduler.load())
+        scheduler->remove(this);
+    setWorkerThreadEnabled(false);
+
+    delete m_queue;
+    if (m_inputPool)
+        m_inputPool->release();
+    if (m_outputPool)
+        m_outputPool->release();
+    if (m_previewPool)
+        m_previewPool->release();
+    foreach (DSFramePool *pool, m_regionPools) {
+        if (pool)
+            pool->release();
+    }
+    foreach (DSFramePool *pool, m_subscriptionPools) {
+        if (pool)
+            pool->release();
+    }
+}
+
+void DSFrameProcessor::setFormat(const DSFrameFormat &format)
+{
+    // The consumer reads the format and the producer takes buffers from the
+    // pool; neither may do so while they change. Queued frames belong to the
+    // previous format.
+    const ConsumerState state = suspendConsumer();
+    m_queue->clear();
+    m_format = format;
+
+    const int bufferSize = qMax(format.sampleSize, format.frameSize());
+    if (!m_inputPool || m_inputPool->bufferSize() != bufferSize) {
+        if (m_inputPool)
+            m_inputPool->release();
+        m_inputPool = bufferSize > 0 ? new DSFramePool(bufferSize, m_queue->capacity()) : 0;
+    }
+    resumeConsumer(state);
+}
+
+DSFrameFormat DSFrameProcessor::format() const
+{
+    return m_format;
+}
+
+void DSFrameProcessor::setWorkerThreadEnabled(bool enabled)
+{
+    DSFrameWorker *worker = m_worker.load();
+    if (enabled == (worker != 0))
+        return;
+    if (enabled && m_scheduler.load()) {
+        qWarning() << "DSFrameProcessor: frames are processed by a DSFrameScheduler";
+        return;
+    }
+
+    if (enabled) {
+        worker = new DSFrameWorker(this);
+        worker->start();
+        m_worker.storeRelease(worker);
+    } else {
+        m_worker.storeRelease(0);
+        worker->stop();
+        delete worker;
+
+        // pick up anything the worker left behind
+        QMetaObject::invokeMethod(this, "processFrames", Qt::QueuedConnection);
+    }
+}
+
+bool DSFrameProcessor::isWorkerThreadEnabled() const
+{
+    return m_worker.load() != 0;
+}
+
+DSFrameScheduler *DSFrameProcessor::scheduler() const
+{
+    return m_scheduler.load();
+}
+
+void DSFrameProcessor::setConversionThreadCount(int threadCount)
+{
+    m_bandConverter.setThreadCount(threadCount);
+}
+
+int DSFrameProcessor::conversionThreadCount() const
+{
+    return m_bandConverter.threadCount();
+}
+
+void DSFrameProcessor::setQueueDepth(int depth)
+{
+    depth = qMax(1, depth);
+    if (depth == m_queue->capacity())
+        return;
+
+    // nobody may be looking at the queue while it is replaced
+    const ConsumerState state = suspendConsumer();
+    delete m_queue;
+    m_queue = new DSFrameQueue(depth);
+    resumeConsumer(state);
+}
+
+int DSFrameProcessor::queueDepth() const
+{
+    return m_queue->capacity();
+}
+
+void DSFrameProcessor::setBackpressurePolicy(BackpressurePolicy policy, int timeout)
+{
+    m_blockTimeout.store(qMax(0, timeout));
+    m_policy.store(policy);
+}
+
+DSFrameProcessor::BackpressurePolicy DSFrameProcessor::backpressurePolicy() const
+{
+    return BackpressurePolicy(m_policy.load());
+}
+
+void DSFrameProcessor::setOutputFormat(OutputFormat format)
+{
+    m_outputFormat.store(format);
+}
+
+DSFrameProcessor::OutputFormat DSFrameProcessor::outputFormat() const
+{
+    return OutputFormat(m_outputFormat.load());
+}
+
+void DSFrameProcessor::setPreviewScale(int scale)
+{
+    if (scale != 0 && scale != 2 && scale != 4) {
+        qWarning() << "DSFrameProcessor: unsupported preview scale 1 /" << scale;
+        return;
+    }
+    m_previewScale.store(scale);
+}
+
+int DSFrameProcessor::previewScale() const
+{
+    return m_previewScale.load();
+}
+
+void DSFrameProcessor::setJpegScale(int scale)
+{
+    if (scale != 1 && scale != 2 && scale != 4 && scale != 8) {
+        qWarning() << "DSFrameProcessor: unsupported JPEG scale 1 /" << scale;
+        return;
+    }
+    m_jpegScale.store(scale);
+}
+
+int DSFrameProcessor::jpegScale() const
+{
+    return m_jpegScale.load();
+}
+
+void DSFrameProcessor::setJpegRegion(const QRect &region)
+{
+    QMutexLocker locker(&m_settingsMutex);
+    m_jpegRegion = region;
+}
+
+QRect DSFrameProcessor::jpegRegion() const
+{
+    QMutexLocker locker(&m_settingsMutex);
+    return m_jpegRegion;
+}
+
+void DSFrameProcessor::setRegionsOfInterest(const QList<QRect> &regions)
+{
+    QMutexLocker locker(&m_settingsMutex);
+    m_regions = regions;
+}
+
+QList<QRect> DSFrameProcessor::regionsOfInterest() const
+{
+    QMutexLocker locker(&m_settingsMutex);
+    return m_regions;
+}
+
+int DSFrameProcessor::subscribe(const Subscription &subscription)
+{
+    if (subscription.scale != 1 && subscription.scale != 2 && subscription.scale != 4) {
+        qWarning() << "DSFrameProcessor: unsupported subscription scale 1 /" << subscription.scale;
+        return -1;
+    }
+    if (subscription.outputFormat == PlanarYuvOutput && subscription.scale != 1) {
+        qWarning() << "DSFrameProcessor: planar frames can not be scaled";
+        return -1;
+    }
+
+    SubscriptionState state;
+    state.subscription = subscription;
+    state.due = 0;
+
+    QMutexLocker locker(&m_settingsMutex);
+    const int id = m_nextSubscription++;
+    m_subscriptions.insert(id, state);
+    return id;
+}
+
+void DSFrameProcessor::unsubscribe(int id)
+{
+    QMutexLocker locker(&m_settingsMutex);
+    m_subscriptions.remove(id);
+}
+
+QList<int> DSFrameProcessor::subscriptions() const
+{
+    QMutexLocker locker(&m_settingsMutex);
+    return m_subscriptions.keys();
+}
+
+DSFrameDropStatistics DSFrameProcessor::dropStatistics() const
+{
+    DSFrameDropStatistics stats;
+    stats.queued = m_queued.load();
+    stats.droppedOldest = m_droppedOldest.load();
+    stats.droppedNewest = m_droppedNewest.load();
+    stats.timedOut = m_timedOut.load();
+    stats.decodeErrors = m_decodeErrors.load();
+    stats.shortFrames = m_shortFrames.load();
+    return stats;
+}
+
+DSFramePoolStatistics DSFrameProcessor::inputPoolStatistics() const
+{
+    if (m_inputPool)
+        return m_inputPool->statistics();
+
+    DSFramePoolStatistics stats = { 0, 0, 0, 0 };
+    return stats;
+}
+
+void DSFrameProcessor::setRecorder(DSFrameRecorder *recorder)
+{
+    m_recorder.storeRelease(recorder);
+}
+
+DSLatencyTracer *DSFrameProcessor::latencyTracer()
+{
+    return &m_latency;
+}
+
+DSFramePacingStatistics DSFrameProcessor::arrivalPacing() const
+{
+    return m_arrivalPacing.statistics();
+}
+
+DSFramePacingStatistics DSFrameProcessor::emitPacing() const
+{
+    return m_emitPacing.statistics();
+}
+
+void DSFrameProcessor::resetPacingStatistics()
+{
+    m_arrivalPacing.reset();
+    m_emitPacing.reset();
+}
+
+DSFrameProcessor::ConsumerState DSFrameProcessor::suspendConsumer()
+{
+    // Turn producers away, wake one waiting for room and let the ones inside
+    // leave.
+    m_suspended.fetchAndAddOrdered(1);
+    m_roomMutex.lock();
+    m_roomCondition.wakeAll();
+    m_roomMutex.unlock();
+    while (m_producing.fetchAndAddOrdered(0))
+        QThread::yieldCurrentThread();
+
+    // Both wait for the frame being processed.
+    ConsumerState state;
+    state.worker = isWorkerThreadEnabled();
+    state.scheduler = m_scheduler.load();
+    state.priority = state.scheduler ? state.scheduler->priority(this) : 0;
+    if (state.scheduler)
+        state.scheduler->remove(this);
+    setWorkerThreadEnabled(false);
+    return state;
+}
+
+void DSFrameProcessor::resumeConsumer(const ConsumerState &state)
+{
+    if (state.scheduler)
+        state.scheduler->add(this, state.priority);
+    else
+        setWorkerThreadEnabled(state.worker);
+    m_suspended.fetchAndAddOrdered(-1);
+}
+
+bool DSFrameProcessor::enterProducer()
+{
+    // Announce first, then look, the opposite of suspendConsumer(), so one of
+    // the two always sees the other.
+    m_producing.fetchAndAddOrdered(1);
+    if (!m_suspended.fetchAndAddOrdered(0))
+        return true;
+    m_producing.fetchAndAddOrdered(-1);
+    return false;
+}
+
+void DSFrameProcessor::leaveProducer()
+{
+    m_producing.fetchAndAddOrdered(-1);
+}
+
+DSFrameHandle DSFrameProcessor::acquireBuffer()
+{
+    if (!enterProducer())
+        return DSFrameHandle();
+
+    DSFrameHandle frame;
+    if (m_inputPool) {
+        frame = m_inputPool->acquire();
+        frame->ingestTime = stamp();
+        frame->arrivalTime = frame->ingestTime ? frame->ingestTime : DSLatencyTracer::now();
+    }
+    leaveProducer();
+    return frame;
+}
+
+bool DSFrameProcessor::pushFrame(DSFrameHandle &frame)
+{
+    if (!enterProducer()) {
+        m_droppedNewest.fetchAndAddRelaxed(1);
+        return false;
+    }
+    const bool queued = queueFrame(frame);
+    leaveProducer();
+    return queued;
+}
+
+bool DSFrameProcessor::queueFrame(DSFrameHandle &frame)
+{
+    // The recorder gets every frame, whatever the queue does with it.
+    if (DSFrameRecorder *recorder = m_recorder.loadAcquire())
+        recorder->write(frame);
+
+    frame->enqueueTime = stamp();
+    m_latency.record(DSLatencyTracer::IngestToEnqueue, frame->ingestTime, frame->enqueueTime);
+    m_arrivalPacing.record(frame->time, frame->arrivalTime ? frame->arrivalTime : DSLatencyTracer::now());
+
+    switch (m_policy.load()) {
+    case DropOldest:
+        if (!m_queue->pushEvictingOldest(frame).isNull())
+            m_droppedOldest.fetchAndAddRelaxed(1);
+        break;
+    case BlockWithTimeout:
+        if (!m_queue->push(frame) && !waitForRoom(frame)) {
+            m_timedOut.fetchAndAddRelaxed(1);
+            return false;
+        }
+        break;
+    default:
+        if (!m_queue->push(frame)) {
+            m_droppedNewest.fetchAndAddRelaxed(1);
+            return false;
+        }
+        break;
+    }
+    m_queued.fetchAndAddRelaxed(1);
+
+    // A producer racing a mode switch may wake the wrong consumer; the worker
+    // polls and the switch back posts a drain, so the frame is not stranded.
+    if (DSFrameScheduler *scheduler = m_scheduler.loadAcquire())
+        scheduler->schedule(this);
+    else if (m_worker.loadAcquire())
+        wakeWorker();
+    else
+        QMetaObject::invokeMethod(this, "processFrames", Qt::QueuedConnection);
+    return true;
+}
+
+bool DSFrameProcessor::pushFrame(const quint8 *data, int length, qint64 time)
+{
+    DSFrameHandle frame = acquireBuffer();
+    if (frame.isNull() || length > frame->capacity)
+        return false;
+
+    memcpy(frame->data, data, length);
+    frame->length = length;
+    frame->time = time;
+    return pushFrame(frame);
+}
+
+void DSFrameProcessor::flush()
+{
+    m_queue->clear();
+}
+
+bool DSFrameProcessor::waitForRoom(DSFrameHandle &frame)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const int timeout = m_blockTimeout.load();
+
+    // Same handshake as the worker's: announce the wait, then try again, so a
+    // consumer popping in between is sure to see the flag.
+    QMutexLocker locker(&m_roomMutex);
+    m_producerWaiting.fetchAndStoreOrdered(1);
+    bool pushed = m_queue->push(frame);
+    while (!pushed && !m_suspended.load()) {
+        const qint64 remaining = timeout - timer.elapsed();
+        if (remaining <= 0)
+            break;
+        m_roomCondition.wait(&m_roomMutex, ulong(remaining));
+        pushed = m_queue->push(frame);
+    }
+    m_producerWaiting.fetchAndStoreOrdered(0);
+    return pushed;
+}
+
+DSFrameHandle DSFrameProcessor::popFrame()
+{
+    DSFrameHandle frame = m_queue->pop();
+    if (!frame.isNull() && m_producerWaiting.fetchAndAddOrdered(0)) {
+        QMutexLocker locker(&m_roomMutex);
+        m_roomCondition.wakeOne();
+    }
+    return frame;
+}
+
+void DSFrameProcessor::wakeWorker()
+{
+    if (m_workerWaiting.fetchAndAddOrdered(0)) {
+        QMutexLocker locker(&m_wakeMutex);
+        m_wakeCondition.wakeOne();
+    }
+}
+
+void DSFrameProcessor::processFrames()
+{
+    // the worker or the scheduler is the queue's consumer while set
+    if (m_worker.load() || m_scheduler.load())
+        return;
+
+    // Frames pushed while the worker ran have no event of their own.
+    for (DSFrameHandle frame = popFrame(); !frame.isNull(); frame = popFrame())
+        processFrame(frame);
+}
+
+void DSFrameProcessor::processFrame(const DSFrameHandle &frame)
+{
+    const int width = m_format.width;
+    const int height = m_format.height;
+    const int output = m_outputFormat.load();
+    const bool luma = output == LumaOutput;
+
+    DSConversionJob job;
+    if (!setUpKind(job, luma))
+        return;
+
+    const qint64 dequeued = stamp();
+    m_latency.record(DSLatencyTracer::EnqueueToDequeue, frame->enqueueTime, dequeued);
+    m_convertedAt = 0;
+
+    // Converting a short frame would read past its end; better none at all.
+    if (m_format.pixelFormat != DSFrameFormat::MJPG && frame->length < m_format.frameSize()) {
+        m_shortFrames.fetchAndAddRelaxed(1);
+        return;
+    }
+
+    if (hasSubscriptions()) {
+        processSubscriptions(frame, dequeued);
+        return;
+    }
+
+    const QList<QRect> regions = regionsOfInterest();
+
+    if (m_format.pixelFormat == DSFrameFormat::MJPG) {
+        processJpeg(frame, regions, dequeued);
+        return;
+    }
+
+    if (!regions.isEmpty()) {
+        processRegions(frame, job, regions, dequeued);
+        return;
+    }
+
+    const bool planar = job.kind == DSConversionJob::I420ToRgb24
+            || job.kind == DSConversionJob::Nv12ToRgb24;
+    if (planar && output == PlanarYuvOutput) {
+        emitFrame(planarFrame(frame), frame);
+        return;
+    }
+
+    // The Y plane on its own already is the grey image, as in planarFrame().
+    if (job.kind == DSConversionJob::PlaneToLuma && m_format.stride == width) {
+        const cv::Mat image = DSMatAllocator::wrap(frame, 0, height, width, CV_8UC1, width);
+        emitFrame(image, frame, previewOf(image, m_previewScale.load(), m_previewPool));
+        return;
+    }
+
+    // Everything else ends up as top-down RGB24 or grey.
+    const int channels = job.dstChannels();
+    cv::Mat image = DSMatAllocator::allocate(outputPool(width * height * channels), height, width,
+                                             channels == 1 ? CV_8UC1 : CV_8UC3);
+
+    setUpJob(job, frame, QRect(0, 0, width, height));
+    job.dst = image.data;
+    job.dstStride = int(image.step);
+    const cv::Mat preview = attachPreview(job, m_previewScale.load(), m_previewPool);
+    convert(job, dequeued);
+
+    emitFrame(image, frame, preview);
+}
+
+bool DSFrameProcessor::setUpKind(DSConversionJob &job, bool luma) const
+{
+    switch (m_format.pixelFormat) {
+    case DSFrameFormat::BGR24:
+        job.kind = DSConversionJob::Bgr24ToRgb24;
+        break;
+    case DSFrameFormat::BGR32:
+        job.kind = DSConversionJob::Bgr32ToRgb24;
+        break;
+    case DSFrameFormat::RGB555:
+        job.kind = DSConversionJob::Rgb555ToRgb24;
+        break;
+    case DSFrameFormat::YUY2:
+        job.kind = luma ? DSConversionJob::Yuy2ToLuma : DSConversionJob::Yuy2ToRgb24;
+        job.matrix = &m_format.colorMatrix();
+        break;
+    case DSFrameFormat::UYVY:
+        job.kind = luma ? DSConversionJob::UyvyToLuma : DSConversionJob::UyvyToRgb24;
+        job.matrix = &m_format.colorMatrix();
+        break;
+    case DSFrameFormat::I420:
+        job.kind = luma ? DSConversionJob::PlaneToLuma : DSConversionJob::I420ToRgb24;
+        job.matrix = &m_format.colorMatrix();
+        break;
+    case DSFrameFormat::NV12:
+        job.kind = luma ? DSConversionJob::PlaneToLuma : DSConversionJob::Nv12ToRgb24;
+        job.matrix = &m_format.colorMatrix();
+        break;
+    case DSFrameFormat::MJPG:
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+bool DSFrameProcessor::hasSubscriptions() const
+{
+    QMutexLocker locker(&m_settingsMutex);
+    return !m_subscriptions.isEmpty();
+}
+
+int DSFrameProcessor::effectiveOutput(int output) const
+{
+    // what the processor really makes of a format, so equal results are shared
+    switch (m_format.pixelFormat) {
+    case DSFrameFormat::BGR24:
+    case DSFrameFormat::BGR32:
+    case DSFrameFormat::RGB555:
+        return RgbOutput;
+    case DSFrameFormat::I420:
+    case DSFrameFormat::NV12:
+        return output;
+    default:
+        return output == PlanarYuvOutput ? RgbOutput : output;
+    }
+}
+
+void DSFrameProcessor::processSubscriptions(const DSFrameHandle &frame, qint64 dequeued)
+{
+    // Rates follow arrival, not the camera's time stamps.
+    const qint64 now = frame->ingestTime ? frame->ingestTime : DSLatencyTracer::now();
+
+    // Work out who takes this frame; outputs nobody takes are never made.
+    QList<int> ids;
+    QList<int> keys;
+    {
+        QMutexLocker locker(&m_settingsMutex);
+        QMap<int, SubscriptionState>::iterator it = m_subscriptions.begin();
+        for (; it != m_subscriptions.end(); ++it) {
+            SubscriptionState &state = it.value();
+            const Subscription &subscription = state.subscription;
+            if (subscription.frameRate > 0) {
+                // a quarter interval early still counts, frames do not arrive
+                // exactly on time
+                const qint64 interval = qint64(1e9 / subscription.frameRate);
+                if (now < state.due - interval / 4)
+                    continue;
+                // keep the cadence, without catching up after a stall
+                state.due = qMax(state.due + interval, now + interval / 2);
+            }
+            ids << it.key();
+            keys << outputKey(effectiveOutput(subscription.outputFormat), subscription.scale);
+        }
+    }
+    if (ids.isEmpty())
+        return;
+
+    const qint64 start = stamp();
+    m_latency.record(DSLatencyTracer::DequeueToConvert, dequeued, start);
+
+    // Each format and scale is made once and shared by everyone asking for it.
+    QMap<int, cv::Mat> outputs;
+    const int formats[] = { RgbOutput, PlanarYuvOutput, LumaOutput };
+    for (int i = 0; i < 3; ++i) {
+        QList<int> scales;
+        for (int scale = 1; scale <= 4; scale *= 2) {
+            if (keys.contains(outputKey(formats[i], scale)))
+                scales << scale;
+        }
+        if (!scales.isEmpty())
+            makeOutputs(frame, formats[i], scales, outputs);
+    }
+
+    m_convertedAt = stamp();
+    m_latency.record(DSLatencyTracer::Conversion, start, m_convertedAt);
+
+    recordEmit(frame);
+    for (int i = 0; i < ids.size(); ++i) {
+        const cv::Mat image = outputs.value(keys.at(i));
+        if (!image.empty())
+            emit subscriptionFrameCaptured(ids.at(i), image);
+    }
+}
+
+void DSFrameProcessor::makeOutputs(const DSFrameHandle &frame, int output,
+                                   const QList<int> &scales, QMap<int, cv::Mat> &outputs)
+{
+    // scales holds 1, 2 and 4 in that order, PlanarYuvOutput only 1
+    if (output == PlanarYuvOutput) {
+        outputs.insert(outputKey(output, 1), planarFrame(frame));
+        return;
+    }
+
+    const bool luma = output == LumaOutput;
+    const int width = m_format.width;
+    const int height = m_format.height;
+    int made = scales.first();
+    cv::Mat image;
+
+    if (m_format.pixelFormat == DSFrameFormat::MJPG) {
+        // the scaled IDCT makes the largest size, box filtering the rest
+        if (!decodeJpegTo(frame, QRect(), luma, made,
+                          m_subscriptionPools[outputKey(output, made)], image)) {
+            m_decodeErrors.fetchAndAddRelaxed(1);
+            return;
+        }
+    } else {
+        DSConversionJob job;
+        setUpKind(job, luma);
+        made = 1;
+        if (job.kind == DSConversionJob::PlaneToLuma && m_format.stride == width) {
+            image = DSMatAllocator::wrap(frame, 0, height, width, CV_8UC1, width);
+        } else {
+            const int channels = job.dstChannels();
+            image = DSMatAllocator::allocate(
+                        sizedPool(m_subscriptionPools[outputKey(output, 1)],
+                                  width * height * channels),
+                        height, width, channels == 1 ? CV_8UC1 : CV_8UC3);
+            setUpJob(job, frame, QRect(0, 0, width, height));
+            job.dst = image.data;
+            job.dstStride = int(image.step);
+
+            // the first smaller size comes out of the conversion pass
+            int fused = 1;
+            foreach (int scale, scales) {
+                if (scale > 1) {
+                    fused = scale;
+                    break;
+                }
+            }
+            if (fused > 1) {
+                const cv::Mat preview = attachPreview(
+                            job, fused, m_subscriptionPools[outputKey(output, fused)]);
+                if (!preview.empty())
+                    outputs.insert(outputKey(output, fused), preview);
+            }
+            m_bandConverter.run(job);
+        }
+    }
+
+    outputs.insert(outputKey(output, made), image);
+    foreach (int scale, scales) {
+        const int key = outputKey(output, scale);
+        if (!outputs.contains(key))
+            outputs.insert(key, previewOf(image, scale / made, m_subscriptionPools[key]));
+    }
+}
+
+void DSFrameProcessor::processRegions(const DSFrameHandle &frame, DSConversionJob job,
+                                      const QList<QRect> &regions, qint64 dequeued)
+{
+    const QRect bounds(0, 0, m_format.width, m_format.height);
+    const int channels = job.dstChannels();
+    if (m_regionPools.size() < regions.size())
+        m_regionPools.resize(regions.size());
+
+    const qint64 start = stamp();
+    m_latency.record(DSLatencyTracer::DequeueToConvert, dequeued, start);
+
+    QList<int> indices;
+    QList<cv::Mat> images;
+    for (int i = 0; i < regions.size(); ++i) {
+        const QRect rect = regions.at(i) & bounds;
+        if (rect.isEmpty())
+            continue;
+
+        // Convert whole chroma blocks, then hand out exactly the rectangle.
+        const QRect aligned = alignToChroma(rect);
+        const cv::Mat image = DSMatAllocator::allocate(
+                    sizedPool(m_regionPools[i], aligned.width() * aligned.height() * channels),
+                    aligned.height(), aligned.width(), channels == 1 ? CV_8UC1 : CV_8UC3);
+
+        setUpJob(job, frame, aligned);
+        job.dst = image.data;
+        job.dstStride = int(image.step);
+        m_bandConverter.run(job);
+
+        indices << i;
+        images << image(cv::Rect(rect.x() - aligned.x(), rect.y() - aligned.y(),
+                                 rect.width(), rect.height()));
+    }
+
+    m_convertedAt = stamp();
+    m_latency.record(DSLatencyTracer::Conversion, start, m_convertedAt);
+
+    emitRegions(indices, images, frame);
+}
+
+void DSFrameProcessor::processJpeg(const DSFrameHandle &frame, const QList<QRect> &regions,
+                                   qint64 dequeued)
+{
+    // With regions, decode what covers all of them once and crop from that.
+    QRect decodeRegion = jpegRegion();
+    if (!regions.isEmpty()) {
+        const QRect bounds(0, 0, m_format.width, m_format.height);
+        decodeRegion = QRect();
+        foreach (const QRect &region, regions)
+            decodeRegion |= region & bounds;
+        if (decodeRegion.isEmpty())
+            return;
+    }
+
+    cv::Mat image;
+    if (!decodeJpeg(frame, dequeued, decodeRegion, image)) {
+        m_decodeErrors.fetchAndAddRelaxed(1);
+        return;
+    }
+
+    if (regions.isEmpty()) {
+        emitFrame(image, frame, previewOf(image, m_previewScale.load(), m_previewPool));
+        return;
+    }
+
+    // Regions are in full size pixels, the image is scaled and offset.
+    const int scale = m_jpegDecoder.scale();
+    const QPoint origin = m_jpegDecoder.outputRegion().topLeft();
+    const QRect decoded(0, 0, image.cols, image.rows);
+
+    QList<int> indices;
+    QList<cv::Mat> images;
+    for (int i = 0; i < regions.size(); ++i) {
+        const QRect region = regions.at(i);
+        const QRect scaled = QRect(QPoint(region.left() / scale, region.top() / scale),
+                                   QPoint(region.right() / scale, region.bottom() / scale))
+                .translated(-origin) & decoded;
+        if (scaled.isEmpty())
+            continue;
+
+        indices << i;
+        images << image(cv::Rect(scaled.x(), scaled.y(), scaled.width(), scaled.height()));
+    }
+
+    emitRegions(indices, images, frame);
+}
+
+void DSFrameProcessor::setUpJob(DSConversionJob &job, const DSFrameHandle &frame,
+                                const QRect &rect) const
+{
+    const int height = m_format.height;
+    const int stride = m_format.stride;
+
+    // flip a bottom-up image by reading its rows backwards
+    const int firstRow = m_format.bottomUp ? height - 1 - rect.y() : rect.y();
+    job.src = frame->data + qptrdiff(firstRow) * stride + rect.x() * m_format.bytesPerPixel();
+    job.srcStride = m_format.bottomUp ? -stride : stride;
+    job.width = rect.width();
+    job.height = rect.height();
+
+    // 4:2:0 chroma follows the Y plane; rect starts on an even row and column
+    const quint8 *chroma = frame->data + stride * height;
+    const int chromaRow = rect.y() / 2;
+    if (m_format.pixelFormat == DSFrameFormat::I420) {
+        job.srcUVStride = stride / 2;
+        job.srcU = chroma + chromaRow * job.srcUVStride + rect.x() / 2;
+        job.srcV = chroma + job.srcUVStride * ((height + 1) / 2) + chromaRow * job.srcUVStride
+                + rect.x() / 2;
+    } else if (m_format.pixelFormat == DSFrameFormat::NV12) {
+        job.srcUVStride = stride;
+        job.srcU = chroma + chromaRow * stride + rect.x();
+    }
+}
+
+QRect DSFrameProcessor::alignToChroma(const QRect &rect) const
+{
+    // Pixel pairs share their chroma, in 4:2:0 row pairs as well.
+    int alignX = 1;
+    int alignY = 1;
+    switch (m_format.pixelFormat) {
+    case DSFrameFormat::YUY2:
+    case DSFrameFormat::UYVY:
+        alignX = 2;
+        break;
+    case DSFrameFormat::I420:
+    case DSFrameFormat::NV12:
+        alignX = alignY = 2;
+        break;
+    default:
+        return rect;
+    }
+
+    const int left = rect.x() & ~(alignX - 1);
+    const int top = rect.y() & ~(alignY - 1);
+    const int right = qMin(m_format.width, (rect.x() + rect.width() + alignX - 1) & ~(alignX - 1));
+    const int bottom = qMin(m_format.height, (rect.y() + rect.height() + alignY - 1) & ~(alignY - 1));
+    return QRect(left, top, right - left, bottom - top);
+}
+
+cv::Mat DSFrameProcessor::planarFrame(const DSFrameHandle &frame)
+{
+    const int width = m_format.width;
+    const int height = m_format.height;
+    const int stride = m_format.stride;
+    const int rows = height * 3 / 2;
+
+    // Without row padding the frame already is the Mat, so just hand out the
+    // buffer; it goes back to the input pool once the receivers are done.
+    if (stride == width && frame->length >= m_format.frameSize())
+        return DSMatAllocator::wrap(frame, 0, rows, width, CV_8UC1, width);
+
+    cv::Mat planar = DSMatAllocator::allocate(outputPool(width * rows), rows, width, CV_8UC1);
+    if (frame->length < m_format.frameSize())
+        return planar;
+
+    // Y, then either U and V at half width or the U V pairs at full width
+    const quint8 *src = frame->data;
+    for (int row = 0; row < height; ++row)
+        memcpy(planar.ptr(row), src + row * stride, width);
+    src += stride * height;
+
+    quint8 *dst = planar.ptr(height);
+    if (m_format.pixelFormat == DSFrameFormat::I420) {
+        for (int row = 0; row < height; ++row) {
+            memcpy(dst, src, width / 2);
+            src += stride / 2;
+            dst += width / 2;
+        }
+    } else {
+        for (int row = 0; row < height / 2; ++row) {
+            memcpy(dst, src, width);
+            src += stride;
+            dst += width;
+        }
+    }
+    return planar;
+}
+
+bool DSFrameProcessor::decodeJpeg(const DSFrameHandle &frame, qint64 dequeued,
+                                  const QRect &region, cv::Mat &image)
+{
+    const qint64 start = stamp();
+    m_latency.record(DSLatencyTracer::DequeueToConvert, dequeued, start);
+
+    if (!decodeJpegTo(frame, region, m_outputFormat.load() == LumaOutput, m_jpegScale.load(),
+                      m_outputPool, image)) {
+        return false;
+    }
+
+    m_convertedAt = stamp();
+    m_latency.record(DSLatencyTracer::Conversion, start, m_convertedAt);
+    return true;
+}
+
+bool DSFrameProcessor::decodeJpegTo(const DSFrameHandle &frame, const QRect &region, bool grey,
+                                    int scale, DSFramePool *&pool, cv::Mat &image)
+{
+    m_jpegDecoder.setGrayscale(grey);
+    m_jpegDecoder.setScale(scale);
+    m_jpegDecoder.setRegion(region);
+
+    // The output size is only known once the header has been read.
+    const QSize size = m_jpegDecoder.start(frame->data, frame->length);
+    if (size.isEmpty())
+        return false;
+
+    const int channels = grey ? 1 : 3;
+    image = DSMatAllocator::allocate(sizedPool(pool, size.width() * size.height() * channels),
+                                     size.height(), size.width(), grey ? CV_8UC1 : CV_8UC3);
+    return m_jpegDecoder.decode(image.data, int(image.step));
+}
+
+cv::Mat DSFrameProcessor::attachPreview(DSConversionJob &job, int factor, DSFramePool *&pool)
+{
+    if (factor < 2 || job.width < factor || job.height < factor)
+        return cv::Mat();
+
+    const int width = job.width / factor;
+    const int height = job.height / factor;
+    const int channels = job.dstChannels();
+    cv::Mat preview = DSMatAllocator::allocate(sizedPool(pool, width * height * channels),
+                                               height, width, channels == 1 ? CV_8UC1 : CV_8UC3);
+    job.preview = preview.data;
+    job.previewStride = int(preview.step);
+    job.previewFactor = factor;
+    return preview;
+}
+
+cv::Mat DSFrameProcessor::previewOf(const cv::Mat &image, int factor, DSFramePool *&pool)
+{
+    // for frames that are not converted row by row
+    if (factor < 2 || image.cols < factor || image.rows < factor)
+        return cv::Mat();
+
+    const int width = image.cols / factor;
+    const int height = image.rows / factor;
+    const int channels = image.channels();
+    cv::Mat preview = DSMatAllocator::allocate(sizedPool(pool, width * height * channels),
+                                               height, width, image.type());
+    DSFrameConverter::downscaleBox(image.data, int(image.step), preview.data, int(preview.step),
+                                   image.cols, image.rows, channels, factor);
+    return preview;
+}
+
+qint64 DSFrameProcessor::stamp() const
+{
+    return m_latency.isEnabled() ? DSLatencyTracer::now() : 0;
+}
+
+void DSFrameProcessor::convert(const DSConversionJob &job, qint64 dequeued)
+{
+    const qint64 start = stamp();
+    m_latency.record(DSLatencyTracer::DequeueToConvert, dequeued, start);
+
+    m_bandConverter.run(job);
+
+    m_convertedAt = stamp();
+    m_latency.record(DSLatencyTracer::Conversion, start, m_convertedAt);
+}
+
+void DSFrameProcessor::emitFrame(const cv::Mat &frame, const DSFrameHandle &source,
+                                 const cv::Mat &preview)
+{
+    recordEmit(source);
+
+    emit cvFrameCaptured(frame);
+    if (!preview.empty())
+        emit previewFrameCaptured(preview);
+}
+
+void DSFrameProcessor::emitRegions(const QList<int> &indices, const QList<cv::Mat> &images,
+                                   const DSFrameHandle &source)
+{
+    recordEmit(source);
+
+    for (int i = 0; i < indices.size(); ++i)
+        emit regionCaptured(indices.at(i), images.at(i));
+}
+
+void DSFrameProcessor::recordEmit(const DSFrameHandle &source)
+{
+    const qint64 emitted = stamp();
+    m_latency.record(DSLatencyTracer::ConvertToEmit, m_convertedAt, emitted);
+    m_latency.record(DSLatencyTracer::IngestToEmit, source->ingestTime, emitted);
+    m_emitPacing.record(source->time, emitted ? emitted : DSLatencyTracer::now());
+}
+
+DSFramePool *DSFrameProcessor::outputPool(int bufferSize)
+{
+    return sizedPool(m_outputPool, bufferSize);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,334 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSFRAMEPROCESSOR_H
+#define DSFRAMEPROCESSOR_H
+
+#include <QtCore/qobject.h>
+#include <QtCore/qatomic.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qmap.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qvector.h>
+#include <QtCore/qwaitcondition.h>
+
+#include <opencv2/core/core.hpp>
+
+#include "dsbandconverter.h"
+#include "dsframeformat.h"
+#include "dsframepool.h"
+#include "dsframequeue.h"
+#include "dsjpegdecoder.h"
+#include "dsframepacing.h"
+#include "dslatencytracer.h"
+
+QT_BEGIN_NAMESPACE
+
+class DSFrameWorker;
+class DSFrameScheduler;
+class DSSchedulerThread;
+class DSFrameRecorder;
+
+// Frames the producer could not queue, counted per backpressure policy.
+struct DSFrameDropStatistics
+{
+    int queued;
+    int droppedOldest;  // DropOldest: queued frames replaced by newer ones
+    int droppedNewest;  // DropNewest: incoming frames turned away
+    int timedOut;       // BlockWithTimeout: incoming frames dropped after waiting
+    int decodeErrors;   // MJPG frames that did not decode and were not emitted
+    int shortFrames;    // frames shorter than their format, not emitted
+};
+
+// Frame pipeline behind DSCameraSession: queueing, conversion and emission.
+//
+// A single producer thread fills buffers from acquireBuffer() and hands them
+// to pushFrame(); nothing in here knows where the frames come from. By default
+// frames are converted and emitted on the thread the processor lives in. With
+// the worker thread enabled that happens on a thread the processor owns and
+// receivers only get the finished frames, queued to their own thread. Added
+// to a DSFrameScheduler, it happens on the scheduler's threads instead, shared
+// with other processors.
+class DSFrameProcessor : public QObject
+{
+    Q_OBJECT
+public:
+    // What pushFrame() does when the queue is full.
+    enum BackpressurePolicy {
+        DropNewest,         // turn the incoming frame away
+        DropOldest,         // replace the oldest queued frame
+        BlockWithTimeout    // wait for room, then turn the frame away
+    };
+
+    // What cvFrameCaptured() carries.
+    enum OutputFormat {
+        RgbOutput,          // CV_8UC3, top-down RGB24
+        PlanarYuvOutput,    // I420 and NV12 as they come: CV_8UC1, height * 3 / 2
+                            // rows of width bytes; other formats as RgbOutput
+        LumaOutput          // CV_8UC1 grey from the Y of YUV formats and MJPG,
+                            // no colour conversion; RGB formats as RgbOutput
+    };
+
+    // What a subscriber wants of each frame.
+    struct Subscription
+    {
+        Subscription() : outputFormat(RgbOutput), scale(1), frameRate(0) {}
+
+        OutputFormat outputFormat;
+        int scale;          // 1, 2 or 4 for full, half or quarter size
+        qreal frameRate;    // at most this many frames a second, 0 for all
+    };
+
+    DSFrameProcessor(QObject *parent = 0);
+    ~DSFrameProcessor();
+
+    // Queued frames are dropped. Like setQueueDepth(), stops the consumer
+    // while the format changes and turns away frames pushed meanwhile. Call
+    // from the thread the processor lives in.
+    void setFormat(const DSFrameFormat &format);
+    DSFrameFormat format() const;
+
+    // Not while added to a DSFrameScheduler.
+    void setWorkerThreadEnabled(bool enabled);
+    bool isWorkerThreadEnabled() const;
+
+    DSFrameScheduler *scheduler() const;
+
+    // Cores a single frame may be spread over, <= 0 for all of them. Call
+    // while no frames are being pushed.
+    void setConversionThreadCount(int threadCount);
+    int conversionThreadCount() const;
+
+    // Frames that may wait for conversion. Queued frames are dropped. The
+    // worker thread or scheduler is stopped while the queue is replaced and
+    // frames pushed meanwhile are turned away. Call from the thread the
+    // processor lives in.
+    void setQueueDepth(int depth);
+    int queueDepth() const;
+
+    // timeout only applies to BlockWithTimeout, in milliseconds
+    void setBackpressurePolicy(BackpressurePolicy policy, int timeout = 100);
+    BackpressurePolicy backpressurePolicy() const;
+
+    // May be changed while frames are pushed.
+    void setOutputFormat(OutputFormat format);
+    OutputFormat outputFormat() const;
+
+    // MJPG frames are decoded at 1 / scale of their size (1, 2, 4 or 8) and
+    // only as far as needed for region, given in full size pixels; an empty
+    // region decodes the whole frame. Both may be changed while frames are
+    // pushed.
+    void setJpegScale(int scale);
+    int jpegScale() const;
+    void setJpegRegion(const QRect &region);
+    QRect jpegRegion() const;
+
+    // With a scale of 2 or 4, every RGB or grey frame is followed by a copy
+    // shrunk by that much on previewFrameCaptured(), each pixel the average
+    // of a scale x scale block. It is made while the frame is converted, from
+    // rows still in cache. 0 turns it off; PlanarYuvOutput frames have none.
+    // May be changed while frames are pushed.
+    void setPreviewScale(int scale);
+    int previewScale() const;
+
+    // While any regions are set, only those parts of a frame are converted and
+    // each is emitted on regionCaptured() with its index in the list instead
+    // of the whole frame on cvFrameCaptured(). Regions are in pixels of the
+    // full frame and clipped to it; ones outside it are skipped. MJPG frames
+    // are decoded once over all regions at jpegScale(), jpegRegion() does not
+    // apply. Regions are RGB or grey, also for PlanarYuvOutput, and come
+    // without a preview. May be changed while frames are pushed.
+    void setRegionsOfInterest(const QList<QRect> &regions);
+    QList<QRect> regionsOfInterest() const;
+
+    // While anyone is subscribed, frames go to subscribers only, on
+    // subscriptionFrameCaptured() with the id subscribe() returned. Each
+    // format and scale somebody takes is made once per frame and the same
+    // cv::Mat handed to all of them, so treat it as read-only; a frame nobody
+    // takes is not converted at all. Smaller sizes are box filtered in the
+    // conversion pass, or decoded smaller for MJPG. The output format, preview,
+    // regions and JPEG settings do not apply meanwhile. subscribe() returns -1
+    // for a scale other than 1, 2 or 4 and for scaled PlanarYuvOutput. May be
+    // called while frames are pushed.
+    int subscribe(const Subscription &subscription);
+    void unsubscribe(int id);
+    QList<int> subscriptions() const;
+
+    DSFramePoolStatistics inputPoolStatistics() const;
+    DSFrameDropStatistics dropStatistics() const;
+
+    // Every pushed frame is also handed to recorder, if set. The recorder has
+    // to outlive the processor or be unset while no frames are pushed.
+    void setRecorder(DSFrameRecorder *recorder);
+
+    // Per stage latency; tracing is on by default.
+    DSLatencyTracer *latencyTracer();
+
+    // Intervals between frames as they are pushed, every frame the producer
+    // delivers, and as they are emitted, what consumers get once frames are
+    // dropped; see DSFramePacing.
+    DSFramePacingStatistics arrivalPacing() const;
+    DSFramePacingStatistics emitPacing() const;
+    void resetPacingStatistics();
+
+    // Producer side. pushFrame() returns false if the frame was dropped.
+    DSFrameHandle acquireBuffer();
+    bool pushFrame(DSFrameHandle &frame);
+    bool pushFrame(const quint8 *data, int length, qint64 time);
+
+    // Drops queued frames. Call while no frames are being pushed.
+    void flush();
+
+Q_SIGNALS:
+    void cvFrameCaptured(cv::Mat frame);
+    void previewFrameCaptured(cv::Mat frame);
+    void regionCaptured(int index, cv::Mat frame);
+    void subscriptionFrameCaptured(int id, cv::Mat frame);
+
+private Q_SLOTS:
+    void processFrames();
+
+private:
+    // What suspendConsumer() stopped, for resumeConsumer() to start again.
+    struct ConsumerState
+    {
+        bool worker;
+        DSFrameScheduler *scheduler;
+        int priority;
+    };
+
+    ConsumerState suspendConsumer();
+    void resumeConsumer(const ConsumerState &state);
+    bool enterProducer();
+    void leaveProducer();
+    bool queueFrame(DSFrameHandle &frame);
+
+    DSFrameHandle popFrame();
+    void processFrame(const DSFrameHandle &frame);
+    struct SubscriptionState
+    {
+        Subscription subscription;
+        qint64 due;     // monotonic nanoseconds of the next frame to take
+    };
+
+    bool setUpKind(DSConversionJob &job, bool luma) const;
+    bool hasSubscriptions() const;
+    int effectiveOutput(int output) const;
+    void processSubscriptions(const DSFrameHandle &frame, qint64 dequeued);
+    void makeOutputs(const DSFrameHandle &frame, int output, const QList<int> &scales,
+                     QMap<int, cv::Mat> &outputs);
+    void processRegions(const DSFrameHandle &frame, DSConversionJob job,
+                        const QList<QRect> &regions, qint64 dequeued);
+    void processJpeg(const DSFrameHandle &frame, const QList<QRect> &regions, qint64 dequeued);
+    void setUpJob(DSConversionJob &job, const DSFrameHandle &frame, const QRect &rect) const;
+    QRect alignToChroma(const QRect &rect) const;
+    cv::Mat planarFrame(const DSFrameHandle &frame);
+    cv::Mat attachPreview(DSConversionJob &job, int factor, DSFramePool *&pool);
+    cv::Mat previewOf(const cv::Mat &image, int factor, DSFramePool *&pool);
+    bool decodeJpeg(const DSFrameHandle &frame, qint64 dequeued, const QRect &region,
+                    cv::Mat &image);
+    bool decodeJpegTo(const DSFrameHandle &frame, const QRect &region, bool grey, int scale,
+                      DSFramePool *&pool, cv::Mat &image);
+    qint64 stamp() const;
+    void convert(const DSConversionJob &job, qint64 dequeued);
+    void emitFrame(const cv::Mat &frame, const DSFrameHandle &source,
+                   const cv::Mat &preview = cv::Mat());
+    void emitRegions(const QList<int> &indices, const QList<cv::Mat> &images,
+                     const DSFrameHandle &source);
+    void recordEmit(const DSFrameHandle &source);
+    DSFramePool *outputPool(int bufferSize);
+    void wakeWorker();
+    bool waitForRoom(DSFrameHandle &frame);
+
+    DSFrameFormat m_format;
+    DSFrameQueue *m_queue;
+    DSFramePool *m_inputPool;
+    DSFramePool *m_outputPool;
+    DSFramePool *m_previewPool;
+    QVector<DSFramePool *> m_regionPools;
+    QMap<int, DSFramePool *> m_subscriptionPools;
+    DSBandConverter m_bandConverter;
+    QAtomicInt m_outputFormat;
+    QAtomicInt m_previewScale;
+
+    DSJpegDecoder m_jpegDecoder;
+    QAtomicInt m_jpegScale;
+    mutable QMutex m_settingsMutex;
+    QRect m_jpegRegion;
+    QList<QRect> m_regions;
+    QMap<int, SubscriptionState> m_subscriptions;
+    int m_nextSubscription;
+    QAtomicInt m_decodeErrors;
+    QAtomicInt m_shortFrames;
+    QAtomicPointer<DSFrameRecorder> m_recorder;
+
+    QAtomicPointer<DSFrameWorker> m_worker;
+    QAtomicPointer<DSFrameScheduler> m_scheduler;
+    QMutex m_wakeMutex;
+    QWaitCondition m_wakeCondition;
+    QAtomicInt m_workerWaiting;
+
+    QAtomicInt m_policy;
+    QAtomicInt m_blockTimeout;
+    QMutex m_roomMutex;
+    QWaitCondition m_roomCondition;
+    QAtomicInt m_producerWaiting;
+    QAtomicInt m_suspended;
+    QAtomicInt m_producing;
+
+    QAtomicInt m_queued;
+    QAtomicInt m_droppedOldest;
+    QAtomicInt m_droppedNewest;
+    QAtomicInt m_timedOut;
+
+    DSLatencyTracer m_latency;
+    qint64 m_convertedAt;
+    DSFramePacing m_arrivalPacing;
+    DSFramePacing m_emitPacing;
+
+    friend class DSFrameWorker;
+    friend class DSFrameScheduler;
+    friend class DSSchedulerThread;
+};
+
+QT_END_NAMESPACE
+
+#endif
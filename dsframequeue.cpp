@@ -0,0 +1,87 @@
+#include "dsframequeue.h"
+
+QT_BEGIN_NAMESPACE
+
+// Head and tail are free running counters; they are compared and advanced as
+// unsigned values so wrapping around is well defined.
+//
+// The producer only ever writes the slot at head. Once it has claimed the
+// oldest frame by moving tail on, that slot is the same one it is about to
+// fill, which is why the consumer takes its frame with a CAS on tail and the
+// slots are atomic: a consumer that read a slot being replaced loses the CAS
+// and tries again.
+
+DSFrameQueue::DSFrameQueue(int capacity)
+    : m_capacity(qMax(1, capacity))
+    , m_head(0)
+    , m_tail(0)
+{
+    int size = 1;
+    while (size < m_capacity)
+        size <<= 1;
+
+    m_slots = new QAtomicPointer<DSFrameBuffer>[size];
+    m_mask = size - 1;
+}
+
+DSFrameQueue::~DSFrameQueue()
+{
+    clear();
+    delete[] m_slots;
+}
+
+int DSFrameQueue::count() const
+{
+    return int(uint(m_head.loadAcquire()) - uint(m_tail.loadAcquire()));
+}
+
+bool DSFrameQueue::push(DSFrameHandle &frame)
+{
+    const uint head = uint(m_head.load());
+    const uint tail = uint(m_tail.loadAcquire());
+
+    if (head - tail >= uint(m_capacity))
+        return false;
+
+    m_slots[head & m_mask].store(frame.take());
+    m_head.storeRelease(int(head + 1));
+    return true;
+}
+
+DSFrameHandle DSFrameQueue::pushEvictingOldest(DSFrameHandle &frame)
+{
+    const uint head = uint(m_head.load());
+    const uint tail = uint(m_tail.loadAcquire());
+    DSFrameBuffer *evicted = 0;
+
+    // If the CAS fails the consumer has just made room.
+    if (head - tail >= uint(m_capacity) && m_tail.testAndSetOrdered(int(tail), int(tail + 1)))
+        evicted = m_slots[tail & m_mask].loadAcquire();
+
+    m_slots[head & m_mask].store(frame.take());
+    m_head.storeRelease(int(head + 1));
+    return DSFrameHandle::adopt(evicted);
+}
+
+DSFrameHandle DSFrameQueue::pop()
+{
+    for (;;) {
+        const uint tail = uint(m_tail.loadAcquire());
+        const uint head = uint(m_head.loadAcquire());
+
+        if (tail == head)
+            return DSFrameHandle();
+
+        DSFrameBuffer *buffer = m_slots[tail & m_mask].loadAcquire();
+        if (m_tail.testAndSetOrdered(int(tail), int(tail + 1)))
+            return DSFrameHandle::adopt(buffer);
+    }
+}
+
+void DSFrameQueue::clear()
+{
+    while (!pop().isNull())
+        ;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,100 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSFRAMEQUEUE_H
+#define DSFRAMEQUEUE_H
+
+#include <QtCore/qglobal.h>
+#include <QtCore/qatomic.h>
+
+#include "dsframepool.h"
+
+QT_BEGIN_NAMESPACE
+
+// Bounded single producer, single consumer ring of frame handles.
+//
+// push() may only be called from one thread and pop() from one other thread.
+// The producer never blocks nor loops: a push is a handful of loads and one
+// release store, so the DirectShow streaming thread never waits on the
+// consumer. pop() only retries when the producer evicted the frame it was
+// about to take.
+class DSFrameQueue
+{
+public:
+    explicit DSFrameQueue(int capacity);
+    ~DSFrameQueue();
+
+    int capacity() const { return m_capacity; }
+    int count() const;
+    bool isEmpty() const { return count() == 0; }
+
+    // Producer side. Returns false, leaving frame untouched, when full.
+    bool push(DSFrameHandle &frame);
+
+    // Producer side. Always queues frame; when full the oldest queued frame
+    // is taken out and returned instead.
+    DSFrameHandle pushEvictingOldest(DSFrameHandle &frame);
+
+    // Consumer side. Returns a null handle when empty.
+    DSFrameHandle pop();
+
+    // Consumer side. Drops every queued frame.
+    void clear();
+
+private:
+    Q_DISABLE_COPY(DSFrameQueue)
+
+    QAtomicPointer<DSFrameBuffer> *m_slots;
+    int m_mask;
+    int m_capacity;
+
+    // written by the producer and consumer respectively, kept on separate
+    // cache lines so they do not bounce between the two cores
+    char m_pad0[64];
+    QAtomicInt m_head;
+    char m_pad1[64 - sizeof(QAtomicInt)];
+    QAtomicInt m_tail;
+    char m_pad2[64 - sizeof(QAtomicInt)];
+};
+
+QT_END_NAMESPACE
+
+#endif
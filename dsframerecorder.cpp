@@ -0,0 +1,282 @@
+#include <QDebug>
+#include <QtCore/qfile.h>
+#include <QtCore/qthread.h>
+
+#include "dsframerecorder.h"
+#include "dsrecordformat.h"
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+// Frames in flight between the capture thread and the writer; at 1080p YUY2
+// that is a little over half a second of video.
+const int RecorderQueueDepth = 32;
+
+const qint64 DefaultSegmentSize = Q_INT64_C(1) << 30;
+const qint64 StagingSize = 8 << 20;
+
+} // end namespace
+
+class DSRecorderThread : public QThread
+{
+public:
+    DSRecorderThread(DSFrameRecorder *recorder, const QString &basePath, const DSFrameFormat &format)
+        : m_recorder(recorder)
+        , m_basePath(basePath)
+        , m_format(format)
+        , m_stop(0)
+        , m_staging(0)
+        , m_stagingSize(0)
+        , m_stagingUsed(0)
+        , m_segment(-1)
+        , m_segmentOffset(0)
+        , m_frameNumber(0)
+        , m_failed(false)
+    {
+    }
+
+    ~DSRecorderThread()
+    {
+        qFreeAligned(m_staging);
+    }
+
+    // Opens the first segment, so start() can report failure.
+    bool open()
+    {
+        const qint64 largestFrame = DSRecordFormat::alignToBlock(qMax(m_format.sampleSize, m_format.frameSize()));
+        m_stagingSize = qMax(StagingSize, 2 * largestFrame);
+        m_staging = static_cast<quint8 *>(qMallocAligned(size_t(m_stagingSize), DSRecordFormat::BlockSize));
+        return m_staging && openSegment();
+    }
+
+    void stop()
+    {
+        m_stop.store(1);
+        m_recorder->m_wakeMutex.lock();
+        m_recorder->m_wakeCondition.wakeAll();
+        m_recorder->m_wakeMutex.unlock();
+        wait();
+    }
+
+protected:
+    void run()
+    {
+        for (;;) {
+            DSFrameHandle frame = m_recorder->m_queue.pop();
+            if (!frame.isNull()) {
+                writeFrame(frame);
+                continue;
+            }
+            if (m_stop.load())
+                break;
+
+            // Nothing queued: write out what we have rather than sitting on
+            // it, then sleep until the producer wakes us.
+            flush();
+
+            QMutexLocker locker(&m_recorder->m_wakeMutex);
+            m_recorder->m_writerWaiting.fetchAndStoreOrdered(1);
+            if (m_recorder->m_queue.isEmpty() && !m_stop.load())
+                m_recorder->m_wakeCondition.wait(&m_recorder->m_wakeMutex, 100);
+            m_recorder->m_writerWaiting.fetchAndStoreOrdered(0);
+        }
+
+        closeSegment();
+    }
+
+private:
+    void writeFrame(const DSFrameHandle &frame)
+    {
+        if (m_failed) {
+            m_recorder->m_dropped.fetchAndAddRelaxed(1);
+            return;
+        }
+
+        const qint64 size = DSRecordFormat::alignToBlock(frame->length);
+        if (size > m_stagingSize - DSRecordFormat::BlockSize) {
+            m_recorder->m_dropped.fetchAndAddRelaxed(1);
+            return;
+        }
+
+        if (m_segmentOffset + m_stagingUsed + size > m_recorder->m_segmentSize
+                && m_segmentOffset + m_stagingUsed > DSRecordFormat::BlockSize) {
+            closeSegment();
+            if (!openSegment()) {
+                m_recorder->m_dropped.fetchAndAddRelaxed(1);
+                return;
+            }
+        }
+
+        if (m_stagingUsed + size > m_stagingSize)
+            flush();
+
+        DSRecordFormat::IndexEntry entry;
+        entry.offset = m_segmentOffset + m_stagingUsed;
+        entry.time = frame->time;
+        entry.length = frame->length;
+        entry.reserved = 0;
+        m_index.append(reinterpret_cast<const char *>(&entry), sizeof(entry));
+
+        quint8 *dst = m_staging + m_stagingUsed;
+        memcpy(dst, frame->data, frame->length);
+        memset(dst + frame->length, 0, size - frame->length);
+        m_stagingUsed += size;
+        ++m_frameNumber;
+    }
+
+    // Writes the staging buffer, then the index entries of the frames in it,
+    // so the index never refers to data that is not on disk.
+    void flush()
+    {
+        if (!m_stagingUsed || m_failed)
+            return;
+
+        const qint64 frames = m_index.size() / qint64(sizeof(DSRecordFormat::IndexEntry));
+        if (m_data.write(reinterpret_cast<const char *>(m_staging), m_stagingUsed) != m_stagingUsed
+                || m_indexFile.write(m_index) != m_index.size()) {
+            qWarning() << "DSFrameRecorder: write failed," << m_data.errorString();
+            m_failed = true;
+            m_recorder->m_dropped.fetchAndAddRelaxed(frames);
+        } else {
+            m_recorder->m_written.fetchAndAddRelaxed(frames);
+            m_recorder->m_bytes.fetchAndAddRelaxed(m_stagingUsed);
+        }
+
+        m_segmentOffset += m_stagingUsed;
+        m_stagingUsed = 0;
+        m_index.clear();
+    }
+
+    bool openSegment()
+    {
+        ++m_segment;
+        m_data.setFileName(DSRecordFormat::segmentPath(m_basePath, m_segment));
+        m_indexFile.setFileName(DSRecordFormat::indexPath(m_basePath, m_segment));
+
+        if (!m_data.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)
+                || !m_indexFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << "DSFrameRecorder: cannot create" << m_data.fileName();
+            m_data.close();
+            m_failed = true;
+            return false;
+        }
+
+        // the header takes the first block, frames start on the next one
+        const DSRecordFormat::Header header = DSRecordFormat::header(m_format, m_segment, m_frameNumber);
+        memset(m_staging, 0, DSRecordFormat::BlockSize);
+        memcpy(m_staging, &header, sizeof(header));
+        m_stagingUsed = DSRecordFormat::BlockSize;
+        m_segmentOffset = 0;
+
+        m_recorder->m_segments.fetchAndAddRelaxed(1);
+        return true;
+    }
+
+    void closeSegment()
+    {
+        flush();
+        m_data.close();
+        m_indexFile.close();
+    }
+
+    DSFrameRecorder *m_recorder;
+    QString m_basePath;
+    DSFrameFormat m_format;
+    QAtomicInt m_stop;
+
+    quint8 *m_staging;
+    qint64 m_stagingSize;
+    qint64 m_stagingUsed;
+    QByteArray m_index;
+
+    QFile m_data;
+    QFile m_indexFile;
+    int m_segment;
+    qint64 m_segmentOffset;
+    qint64 m_frameNumber;
+    bool m_failed;
+};
+
+DSFrameRecorder::DSFrameRecorder()
+    : m_segmentSize(DefaultSegmentSize)
+    , m_recording(0)
+    , m_queue(RecorderQueueDepth)
+    , m_thread(0)
+    , m_writerWaiting(0)
+    , m_written(0)
+    , m_dropped(0)
+    , m_bytes(0)
+    , m_segments(0)
+{
+}
+
+DSFrameRecorder::~DSFrameRecorder()
+{
+    stop();
+}
+
+bool DSFrameRecorder::start(const QString &basePath, const DSFrameFormat &format)
+{
+    stop();
+
+    m_queue.clear();
+    m_written.store(0);
+    m_dropped.store(0);
+    m_bytes.store(0);
+    m_segments.store(0);
+
+    m_thread = new DSRecorderThread(this, basePath, format);
+    if (!m_thread->open()) {
+        delete m_thread;
+        m_thread = 0;
+        return false;
+    }
+
+    m_thread->start();
+    m_recording.store(1);
+    return true;
+}
+
+void DSFrameRecorder::stop()
+{
+    if (!m_thread)
+        return;
+
+    // Frames pushed from here on stay queued until the next start() drops
+    // them; they are not part of this recording.
+    m_recording.store(0);
+    m_thread->stop();
+    delete m_thread;
+    m_thread = 0;
+}
+
+bool DSFrameRecorder::write(const DSFrameHandle &frame)
+{
+    if (!m_recording.load())
+        return false;
+
+    DSFrameHandle ref(frame);
+    if (!m_queue.push(ref)) {
+        m_dropped.fetchAndAddRelaxed(1);
+        return false;
+    }
+
+    if (m_writerWaiting.fetchAndAddOrdered(0)) {
+        QMutexLocker locker(&m_wakeMutex);
+        m_wakeCondition.wakeOne();
+    }
+    return true;
+}
+
+DSRecorderStatistics DSFrameRecorder::statistics() const
+{
+    DSRecorderStatistics stats;
+    stats.framesWritten = m_written.load();
+    stats.framesDropped = m_dropped.load();
+    stats.bytesWritten = m_bytes.load();
+    stats.segments = m_segments.load();
+    return stats;
+}
+
+QT_END_NAMESPACE
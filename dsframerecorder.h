@@ -0,0 +1,120 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSFRAMERECORDER_H
+#define DSFRAMERECORDER_H
+
+#include <QtCore/qglobal.h>
+#include <QtCore/qatomic.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qwaitcondition.h>
+#include <QtCore/qstring.h>
+
+#include "dsframeformat.h"
+#include "dsframequeue.h"
+
+QT_BEGIN_NAMESPACE
+
+class DSRecorderThread;
+
+struct DSRecorderStatistics
+{
+    qint64 framesWritten;
+    qint64 framesDropped;   // writer fell behind or a write failed
+    qint64 bytesWritten;
+    int segments;
+};
+
+// Writes raw frames and their times into segmented DSRecordFormat files.
+//
+// write() hands a reference to the frame to a writer thread and returns; it
+// never copies, allocates nor waits, so it can be called from the capture
+// thread. The writer packs frames into a large block aligned staging buffer
+// and writes it out in one go, so the disk sees few, big, aligned writes.
+class DSFrameRecorder
+{
+public:
+    DSFrameRecorder();
+    ~DSFrameRecorder();
+
+    // Segments are rolled over once they would grow beyond this, 1 GiB by
+    // default.
+    void setSegmentSize(qint64 bytes) { m_segmentSize = bytes; }
+    qint64 segmentSize() const { return m_segmentSize; }
+
+    // Starts a recording of frames in format into segments named after
+    // basePath, see DSRecordFormat.
+    bool start(const QString &basePath, const DSFrameFormat &format);
+
+    // Writes out what is queued, then closes the files.
+    void stop();
+
+    bool isRecording() const { return m_recording.load(); }
+
+    // Producer side, called from one thread only. Returns false if the frame
+    // will not be recorded.
+    bool write(const DSFrameHandle &frame);
+
+    DSRecorderStatistics statistics() const;
+
+private:
+    Q_DISABLE_COPY(DSFrameRecorder)
+
+    qint64 m_segmentSize;
+    QAtomicInt m_recording;
+    DSFrameQueue m_queue;
+    DSRecorderThread *m_thread;
+
+    QMutex m_wakeMutex;
+    QWaitCondition m_wakeCondition;
+    QAtomicInt m_writerWaiting;
+
+    QAtomicInteger<qint64> m_written;
+    QAtomicInteger<qint64> m_dropped;
+    QAtomicInteger<qint64> m_bytes;
+    QAtomicInt m_segments;
+
+    friend class DSRecorderThread;
+};
+
+QT_END_NAMESPACE
+
+#endif
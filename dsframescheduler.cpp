@@ -0,0 +1,258 @@
+#include <QtCore/qthread.h>
+#include <QtCore/qelapsedtimer.h>
+
+#include "dsframescheduler.h"
+#include "dsframeprocessor.h"
+
+QT_BEGIN_NAMESPACE
+
+struct DSScheduledProcessor
+{
+    DSFrameProcessor *processor;
+    int priority;
+    int previousThreadCount;
+    qint64 virtualTime;     // processing nanoseconds / priority
+    bool ready;
+    bool running;
+    DSSchedulerStatistics stats;
+};
+
+class DSSchedulerThread : public QThread
+{
+public:
+    DSSchedulerThread(DSFrameScheduler *scheduler)
+        : m_scheduler(scheduler)
+    {
+    }
+
+protected:
+    void run()
+    {
+        QElapsedTimer timer;
+        while (DSScheduledProcessor *entry = m_scheduler->takeReady()) {
+            timer.start();
+            bool processed = false;
+            {
+                // one frame at a time, so others get their turn in between
+                const DSFrameHandle frame = entry->processor->popFrame();
+                if (!frame.isNull()) {
+                    entry->processor->processFrame(frame);
+                    processed = true;
+                }
+            }
+            m_scheduler->finished(entry, processed ? timer.nsecsElapsed() : -1);
+        }
+    }
+
+private:
+    DSFrameScheduler *m_scheduler;
+};
+
+DSFrameScheduler::DSFrameScheduler(int threadCount)
+    : m_virtualClock(0)
+    , m_running(0)
+    , m_stop(false)
+{
+    if (threadCount <= 0)
+        threadCount = qMax(1, QThread::idealThreadCount());
+
+    for (int i = 0; i < threadCount; ++i) {
+        DSSchedulerThread *thread = new DSSchedulerThread(this);
+        m_threads.append(thread);
+        thread->start();
+    }
+}
+
+DSFrameScheduler::~DSFrameScheduler()
+{
+    m_mutex.lock();
+    m_stop = true;
+    m_workAvailable.wakeAll();
+    m_mutex.unlock();
+
+    foreach (DSSchedulerThread *thread, m_threads) {
+        thread->wait();
+        delete thread;
+    }
+
+    // hand whatever is left back to the processors
+    while (!m_processors.isEmpty())
+        remove(m_processors.first()->processor);
+}
+
+void DSFrameScheduler::add(DSFrameProcessor *processor, int priority)
+{
+    if (contains(processor))
+        return;
+
+    DSScheduledProcessor *entry = new DSScheduledProcessor;
+    entry->processor = processor;
+    entry->priority = qMax(1, priority);
+    entry->previousThreadCount = processor->conversionThreadCount();
+    entry->virtualTime = 0;
+    entry->ready = false;
+    entry->running = false;
+    entry->stats.frames = 0;
+    entry->stats.busyTime = 0;
+
+    processor->setWorkerThreadEnabled(false);
+    processor->setConversionThreadCount(1);
+
+    QMutexLocker locker(&m_mutex);
+    m_processors.append(entry);
+    processor->m_scheduler.storeRelease(this);
+    if (!processor->m_queue->isEmpty()) {
+        entry->virtualTime = m_virtualClock;
+        makeReady(entry);
+    }
+}
+
+void DSFrameScheduler::remove(DSFrameProcessor *processor)
+{
+    QMutexLocker locker(&m_mutex);
+    DSScheduledProcessor *entry = find(processor);
+    if (!entry)
+        return;
+
+    processor->m_scheduler.storeRelease(0);
+    while (entry->running)
+        m_idle.wait(&m_mutex);
+    if (entry->ready)
+        m_ready.removeOne(entry);
+    m_processors.removeOne(entry);
+    locker.unlock();
+
+    processor->setConversionThreadCount(entry->previousThreadCount);
+    delete entry;
+
+    // pick up anything left behind, as when the worker thread stops
+    QMetaObject::invokeMethod(processor, "processFrames", Qt::QueuedConnection);
+}
+
+bool DSFrameScheduler::contains(DSFrameProcessor *processor) const
+{
+    QMutexLocker locker(&m_mutex);
+    return find(processor) != 0;
+}
+
+void DSFrameScheduler::setPriority(DSFrameProcessor *processor, int priority)
+{
+    QMutexLocker locker(&m_mutex);
+    if (DSScheduledProcessor *entry = find(processor))
+        entry->priority = qMax(1, priority);
+}
+
+int DSFrameScheduler::priority(DSFrameProcessor *processor) const
+{
+    QMutexLocker locker(&m_mutex);
+    DSScheduledProcessor *entry = find(processor);
+    return entry ? entry->priority : 0;
+}
+
+DSSchedulerStatistics DSFrameScheduler::statistics(DSFrameProcessor *processor) const
+{
+    QMutexLocker locker(&m_mutex);
+    if (DSScheduledProcessor *entry = find(processor))
+        return entry->stats;
+
+    DSSchedulerStatistics stats;
+    stats.frames = 0;
+    stats.busyTime = 0;
+    return stats;
+}
+
+bool DSFrameScheduler::waitForDone(unsigned long msecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QMutexLocker locker(&m_mutex);
+    while (m_running || !m_ready.isEmpty()) {
+        unsigned long remaining = ULONG_MAX;
+        if (msecs != ULONG_MAX) {
+            const qint64 left = qint64(msecs) - timer.elapsed();
+            if (left <= 0)
+                return false;
+            remaining = ulong(left);
+        }
+        m_idle.wait(&m_mutex, remaining);
+    }
+    return true;
+}
+
+void DSFrameScheduler::schedule(DSFrameProcessor *processor)
+{
+    QMutexLocker locker(&m_mutex);
+    DSScheduledProcessor *entry = find(processor);
+
+    // A running processor looks at its queue again once the frame is done.
+    if (!entry || entry->ready || entry->running)
+        return;
+
+    // no credit for the time spent idle
+    entry->virtualTime = qMax(entry->virtualTime, m_virtualClock);
+    makeReady(entry);
+}
+
+DSScheduledProcessor *DSFrameScheduler::find(DSFrameProcessor *processor) const
+{
+    foreach (DSScheduledProcessor *entry, m_processors) {
+        if (entry->processor == processor)
+            return entry;
+    }
+    return 0;
+}
+
+DSScheduledProcessor *DSFrameScheduler::takeReady()
+{
+    QMutexLocker locker(&m_mutex);
+    while (!m_stop && m_ready.isEmpty())
+        m_workAvailable.wait(&m_mutex);
+    if (m_stop)
+        return 0;
+
+    // the one furthest behind its share
+    int best = 0;
+    for (int i = 1; i < m_ready.size(); ++i) {
+        if (m_ready.at(i)->virtualTime < m_ready.at(best)->virtualTime)
+            best = i;
+    }
+
+    DSScheduledProcessor *entry = m_ready.takeAt(best);
+    entry->ready = false;
+    entry->running = true;
+    m_virtualClock = qMax(m_virtualClock, entry->virtualTime);
+    ++m_running;
+    return entry;
+}
+
+void DSFrameScheduler::finished(DSScheduledProcessor *entry, qint64 busyTime)
+{
+    QMutexLocker locker(&m_mutex);
+    entry->running = false;
+    --m_running;
+
+    // -1 if an earlier run already took the frame this one was scheduled for
+    if (busyTime >= 0) {
+        entry->virtualTime += busyTime / entry->priority;
+        ++entry->stats.frames;
+        entry->stats.busyTime += busyTime;
+    }
+
+    // Checked under the lock schedule() takes after pushing, so a frame
+    // pushed meanwhile is either seen here or schedules the processor anew.
+    if (entry->processor->m_scheduler.loadAcquire() && !entry->processor->m_queue->isEmpty())
+        makeReady(entry);
+
+    // remove() and waitForDone() wait for this
+    m_idle.wakeAll();
+}
+
+void DSFrameScheduler::makeReady(DSScheduledProcessor *entry)
+{
+    entry->ready = true;
+    m_ready.append(entry);
+    m_workAvailable.wakeOne();
+}
+
+QT_END_NAMESPACE
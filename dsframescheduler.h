@@ -0,0 +1,132 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSFRAMESCHEDULER_H
+#define DSFRAMESCHEDULER_H
+
+#include <QtCore/qglobal.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qwaitcondition.h>
+
+#include <climits>
+
+QT_BEGIN_NAMESPACE
+
+class DSFrameProcessor;
+class DSSchedulerThread;
+struct DSScheduledProcessor;
+
+struct DSSchedulerStatistics
+{
+    qint64 frames;          // frames processed on the pool
+    qint64 busyTime;        // nanoseconds spent processing them
+};
+
+// One pool of threads processing the frames of many DSFrameProcessors, in
+// place of a worker thread, or the GUI thread, per camera.
+//
+// A processor with queued frames is ready; whenever a thread is free it takes
+// one frame from the ready processor that has had the least processing time
+// so far, weighted by priority. Time is measured, not frames, so a camera with
+// frames eight times as large gets an eighth of the frames of one with the
+// same priority once the pool is saturated; a processor of priority 2 gets
+// twice the time of one of priority 1. Processors coming back from idle start
+// level with the others instead of making up for the time they did not need.
+//
+// Frames of one processor are never processed on two threads at once and keep
+// their order. All threads take from one ready list, so no frame waits behind
+// a busy thread while another is idle. A single lock guards it, held for well
+// under a microsecond per frame that takes milliseconds to process.
+class DSFrameScheduler
+{
+public:
+    // threadCount <= 0 uses one thread per core
+    explicit DSFrameScheduler(int threadCount = 0);
+    ~DSFrameScheduler();
+
+    int threadCount() const { return m_threads.size(); }
+
+    // Frames pushed into processor from now on are processed on the pool.
+    // Each processor converts on one thread, as the pool's threads run
+    // processors side by side; remove() restores the thread count. Call
+    // add() and remove() while no frames are pushed into processor.
+    void add(DSFrameProcessor *processor, int priority = 1);
+    void remove(DSFrameProcessor *processor);
+    bool contains(DSFrameProcessor *processor) const;
+
+    // >= 1; may be changed while frames are pushed
+    void setPriority(DSFrameProcessor *processor, int priority);
+    int priority(DSFrameProcessor *processor) const;
+
+    DSSchedulerStatistics statistics(DSFrameProcessor *processor) const;
+
+    // Waits until no processor has frames queued or being processed.
+    bool waitForDone(unsigned long msecs = ULONG_MAX);
+
+private:
+    Q_DISABLE_COPY(DSFrameScheduler)
+
+    // called by DSFrameProcessor::pushFrame()
+    void schedule(DSFrameProcessor *processor);
+
+    DSScheduledProcessor *find(DSFrameProcessor *processor) const;
+    DSScheduledProcessor *takeReady();
+    void finished(DSScheduledProcessor *entry, qint64 busyTime);
+    void makeReady(DSScheduledProcessor *entry);
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_workAvailable;
+    QWaitCondition m_idle;
+    QList<DSScheduledProcessor *> m_processors;
+    QList<DSScheduledProcessor *> m_ready;
+    qint64 m_virtualClock;
+    int m_running;
+    bool m_stop;
+    QList<DSSchedulerThread *> m_threads;
+
+    friend class DSFrameProcessor;
+    friend class DSSchedulerThread;
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,78 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSFRAMESOURCE_H
+#define DSFRAMESOURCE_H
+
+#include <QtCore/qglobal.h>
+
+#include "dsframeformat.h"
+
+QT_BEGIN_NAMESPACE
+
+class DSFrameProcessor;
+
+// Where raw frames come from: a capture device, a generator, a file.
+//
+// A source owns the thread that delivers its frames and is the only producer
+// of the processor it was started with, filling buffers from acquireBuffer()
+// and handing them over with pushFrame(). Frame times are stream times in
+// nanoseconds.
+class DSFrameSource
+{
+public:
+    virtual ~DSFrameSource() {}
+
+    // Layout of the frames start() delivers.
+    virtual DSFrameFormat format() const = 0;
+
+    // Sets processor up for format() and starts pushing frames into it.
+    virtual bool start(DSFrameProcessor *processor) = 0;
+
+    // Returns once no more frames are pushed.
+    virtual void stop() = 0;
+
+    virtual bool isActive() const = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,194 @@
+#include <QDebug>
+#include <QtCore/qvector.h>
+
+#include <cstdio>
+#include <csetjmp>
+#include <jpeglib.h>
+#include <jerror.h>
+
+#include "dsjpegdecoder.h"
+
+QT_BEGIN_NAMESPACE
+
+struct DSJpegContext
+{
+    jpeg_decompress_struct info;
+    jpeg_error_mgr error;
+    jmp_buf jump;
+    bool truncated;
+    QVector<quint8> row;    // a scanline wider than the region
+};
+
+namespace {
+
+// Fatal libjpeg errors have to leave through error_exit, which must not return.
+void errorExit(j_common_ptr info)
+{
+    longjmp(static_cast<DSJpegContext *>(info->client_data)->jump, 1);
+}
+
+// Warnings are not printed, cameras send plenty of harmless ones (extraneous
+// bytes before a marker and the like). Running out of data is remembered
+// though: libjpeg carries on and fills the rest of the frame with grey.
+void emitMessage(j_common_ptr info, int level)
+{
+    if (level >= 0)
+        return;
+    const int code = info->err->msg_code;
+    if (code == JWRN_JPEG_EOF || code == JWRN_HIT_MARKER)
+        static_cast<DSJpegContext *>(info->client_data)->truncated = true;
+}
+
+} // end namespace
+
+DSJpegDecoder::DSJpegDecoder()
+    : m_context(new DSJpegContext)
+    , m_scale(1)
+    , m_grayscale(false)
+    , m_started(false)
+    , m_errors(0)
+{
+    m_context->info.err = jpeg_std_error(&m_context->error);
+    m_context->error.error_exit = errorExit;
+    m_context->error.emit_message = emitMessage;
+    jpeg_create_decompress(&m_context->info);
+    m_context->info.client_data = m_context;
+}
+
+DSJpegDecoder::~DSJpegDecoder()
+{
+    jpeg_destroy_decompress(&m_context->info);
+    delete m_context;
+}
+
+void DSJpegDecoder::setScale(int denominator)
+{
+    if (denominator != 1 && denominator != 2 && denominator != 4 && denominator != 8) {
+        qWarning() << "DSJpegDecoder: unsupported scale 1 /" << denominator;
+        return;
+    }
+    m_scale = denominator;
+}
+
+void DSJpegDecoder::setGrayscale(bool grayscale)
+{
+    m_grayscale = grayscale;
+}
+
+void DSJpegDecoder::setRegion(const QRect &region)
+{
+    m_region = region;
+}
+
+QSize DSJpegDecoder::start(const quint8 *data, int length)
+{
+    jpeg_decompress_struct &info = m_context->info;
+    if (m_started) {
+        jpeg_abort_decompress(&info);
+        m_started = false;
+    }
+
+    if (setjmp(m_context->jump)) {
+        fail();
+        return QSize();
+    }
+
+    // MJPEG frames usually leave out the Huffman tables; libjpeg falls back to
+    // the standard ones.
+    m_context->truncated = false;
+    jpeg_mem_src(&info, const_cast<unsigned char *>(data), length);
+    jpeg_read_header(&info, TRUE);
+    info.out_color_space = m_grayscale ? JCS_GRAYSCALE : JCS_RGB;
+    info.scale_num = 1;
+    info.scale_denom = m_scale;
+    jpeg_calc_output_dimensions(&info);
+
+    const QRect image(0, 0, info.output_width, info.output_height);
+    QRect wanted = image;
+    if (!m_region.isEmpty()) {
+        // round outwards so every pixel asked for is covered
+        const int left = m_region.left() / m_scale;
+        const int top = m_region.top() / m_scale;
+        const int right = (m_region.right() + m_scale) / m_scale;
+        const int bottom = (m_region.bottom() + m_scale) / m_scale;
+        wanted = QRect(left, top, right - left, bottom - top) & image;
+    }
+    if (wanted.isEmpty()) {
+        fail();
+        return QSize();
+    }
+
+    m_outputRegion = wanted;
+    m_started = true;
+    return wanted.size();
+}
+
+bool DSJpegDecoder::decode(quint8 *dst, int dstStride)
+{
+    if (!m_started)
+        return false;
+    m_started = false;
+
+    jpeg_decompress_struct &info = m_context->info;
+    if (setjmp(m_context->jump))
+        return fail();
+
+    jpeg_start_decompress(&info);
+
+    JDIMENSION x = m_outputRegion.x();
+    JDIMENSION width = m_outputRegion.width();
+#ifdef LIBJPEG_TURBO_VERSION
+    // widens the range to iMCU boundaries
+    if (width < info.output_width)
+        jpeg_crop_scanline(&info, &x, &width);
+    jpeg_skip_scanlines(&info, m_outputRegion.y());
+#else
+    x = 0;
+    width = info.output_width;
+#endif
+
+    const int components = info.output_components;
+    const int skip = (m_outputRegion.x() - int(x)) * components;
+    const bool direct = skip == 0 && int(width) == m_outputRegion.width();
+#ifdef LIBJPEG_TURBO_VERSION
+    if (!direct)
+#else
+    // rows above the region are read into the row buffer and dropped
+    if (!direct || m_outputRegion.y() > 0)
+#endif
+        m_context->row.resize(width * components);
+    JSAMPROW buffer = m_context->row.data();
+
+#ifndef LIBJPEG_TURBO_VERSION
+    for (int row = 0; row < m_outputRegion.y(); ++row)
+        jpeg_read_scanlines(&info, &buffer, 1);
+#endif
+
+    for (int row = 0; row < m_outputRegion.height(); ++row) {
+        quint8 *line = dst + qptrdiff(row) * dstStride;
+        if (direct) {
+            jpeg_read_scanlines(&info, &line, 1);
+        } else {
+            jpeg_read_scanlines(&info, &buffer, 1);
+            memcpy(line, buffer + skip, m_outputRegion.width() * components);
+        }
+    }
+
+    // a frame cut short over USB, rather drop it than hand it on
+    if (m_context->truncated)
+        return fail();
+
+    // nothing below the region is needed
+    jpeg_abort_decompress(&info);
+    return true;
+}
+
+bool DSJpegDecoder::fail()
+{
+    jpeg_abort_decompress(&m_context->info);
+    m_started = false;
+    ++m_errors;
+    return false;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,113 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSJPEGDECODER_H
+#define DSJPEGDECODER_H
+
+#include <QtCore/qglobal.h>
+#include <QtCore/qrect.h>
+#include <QtCore/qsize.h>
+
+QT_BEGIN_NAMESPACE
+
+struct DSJpegContext;
+
+// Decodes MJPEG frames to RGB24, or to 8 bit grey, with libjpeg(-turbo).
+//
+// Frames can be decoded at 1/2, 1/4 or 1/8 of their size through the scaled
+// inverse DCT, which skips most of the decoding work rather than throwing
+// pixels away afterwards. A region limits decoding further: rows above it are
+// skipped, rows below it are never read and, with libjpeg-turbo, only the
+// iMCU columns covering it go through the IDCT.
+//
+// Decoding is split in two so the caller can size the output in between:
+// start() reads the header, decode() writes the pixels. Not thread-safe; use
+// one decoder per thread.
+class DSJpegDecoder
+{
+public:
+    DSJpegDecoder();
+    ~DSJpegDecoder();
+
+    // 1, 2, 4 or 8
+    void setScale(int denominator);
+    int scale() const { return m_scale; }
+
+    // Grey output comes straight from the Y component; chroma is entropy
+    // decoded but skips the IDCT, upsampling and colour conversion.
+    void setGrayscale(bool grayscale);
+    bool isGrayscale() const { return m_grayscale; }
+
+    // In pixels of the full size frame; empty for the whole frame.
+    void setRegion(const QRect &region);
+    QRect region() const { return m_region; }
+
+    // Parses the frame header and returns the size decode() will produce, or
+    // an empty size if data is not a JPEG image. data has to stay valid
+    // until decode() returns.
+    QSize start(const quint8 *data, int length);
+
+    // The part of the scaled frame decode() writes, valid after start().
+    QRect outputRegion() const { return m_outputRegion; }
+
+    // Decodes the frame passed to start() into RGB24 or grey rows.
+    bool decode(quint8 *dst, int dstStride);
+
+    // Frames start() or decode() failed on.
+    int errorCount() const { return m_errors; }
+
+private:
+    Q_DISABLE_COPY(DSJpegDecoder)
+
+    bool fail();
+
+    DSJpegContext *m_context;
+    int m_scale;
+    bool m_grayscale;
+    QRect m_region;
+    QRect m_outputRegion;   // in scaled pixels
+    bool m_started;
+    int m_errors;
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,114 @@
+#include "dslatencytracer.h"
+
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qalgorithms.h>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+// QElapsedTimer is monotonic on every platform; on Windows it reads the
+// performance counter, which is cheap enough to take a few times per frame.
+const QElapsedTimer &monotonicClock()
+{
+    static QElapsedTimer timer;
+    static bool started = (timer.start(), true);
+    Q_UNUSED(started)
+    return timer;
+}
+
+} // end namespace
+
+DSLatencyHistogram::DSLatencyHistogram()
+    : m_max(0)
+{
+    for (int i = 0; i < BucketCount; ++i)
+        m_buckets[i].store(0);
+}
+
+// Values below SubBuckets get a bucket each. Above that a bucket is made of
+// the position of the highest set bit and the SubBucketBits bits after it.
+int DSLatencyHistogram::bucketIndex(quint64 nsecs)
+{
+    if (nsecs < quint64(SubBuckets))
+        return int(nsecs);
+
+    const int msb = 63 - int(qCountLeadingZeroBits(nsecs));
+    const int sub = int(nsecs >> (msb - SubBucketBits)) & (SubBuckets - 1);
+    return (msb - SubBucketBits + 1) * SubBuckets + sub;
+}
+
+// Middle of the values that end up in bucket index.
+qint64 DSLatencyHistogram::bucketValue(int index)
+{
+    if (index < SubBuckets)
+        return index;
+
+    const int shift = index / SubBuckets - 1;
+    const qint64 lower = qint64(SubBuckets + index % SubBuckets) << shift;
+    return lower + ((qint64(1) << shift) - 1) / 2;
+}
+
+void DSLatencyHistogram::record(qint64 nsecs)
+{
+    m_buckets[bucketIndex(quint64(nsecs))].fetchAndAddRelaxed(1);
+
+    qint64 max = m_max.load();
+    while (nsecs > max && !m_max.testAndSetRelaxed(max, nsecs))
+        max = m_max.load();
+}
+
+void DSLatencyHistogram::reset()
+{
+    for (int i = 0; i < BucketCount; ++i)
+        m_buckets[i].store(0);
+    m_max.store(0);
+}
+
+DSLatencyStatistics DSLatencyHistogram::statistics() const
+{
+    DSLatencyStatistics stats = { 0, 0, 0, 0 };
+
+    // The recording thread may carry on while we read; count what we see.
+    qint64 counts[BucketCount];
+    for (int i = 0; i < BucketCount; ++i) {
+        counts[i] = m_buckets[i].load();
+        stats.count += counts[i];
+    }
+    stats.max = m_max.load();
+    if (!stats.count)
+        return stats;
+
+    const qint64 rank50 = (stats.count * 50 + 99) / 100;
+    const qint64 rank99 = (stats.count * 99 + 99) / 100;
+    qint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        const qint64 previous = seen;
+        seen += counts[i];
+        if (previous < rank50 && seen >= rank50)
+            stats.p50 = qMin(bucketValue(i), stats.max);
+        if (previous < rank99 && seen >= rank99) {
+            stats.p99 = qMin(bucketValue(i), stats.max);
+            break;
+        }
+    }
+    return stats;
+}
+
+DSLatencyTracer::DSLatencyTracer()
+    : m_enabled(1)
+{
+}
+
+qint64 DSLatencyTracer::now()
+{
+    return monotonicClock().nsecsElapsed();
+}
+
+void DSLatencyTracer::reset()
+{
+    for (int i = 0; i < StageCount; ++i)
+        m_histograms[i].reset();
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,131 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSLATENCYTRACER_H
+#define DSLATENCYTRACER_H
+
+#include <QtCore/qglobal.h>
+#include <QtCore/qatomic.h>
+
+QT_BEGIN_NAMESPACE
+
+// Latency percentiles of one pipeline stage, in nanoseconds.
+struct DSLatencyStatistics
+{
+    qint64 count;
+    qint64 p50;
+    qint64 p99;
+    qint64 max;
+};
+
+// Fixed size, lock-free latency histogram.
+//
+// Buckets are log-linear: each power of two is split into eight, so any
+// reported percentile is within 12.5% of the recorded value. record() is a
+// couple of relaxed atomic adds; one thread may record while others read.
+class DSLatencyHistogram
+{
+public:
+    DSLatencyHistogram();
+
+    void record(qint64 nsecs);
+    void reset();
+
+    DSLatencyStatistics statistics() const;
+
+private:
+    Q_DISABLE_COPY(DSLatencyHistogram)
+
+    enum {
+        SubBucketBits = 3,
+        SubBuckets = 1 << SubBucketBits,
+        BucketCount = (64 - SubBucketBits) * SubBuckets
+    };
+
+    static int bucketIndex(quint64 nsecs);
+    static qint64 bucketValue(int index);
+
+    QAtomicInt m_buckets[BucketCount];
+    QAtomicInteger<qint64> m_max;
+};
+
+// Per stage latency of the frame pipeline, from the moment a frame is handed
+// to us until cvFrameCaptured is emitted.
+class DSLatencyTracer
+{
+public:
+    enum Stage {
+        IngestToEnqueue,    // copying the sample into a pooled buffer
+        EnqueueToDequeue,   // waiting in the queue
+        DequeueToConvert,   // output allocation and setup
+        Conversion,         // pixel conversion
+        ConvertToEmit,      // everything between conversion and the signal
+        IngestToEmit,       // the whole pipeline
+        StageCount
+    };
+
+    DSLatencyTracer();
+
+    // Monotonic time in nanoseconds; only differences are meaningful.
+    static qint64 now();
+
+    void setEnabled(bool enabled) { m_enabled.store(enabled); }
+    bool isEnabled() const { return m_enabled.load(); }
+
+    void record(Stage stage, qint64 start, qint64 end)
+    {
+        if (start && end >= start)
+            m_histograms[stage].record(end - start);
+    }
+
+    DSLatencyStatistics statistics(Stage stage) const { return m_histograms[stage].statistics(); }
+    void reset();
+
+private:
+    Q_DISABLE_COPY(DSLatencyTracer)
+
+    QAtomicInt m_enabled;
+    DSLatencyHistogram m_histograms[StageCount];
+};
+
+QT_END_NAMESPACE
+
+#endif
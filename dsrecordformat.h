@@ -0,0 +1,150 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSRECORDFORMAT_H
+#define DSRECORDFORMAT_H
+
+#include <QtCore/qglobal.h>
+#include <QtCore/qstring.h>
+
+#include "dsframeformat.h"
+
+QT_BEGIN_NAMESPACE
+
+// On-disk layout of raw recordings, written by DSFrameRecorder.
+//
+// A recording is a series of segments, <base>.00000.dsraw, <base>.00001.dsraw
+// and so on, each with a <base>.NNNNN.dsidx index next to it. A segment starts
+// with a DSRecordHeader padded to BlockSize, followed by the frames exactly as
+// captured, each starting on a BlockSize boundary. The index holds one
+// DSRecordIndexEntry per frame. Everything is little endian.
+namespace DSRecordFormat
+{
+    enum {
+        BlockSize = 4096,
+        Version = 1
+    };
+
+    struct Header
+    {
+        char magic[8];          // "DSRAW\0\0\0"
+        quint32 version;
+        quint32 headerSize;     // BlockSize, where the first frame starts
+        qint32 segment;
+        qint32 pixelFormat;     // DSFrameFormat::PixelFormat
+        qint32 width;
+        qint32 height;
+        qint32 stride;
+        qint32 bottomUp;
+        qint32 colorStandard;
+        qint32 colorRange;
+        qint32 sampleSize;
+        qint32 reserved;
+        qint64 firstFrame;      // number of the segment's first frame in the recording
+    };
+
+    struct IndexEntry
+    {
+        qint64 offset;          // of the frame data in the segment
+        qint64 time;            // capture time stamp of the frame in nanoseconds
+        qint32 length;
+        qint32 reserved;
+    };
+
+    inline qint64 alignToBlock(qint64 size)
+    {
+        return (size + BlockSize - 1) & ~qint64(BlockSize - 1);
+    }
+
+    inline QString segmentPath(const QString &base, int segment)
+    {
+        return QString::fromLatin1("%1.%2.dsraw").arg(base).arg(segment, 5, 10, QLatin1Char('0'));
+    }
+
+    inline QString indexPath(const QString &base, int segment)
+    {
+        return QString::fromLatin1("%1.%2.dsidx").arg(base).arg(segment, 5, 10, QLatin1Char('0'));
+    }
+
+    inline Header header(const DSFrameFormat &format, int segment, qint64 firstFrame)
+    {
+        Header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "DSRAW\0\0\0", 8);
+        header.version = Version;
+        header.headerSize = BlockSize;
+        header.segment = segment;
+        header.pixelFormat = format.pixelFormat;
+        header.width = format.width;
+        header.height = format.height;
+        header.stride = format.stride;
+        header.bottomUp = format.bottomUp;
+        header.colorStandard = format.colorStandard;
+        header.colorRange = format.colorRange;
+        header.sampleSize = format.sampleSize;
+        header.firstFrame = firstFrame;
+        return header;
+    }
+
+    inline bool isValid(const Header &header)
+    {
+        return !memcmp(header.magic, "DSRAW\0\0\0", 8) && header.version == Version
+                && header.headerSize >= sizeof(Header);
+    }
+
+    inline DSFrameFormat format(const Header &header)
+    {
+        DSFrameFormat format;
+        format.pixelFormat = DSFrameFormat::PixelFormat(header.pixelFormat);
+        format.width = header.width;
+        format.height = header.height;
+        format.stride = header.stride;
+        format.bottomUp = header.bottomUp != 0;
+        format.colorStandard = DSColorMatrix::Standard(header.colorStandard);
+        format.colorRange = DSColorMatrix::Range(header.colorRange);
+        format.sampleSize = header.sampleSize;
+        return format;
+    }
+}
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,284 @@
+#include <QDebug>
+#include <QtCore/qfile.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qwaitcondition.h>
+#include <QtCore/qelapsedtimer.h>
+
+#include "dsreplayframesource.h"
+#include "dsframeprocessor.h"
+#include "dsrecordformat.h"
+
+QT_BEGIN_NAMESPACE
+
+// Hands out bare buffers pointing into the mapped segments, and unmaps them
+// once the last of those buffers has come back.
+class DSReplayFramePool : public DSFramePool
+{
+public:
+    DSReplayFramePool()
+        : DSFramePool(0)
+    {
+    }
+
+    QList<QFile *> files;
+
+protected:
+    ~DSReplayFramePool()
+    {
+        // closing a QFile unmaps what was mapped through it
+        qDeleteAll(files);
+    }
+};
+
+class DSReplayThread : public QThread
+{
+public:
+    DSReplayThread(DSReplayFrameSource *source, DSFrameProcessor *processor)
+        : m_source(source)
+        , m_processor(processor)
+        , m_stop(0)
+    {
+    }
+
+    void stop()
+    {
+        m_mutex.lock();
+        m_stop.store(1);
+        m_condition.wakeAll();
+        m_mutex.unlock();
+        wait();
+    }
+
+protected:
+    void run()
+    {
+        const int frameCount = m_source->m_frames.size();
+        QElapsedTimer timer;
+        qint64 baseTime = 0;
+        bool rebase = true;
+
+        while (!m_stop.load()) {
+            if (m_source->m_seeked.fetchAndStoreOrdered(0))
+                rebase = true;
+
+            int index = m_source->m_position.load();
+            if (index >= frameCount) {
+                if (!m_source->m_looping || !frameCount)
+                    break;
+                m_source->m_position.testAndSetOrdered(index, 0);
+                rebase = true;
+                continue;
+            }
+
+            const DSReplayFrameSource::Frame &recorded = m_source->m_frames.at(index);
+            if (m_source->m_pacing == DSReplayFrameSource::RealTime) {
+                if (rebase) {
+                    timer.start();
+                    baseTime = recorded.time;
+                    rebase = false;
+                }
+                if (!sleepUntil(timer, recorded.time - baseTime))
+                    break;
+                // a seek while we slept: go and pace the new frame instead
+                if (m_source->m_position.load() != index)
+                    continue;
+            }
+
+            DSFrameHandle frame = m_source->m_pool->acquire();
+            // the mapping is read-only; nothing down the pipeline writes to input frames
+            frame->data = const_cast<quint8 *>(recorded.data);
+            frame->length = recorded.length;
+            frame->time = recorded.time;
+            frame->ingestTime = DSLatencyTracer::now();
+            frame->arrivalTime = frame->ingestTime;
+
+            if (m_processor->pushFrame(frame))
+                m_source->m_delivered.fetchAndAddRelaxed(1);
+            else
+                m_source->m_dropped.fetchAndAddRelaxed(1);
+
+            // leave the position alone if seek() moved it meanwhile
+            m_source->m_position.testAndSetOrdered(index, index + 1);
+        }
+    }
+
+private:
+    // Returns false if stopped while waiting.
+    bool sleepUntil(const QElapsedTimer &timer, qint64 nsecs)
+    {
+        QMutexLocker locker(&m_mutex);
+        for (;;) {
+            if (m_stop.load())
+                return false;
+            const qint64 remaining = nsecs - timer.nsecsElapsed();
+            if (remaining <= 0 || m_source->m_seeked.load())
+                return true;
+            m_condition.wait(&m_mutex, ulong(qMax<qint64>(1, remaining / 1000000)));
+        }
+    }
+
+    DSReplayFrameSource *m_source;
+    DSFrameProcessor *m_processor;
+    QAtomicInt m_stop;
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+};
+
+DSReplayFrameSource::DSReplayFrameSource(const QString &basePath)
+    : m_basePath(basePath)
+    , m_pool(0)
+    , m_pacing(RealTime)
+    , m_looping(false)
+    , m_position(0)
+    , m_seeked(0)
+    , m_thread(0)
+    , m_delivered(0)
+    , m_dropped(0)
+{
+}
+
+DSReplayFrameSource::~DSReplayFrameSource()
+{
+    stop();
+    close();
+}
+
+bool DSReplayFrameSource::open()
+{
+    if (m_pool)
+        return true;
+
+    DSReplayFramePool *pool = new DSReplayFramePool;
+    QVector<Frame> frames;
+    DSFrameFormat format;
+
+    for (int segment = 0; QFile::exists(DSRecordFormat::segmentPath(m_basePath, segment)); ++segment) {
+        QFile *data = new QFile(DSRecordFormat::segmentPath(m_basePath, segment));
+        pool->files.append(data);
+
+        QFile index(DSRecordFormat::indexPath(m_basePath, segment));
+        if (!data->open(QIODevice::ReadOnly) || !index.open(QIODevice::ReadOnly)) {
+            qWarning() << "DSReplayFrameSource: cannot open segment" << data->fileName();
+            break;
+        }
+
+        const qint64 size = data->size();
+        const quint8 *mapped = size >= qint64(sizeof(DSRecordFormat::Header)) ? data->map(0, size) : 0;
+        if (!mapped) {
+            qWarning() << "DSReplayFrameSource: cannot map" << data->fileName();
+            break;
+        }
+
+        DSRecordFormat::Header header;
+        memcpy(&header, mapped, sizeof(header));
+        if (!DSRecordFormat::isValid(header)) {
+            qWarning() << "DSReplayFrameSource: not a recording" << data->fileName();
+            break;
+        }
+        if (segment == 0)
+            format = DSRecordFormat::format(header);
+
+        // A recording cut short may have index entries for data that never
+        // made it to disk; stop at the first one.
+        const QByteArray entries = index.readAll();
+        const int count = entries.size() / int(sizeof(DSRecordFormat::IndexEntry));
+        for (int i = 0; i < count; ++i) {
+            DSRecordFormat::IndexEntry entry;
+            memcpy(&entry, entries.constData() + i * sizeof(entry), sizeof(entry));
+            if (entry.offset < header.headerSize || entry.length < 0 || entry.offset + entry.length > size)
+                break;
+
+            Frame frame;
+            frame.data = mapped + entry.offset;
+            frame.length = entry.length;
+            frame.time = entry.time;
+            frames.append(frame);
+        }
+    }
+
+    if (!format.isValid() || frames.isEmpty()) {
+        qWarning() << "DSReplayFrameSource: nothing to replay at" << m_basePath;
+        pool->release();
+        return false;
+    }
+
+    m_pool = pool;
+    m_frames = frames;
+    m_format = format;
+    return true;
+}
+
+void DSReplayFrameSource::close()
+{
+    if (!m_pool)
+        return;
+
+    // frames still out keep the mappings alive
+    m_pool->release();
+    m_pool = 0;
+    m_frames.clear();
+}
+
+DSFrameFormat DSReplayFrameSource::format() const
+{
+    return m_format;
+}
+
+void DSReplayFrameSource::seek(int frame)
+{
+    m_position.store(qBound(0, frame, m_frames.size()));
+    m_seeked.store(1);
+}
+
+void DSReplayFrameSource::seekToTime(qint64 time)
+{
+    // recorded times only ever go up
+    int first = 0;
+    int last = m_frames.size();
+    while (first < last) {
+        const int middle = (first + last) / 2;
+        if (m_frames.at(middle).time < time)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+    seek(first);
+}
+
+bool DSReplayFrameSource::start(DSFrameProcessor *processor)
+{
+    if (m_thread || !open())
+        return false;
+
+    m_delivered.store(0);
+    m_dropped.store(0);
+
+    processor->setFormat(m_format);
+    m_thread = new DSReplayThread(this, processor);
+    m_thread->start();
+    return true;
+}
+
+void DSReplayFrameSource::stop()
+{
+    if (!m_thread)
+        return;
+
+    m_thread->stop();
+    delete m_thread;
+    m_thread = 0;
+}
+
+bool DSReplayFrameSource::isActive() const
+{
+    return m_thread && !m_thread->isFinished();
+}
+
+bool DSReplayFrameSource::waitForFinished(unsigned long msecs)
+{
+    return !m_thread || m_thread->wait(msecs);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,143 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSREPLAYFRAMESOURCE_H
+#define DSREPLAYFRAMESOURCE_H
+
+#include <QtCore/qglobal.h>
+#include <QtCore/qatomic.h>
+#include <QtCore/qstring.h>
+#include <QtCore/qvector.h>
+
+#include <climits>
+
+#include "dsframesource.h"
+
+QT_BEGIN_NAMESPACE
+
+class DSReplayThread;
+class DSReplayFramePool;
+
+// Plays back a recording made by DSFrameRecorder.
+//
+// The segments are memory mapped and frames are handed to the processor
+// pointing straight into the mapping, so nothing is copied on the way in. A
+// mapping stays alive until the last frame referring to it is released.
+//
+// Frames are paced by their recorded times, or pushed as fast as possible.
+// Nothing is skipped in the latter mode unless the processor drops it, so pair
+// it with DSFrameProcessor::BlockWithTimeout for a lossless, deterministic run.
+class DSReplayFrameSource : public DSFrameSource
+{
+public:
+    enum Pacing {
+        RealTime,
+        AsFastAsPossible
+    };
+
+    // basePath as passed to DSFrameRecorder::start()
+    explicit DSReplayFrameSource(const QString &basePath);
+    ~DSReplayFrameSource();
+
+    // Maps the recording; called by start() if need be.
+    bool open();
+    bool isOpen() const { return m_pool != 0; }
+
+    DSFrameFormat format() const;
+    int frameCount() const { return m_frames.size(); }
+
+    void setPacing(Pacing pacing) { m_pacing = pacing; }
+    Pacing pacing() const { return m_pacing; }
+
+    // Start over at the first frame after the last one.
+    void setLooping(bool looping) { m_looping = looping; }
+    bool isLooping() const { return m_looping; }
+
+    // Next frame to deliver; may be called while playing.
+    void seek(int frame);
+    // Seeks to the first frame recorded at or after time.
+    void seekToTime(qint64 time);
+    int position() const { return m_position.load(); }
+
+    qint64 frameTime(int frame) const { return m_frames.at(frame).time; }
+
+    bool start(DSFrameProcessor *processor);
+    void stop();
+    bool isActive() const;
+
+    // Waits until the last frame has been delivered or msecs have passed.
+    bool waitForFinished(unsigned long msecs = ULONG_MAX);
+
+    int framesDelivered() const { return m_delivered.load(); }
+    int framesDropped() const { return m_dropped.load(); }
+
+private:
+    Q_DISABLE_COPY(DSReplayFrameSource)
+
+    struct Frame
+    {
+        const quint8 *data;
+        int length;
+        qint64 time;
+    };
+
+    void close();
+
+    QString m_basePath;
+    DSFrameFormat m_format;
+    QVector<Frame> m_frames;
+    DSReplayFramePool *m_pool;
+
+    Pacing m_pacing;
+    bool m_looping;
+    QAtomicInt m_position;
+    QAtomicInt m_seeked;
+
+    DSReplayThread *m_thread;
+    QAtomicInt m_delivered;
+    QAtomicInt m_dropped;
+
+    friend class DSReplayThread;
+};
+
+QT_END_NAMESPACE
+
+#endif
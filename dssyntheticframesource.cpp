@@ -0,0 +1,270 @@
+#include <QDebug>
+#include <QtCore/qthread.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qwaitcondition.h>
+#include <QtCore/qelapsedtimer.h>
+
+#include "dssyntheticframesource.h"
+#include "dsframeprocessor.h"
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+// Frames cycle through this many pattern phases, each one moving the bars an
+// eighth of a bar to the left.
+const int PatternCount = 8;
+const int BarCount = 8;
+
+// 75% color bars: white, yellow, cyan, green, magenta, red, blue, black
+const quint8 barColors[BarCount][3] = {
+    { 191, 191, 191 }, { 191, 191, 0 }, { 0, 191, 191 }, { 0, 191, 0 },
+    { 191, 0, 191 }, { 191, 0, 0 }, { 0, 0, 191 }, { 0, 0, 0 }
+};
+
+// RGB of the pixel at x, y in phase. The bottom quarter is a gray ramp so a
+// flipped image is easy to spot.
+void patternPixel(int x, int y, int phase, int width, int height, int *r, int *g, int *b)
+{
+    if (y >= height - height / 4) {
+        *r = *g = *b = x * 255 / qMax(1, width - 1);
+        return;
+    }
+
+    const int shifted = (x + phase * width / (BarCount * PatternCount)) % width;
+    const quint8 *color = barColors[shifted * BarCount / width];
+    *r = color[0];
+    *g = color[1];
+    *b = color[2];
+}
+
+// BT.601 limited range, as most cameras deliver it.
+inline quint8 rgbToY(int r, int g, int b) { return quint8(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16); }
+inline quint8 rgbToU(int r, int g, int b) { return quint8(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128); }
+inline quint8 rgbToV(int r, int g, int b) { return quint8(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128); }
+
+} // end namespace
+
+class DSSyntheticFrameThread : public QThread
+{
+public:
+    DSSyntheticFrameThread(DSSyntheticFrameSource *source, DSFrameProcessor *processor)
+        : m_source(source)
+        , m_processor(processor)
+        , m_stop(0)
+    {
+    }
+
+    void stop()
+    {
+        m_mutex.lock();
+        m_stop.store(1);
+        m_condition.wakeAll();
+        m_mutex.unlock();
+        wait();
+    }
+
+protected:
+    void run()
+    {
+        const qreal frameRate = m_source->m_frameRate;
+        const int frameCount = m_source->m_frameCount;
+        QElapsedTimer timer;
+        timer.start();
+
+        for (int i = 0; !m_stop.load() && (!frameCount || i < frameCount); ++i) {
+            qint64 time;
+            if (frameRate > 0) {
+                // pace against the start so rounding never adds up
+                time = qint64(i * 1e9 / frameRate);
+                if (!sleepUntil(timer, time))
+                    break;
+            } else {
+                time = timer.nsecsElapsed();
+            }
+
+            const QVector<quint8> &pattern = m_source->m_patterns.at(i % PatternCount);
+            DSFrameHandle frame = m_processor->acquireBuffer();
+            if (frame.isNull() || frame->capacity < pattern.size()) {
+                m_source->m_dropped.fetchAndAddRelaxed(1);
+                continue;
+            }
+
+            memcpy(frame->data, pattern.constData(), pattern.size());
+            frame->length = pattern.size();
+            frame->time = time;
+
+            if (m_processor->pushFrame(frame))
+                m_source->m_delivered.fetchAndAddRelaxed(1);
+            else
+                m_source->m_dropped.fetchAndAddRelaxed(1);
+        }
+    }
+
+private:
+    // Returns false if stopped while waiting.
+    bool sleepUntil(const QElapsedTimer &timer, qint64 nsecs)
+    {
+        QMutexLocker locker(&m_mutex);
+        for (;;) {
+            if (m_stop.load())
+                return false;
+            const qint64 remaining = nsecs - timer.nsecsElapsed();
+            if (remaining <= 0)
+                return true;
+            m_condition.wait(&m_mutex, ulong(qMax<qint64>(1, remaining / 1000000)));
+        }
+    }
+
+    DSSyntheticFrameSource *m_source;
+    DSFrameProcessor *m_processor;
+    QAtomicInt m_stop;
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+};
+
+DSSyntheticFrameSource::DSSyntheticFrameSource(DSFrameFormat::PixelFormat pixelFormat,
+                                               int width, int height, qreal frameRate)
+    : m_frameRate(frameRate)
+    , m_frameCount(0)
+    , m_thread(0)
+    , m_delivered(0)
+    , m_dropped(0)
+{
+    m_format.pixelFormat = pixelFormat;
+    m_format.width = width & ~1;
+    m_format.height = height & ~1;
+
+    switch (pixelFormat) {
+    case DSFrameFormat::YUY2:
+        m_format.stride = m_format.width * 2;
+        break;
+    case DSFrameFormat::BGR24:
+        m_format.stride = (m_format.width * 3 + 3) & ~3;
+        m_format.bottomUp = true;
+        break;
+    case DSFrameFormat::I420:
+    case DSFrameFormat::NV12:
+        m_format.stride = m_format.width;
+        break;
+    default:
+        qWarning() << "DSSyntheticFrameSource: unsupported pixel format" << pixelFormat;
+        m_format.pixelFormat = DSFrameFormat::Invalid;
+        break;
+    }
+    m_format.sampleSize = m_format.frameSize();
+}
+
+DSSyntheticFrameSource::~DSSyntheticFrameSource()
+{
+    stop();
+}
+
+DSFrameFormat DSSyntheticFrameSource::format() const
+{
+    return m_format;
+}
+
+void DSSyntheticFrameSource::setFrameRate(qreal frameRate)
+{
+    m_frameRate = qMax<qreal>(0, frameRate);
+}
+
+bool DSSyntheticFrameSource::start(DSFrameProcessor *processor)
+{
+    if (m_thread || !m_format.isValid())
+        return false;
+
+    if (m_patterns.isEmpty())
+        renderPatterns();
+
+    m_delivered.store(0);
+    m_dropped.store(0);
+
+    processor->setFormat(m_format);
+    m_thread = new DSSyntheticFrameThread(this, processor);
+    m_thread->start();
+    return true;
+}
+
+void DSSyntheticFrameSource::stop()
+{
+    if (!m_thread)
+        return;
+
+    m_thread->stop();
+    delete m_thread;
+    m_thread = 0;
+}
+
+bool DSSyntheticFrameSource::isActive() const
+{
+    return m_thread && !m_thread->isFinished();
+}
+
+bool DSSyntheticFrameSource::waitForFinished(unsigned long msecs)
+{
+    return !m_thread || m_thread->wait(msecs);
+}
+
+void DSSyntheticFrameSource::renderPatterns()
+{
+    const int width = m_format.width;
+    const int height = m_format.height;
+    const int stride = m_format.stride;
+
+    m_patterns.resize(PatternCount);
+    for (int phase = 0; phase < PatternCount; ++phase) {
+        QVector<quint8> &frame = m_patterns[phase];
+        frame.fill(0, m_format.frameSize());
+        quint8 *data = frame.data();
+        int r, g, b;
+
+        for (int y = 0; y < height; ++y) {
+            if (m_format.pixelFormat == DSFrameFormat::YUY2) {
+                quint8 *row = data + y * stride;
+                for (int x = 0; x < width; x += 2) {
+                    patternPixel(x, y, phase, width, height, &r, &g, &b);
+                    row[x * 2] = rgbToY(r, g, b);
+                    row[x * 2 + 1] = rgbToU(r, g, b);
+                    row[x * 2 + 3] = rgbToV(r, g, b);
+                    patternPixel(x + 1, y, phase, width, height, &r, &g, &b);
+                    row[x * 2 + 2] = rgbToY(r, g, b);
+                }
+            } else if (m_format.pixelFormat == DSFrameFormat::BGR24) {
+                quint8 *row = data + (height - 1 - y) * stride; // bottom-up
+                for (int x = 0; x < width; ++x) {
+                    patternPixel(x, y, phase, width, height, &r, &g, &b);
+                    row[x * 3] = quint8(b);
+                    row[x * 3 + 1] = quint8(g);
+                    row[x * 3 + 2] = quint8(r);
+                }
+            } else if (m_format.pixelFormat == DSFrameFormat::I420) {
+                quint8 *yRow = data + y * stride;
+                quint8 *uRow = data + height * stride + (y / 2) * (stride / 2);
+                quint8 *vRow = uRow + (height / 2) * (stride / 2);
+                for (int x = 0; x < width; ++x) {
+                    patternPixel(x, y, phase, width, height, &r, &g, &b);
+                    yRow[x] = rgbToY(r, g, b);
+                    if (!(x & 1) && !(y & 1)) {
+                        uRow[x / 2] = rgbToU(r, g, b);
+                        vRow[x / 2] = rgbToV(r, g, b);
+                    }
+                }
+            } else if (m_format.pixelFormat == DSFrameFormat::NV12) {
+                quint8 *yRow = data + y * stride;
+                quint8 *uvRow = data + height * stride + (y / 2) * stride;
+                for (int x = 0; x < width; ++x) {
+                    patternPixel(x, y, phase, width, height, &r, &g, &b);
+                    yRow[x] = rgbToY(r, g, b);
+                    if (!(x & 1) && !(y & 1)) {
+                        uvRow[x] = rgbToU(r, g, b);
+                        uvRow[x + 1] = rgbToV(r, g, b);
+                    }
+                }
+            }
+        }
+    }
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,110 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef DSSYNTHETICFRAMESOURCE_H
+#define DSSYNTHETICFRAMESOURCE_H
+
+#include <QtCore/qglobal.h>
+#include <QtCore/qatomic.h>
+#include <QtCore/qvector.h>
+
+#include <climits>
+
+#include "dsframesource.h"
+
+QT_BEGIN_NAMESPACE
+
+class DSSyntheticFrameThread;
+
+// Generates moving color bars in YUY2, RGB24 (bottom-up BGR, as a DIB), I420
+// or NV12 at a fixed rate, so the frame pipeline can be exercised and load
+// tested without a camera.
+//
+// The pattern frames are rendered once in start(); delivering a frame costs
+// what a capture callback costs, a buffer from the pool and one copy.
+class DSSyntheticFrameSource : public DSFrameSource
+{
+public:
+    // pixelFormat has to be YUY2, BGR24, I420 or NV12
+    DSSyntheticFrameSource(DSFrameFormat::PixelFormat pixelFormat, int width, int height,
+                           qreal frameRate = 30);
+    ~DSSyntheticFrameSource();
+
+    DSFrameFormat format() const;
+
+    // 0 delivers frames as fast as the processor takes them.
+    void setFrameRate(qreal frameRate);
+    qreal frameRate() const { return m_frameRate; }
+
+    // Stop after this many frames, 0 to go on until stop().
+    void setFrameCount(int frameCount) { m_frameCount = frameCount; }
+    int frameCount() const { return m_frameCount; }
+
+    bool start(DSFrameProcessor *processor);
+    void stop();
+    bool isActive() const;
+
+    // Waits until the frame count is reached or msecs have passed.
+    bool waitForFinished(unsigned long msecs = ULONG_MAX);
+
+    int framesDelivered() const { return m_delivered.load(); }
+    int framesDropped() const { return m_dropped.load(); }
+
+private:
+    Q_DISABLE_COPY(DSSyntheticFrameSource)
+
+    void renderPatterns();
+
+    DSFrameFormat m_format;
+    qreal m_frameRate;
+    int m_frameCount;
+    QVector<QVector<quint8> > m_patterns;
+
+    DSSyntheticFrameThread *m_thread;
+    QAtomicInt m_delivered;
+    QAtomicInt m_dropped;
+
+    friend class DSSyntheticFrameThread;
+};
+
+QT_END_NAMESPACE
+
+#endif
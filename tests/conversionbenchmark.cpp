@@ -0,0 +1,61 @@
+#include <QtCore/qcoreapplication.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qtextstream.h>
+
+#include "dsconversionbenchmark.h"
+
+QT_USE_NAMESPACE
+
+// Runs DSConversionBenchmark and prints its results.
+//
+//   dsconversionbenchmark [-t msecs] [-c cameras] [frame.jpg ...]
+//
+// -t sets how long each measurement runs, -c also times that many synthetic
+// cameras at once, and JPEG files, all of one size, are decoded by runJpeg().
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    DSConversionBenchmark benchmark;
+    int cameras = 0;
+    QList<QByteArray> frames;
+
+    QStringList arguments = app.arguments();
+    arguments.removeFirst();
+    while (!arguments.isEmpty()) {
+        const QString argument = arguments.takeFirst();
+        if ((argument == QLatin1String("-t") || argument == QLatin1String("-c")) && !arguments.isEmpty()) {
+            bool ok;
+            const int value = arguments.takeFirst().toInt(&ok);
+            if (!ok || value < 0) {
+                err << "invalid value for " << argument << endl;
+                return 1;
+            }
+            if (argument == QLatin1String("-t"))
+                benchmark.setMinimumTime(value);
+            else
+                cameras = value;
+        } else if (argument.startsWith(QLatin1Char('-'))) {
+            err << "usage: dsconversionbenchmark [-t msecs] [-c cameras] [frame.jpg ...]" << endl;
+            return 1;
+        } else {
+            QFile file(argument);
+            if (!file.open(QIODevice::ReadOnly)) {
+                err << "cannot read " << argument << endl;
+                return 1;
+            }
+            frames << file.readAll();
+        }
+    }
+
+    out << DSConversionBenchmark::toText(benchmark.run()) << flush;
+    if (!frames.isEmpty())
+        out << DSConversionBenchmark::toText(benchmark.runJpeg(frames)) << flush;
+    if (cameras > 0)
+        out << DSConversionBenchmark::toText(benchmark.runCameras(cameras)) << flush;
+
+    return 0;
+}
@@ -0,0 +1,8 @@
+// DSJpegDecoder as built against plain libjpeg, whichever libjpeg is
+// installed: libjpeg-turbo announces itself through LIBJPEG_TURBO_VERSION,
+// so hiding that before the decoder sees it selects the portable code.
+#include <stdio.h>
+#include <jpeglib.h>
+#undef LIBJPEG_TURBO_VERSION
+
+#include "dsjpegdecoder.cpp"
@@ -0,0 +1,345 @@
+#include <QtTest/QtTest>
+#include <QtCore/qfile.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qtemporarydir.h>
+#include <QtCore/qwaitcondition.h>
+
+#include "dscapabilitycache.h"
+
+QT_USE_NAMESPACE
+
+namespace {
+
+DSDeviceCapabilities capabilities(const char *device, const char *driver)
+{
+    DSDeviceCapabilities capabilities;
+    capabilities.device = device;
+    capabilities.driver = driver;
+    capabilities.description = QLatin1String("Camera");
+
+    DSDeviceFormat format;
+    format.pixelFormat = DSFrameFormat::YUY2;
+    format.width = 640;
+    format.height = 480;
+    format.frameRate = 10000000.0 / 333333;
+    capabilities.formats.append(format);
+    format.pixelFormat = DSFrameFormat::MJPG;
+    format.width = 1920;
+    format.height = 1080;
+    capabilities.formats.append(format);
+    return capabilities;
+}
+
+// Answers queries from a table instead of a device. While gated, query()
+// waits in the revalidation thread until open() is called.
+class MockProvider : public DSCapabilityProvider
+{
+public:
+    MockProvider()
+        : m_gated(false)
+        , m_waiting(false)
+    {
+    }
+
+    void setCapabilities(const DSDeviceCapabilities &capabilities)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_devices.insert(capabilities.device, capabilities);
+    }
+
+    void unplug(const QByteArray &device)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_devices.remove(device);
+    }
+
+    QList<QByteArray> queries() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_queries;
+    }
+
+    void close()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_gated = true;
+    }
+
+    bool waitUntilQueried()
+    {
+        QMutexLocker locker(&m_mutex);
+        while (!m_waiting) {
+            if (!m_condition.wait(&m_mutex, 5000))
+                return false;
+        }
+        return true;
+    }
+
+    void open()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_gated = false;
+        m_condition.wakeAll();
+    }
+
+    bool query(const QByteArray &device, DSDeviceCapabilities *capabilities)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_queries.append(device);
+        while (m_gated) {
+            m_waiting = true;
+            m_condition.wakeAll();
+            m_condition.wait(&m_mutex);
+        }
+        m_waiting = false;
+
+        if (!m_devices.contains(device))
+            return false;
+        *capabilities = m_devices.value(device);
+        return true;
+    }
+
+private:
+    mutable QMutex m_mutex;
+    QWaitCondition m_condition;
+    QMap<QByteArray, DSDeviceCapabilities> m_devices;
+    QList<QByteArray> m_queries;
+    bool m_gated;
+    bool m_waiting;
+};
+
+// Notes the devices capabilitiesChanged() names, on the thread it is emitted.
+class Receiver : public QObject
+{
+    Q_OBJECT
+public:
+    QList<QByteArray> changed() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_changed;
+    }
+
+public slots:
+    void capabilitiesChanged(const QByteArray &device)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_changed.append(device);
+    }
+
+private:
+    mutable QMutex m_mutex;
+    QList<QByteArray> m_changed;
+};
+
+bool writeFile(const QString &fileName, const QByteArray &data)
+{
+    QFile file(fileName);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+QByteArray readFile(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+
+} // end namespace
+
+// The cache file lives in a temporary directory; MockProvider stands in for
+// the walk over a capture pin's stream capabilities.
+class tst_DSCapabilityCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void lookupMatchesDeviceAndDriver();
+    void roundTripsThroughTheFile();
+    void rejectsCorruptFiles();
+    void revalidateSignalsRealChangesOnly();
+    void waitForRevalidation();
+
+private:
+    QTemporaryDir *m_dir;
+    QString m_fileName;
+};
+
+void tst_DSCapabilityCache::init()
+{
+    m_dir = new QTemporaryDir;
+    QVERIFY(m_dir->isValid());
+    m_fileName = m_dir->path() + QLatin1String("/capabilities.cache");
+}
+
+void tst_DSCapabilityCache::cleanup()
+{
+    delete m_dir;
+    m_dir = 0;
+}
+
+void tst_DSCapabilityCache::lookupMatchesDeviceAndDriver()
+{
+    DSCapabilityCache cache(m_fileName);
+    QVERIFY(cache.devices().isEmpty());
+
+    const DSDeviceCapabilities stored = capabilities("usb#vid_046d&pid_0825", "10.0.1");
+    cache.store(stored);
+
+    DSDeviceCapabilities found;
+    QVERIFY(cache.lookup(stored.device, stored.driver, &found));
+    QVERIFY(found == stored);
+
+    // another driver, or another device with the same driver, is a miss
+    QVERIFY(!cache.lookup(stored.device, "10.0.2", &found));
+    QVERIFY(!cache.lookup("usb#vid_046d&pid_0826", stored.driver, &found));
+
+    cache.remove(stored.device);
+    QVERIFY(!cache.lookup(stored.device, stored.driver, &found));
+    QVERIFY(cache.devices().isEmpty());
+}
+
+void tst_DSCapabilityCache::roundTripsThroughTheFile()
+{
+    const DSDeviceCapabilities first = capabilities("usb#first", "1.0");
+    DSDeviceCapabilities second = capabilities("usb#second", "2.0");
+    second.description = QLatin1String("Second camera");
+    second.formats.removeFirst();
+    {
+        DSCapabilityCache cache(m_fileName);
+        cache.store(first);
+        cache.store(second);
+    }
+
+    // loaded by the constructor, frame rates and all
+    DSCapabilityCache cache(m_fileName);
+    QCOMPARE(cache.devices().size(), 2);
+    DSDeviceCapabilities found;
+    QVERIFY(cache.lookup(first.device, first.driver, &found));
+    QVERIFY(found == first);
+    QVERIFY(cache.lookup(second.device, second.driver, &found));
+    QVERIFY(found == second);
+
+    cache.remove(first.device);
+    QVERIFY(cache.load());
+    QCOMPARE(cache.devices().size(), 1);
+}
+
+void tst_DSCapabilityCache::rejectsCorruptFiles()
+{
+    {
+        DSCapabilityCache cache(m_fileName);
+        cache.store(capabilities("usb#first", "1.0"));
+        cache.store(capabilities("usb#second", "2.0"));
+    }
+    const QByteArray data = readFile(m_fileName);
+    QVERIFY(data.size() > 16);
+
+    // cut off in the middle of the formats, or of the header
+    const int lengths[] = { data.size() - 4, data.size() / 2, 6 };
+    for (int i = 0; i < int(sizeof(lengths) / sizeof(lengths[0])); ++i) {
+        QVERIFY(writeFile(m_fileName, QByteArray(data.constData(), lengths[i])));
+        DSCapabilityCache cache(m_fileName);
+        QVERIFY(!cache.load());
+        QVERIFY(cache.devices().isEmpty());
+    }
+
+    // not a cache at all
+    QVERIFY(writeFile(m_fileName, QByteArray("not a capability cache")));
+    DSCapabilityCache cache(m_fileName);
+    QVERIFY(!cache.load());
+    QVERIFY(cache.devices().isEmpty());
+
+    // a good file replaces what is in memory, a bad one leaves it alone
+    QVERIFY(writeFile(m_fileName, data));
+    QVERIFY(cache.load());
+    QCOMPARE(cache.devices().size(), 2);
+    QVERIFY(writeFile(m_fileName, QByteArray(data.constData(), data.size() / 2)));
+    QVERIFY(!cache.load());
+    QCOMPARE(cache.devices().size(), 2);
+}
+
+void tst_DSCapabilityCache::revalidateSignalsRealChangesOnly()
+{
+    const DSDeviceCapabilities stored = capabilities("usb#camera", "1.0");
+    DSCapabilityCache cache(m_fileName);
+    cache.store(stored);
+    Receiver receiver;
+    QObject::connect(&cache, SIGNAL(capabilitiesChanged(QByteArray)),
+                     &receiver, SLOT(capabilitiesChanged(QByteArray)), Qt::DirectConnection);
+
+    // the same again
+    MockProvider provider;
+    provider.setCapabilities(stored);
+    cache.revalidate(stored.device, &provider);
+    QVERIFY(cache.waitForRevalidation(5000));
+    QCOMPARE(provider.queries().size(), 1);
+    QVERIFY(receiver.changed().isEmpty());
+
+    // gone, which leaves the entry as it is
+    provider.unplug(stored.device);
+    cache.revalidate(stored.device, &provider);
+    QVERIFY(cache.waitForRevalidation(5000));
+    QCOMPARE(provider.queries().size(), 2);
+    QVERIFY(receiver.changed().isEmpty());
+
+    // a firmware update behind the same driver
+    DSDeviceCapabilities updated = stored;
+    updated.formats[1].frameRate = 60;
+    provider.setCapabilities(updated);
+    cache.revalidate(stored.device, &provider);
+    QVERIFY(cache.waitForRevalidation(5000));
+    QCOMPARE(receiver.changed(), QList<QByteArray>() << stored.device);
+
+    DSDeviceCapabilities found;
+    QVERIFY(cache.lookup(stored.device, stored.driver, &found));
+    QVERIFY(found == updated);
+    DSCapabilityCache reloaded(m_fileName);
+    QVERIFY(reloaded.lookup(stored.device, stored.driver, &found));
+    QVERIFY(found == updated);
+
+    // a new driver found on the walk replaces the entry
+    updated.driver = "2.0";
+    provider.setCapabilities(updated);
+    cache.revalidate(stored.device, &provider);
+    QVERIFY(cache.waitForRevalidation(5000));
+    QCOMPARE(receiver.changed().size(), 2);
+    QVERIFY(!cache.lookup(stored.device, stored.driver, &found));
+    QVERIFY(cache.lookup(stored.device, updated.driver, &found));
+}
+
+void tst_DSCapabilityCache::waitForRevalidation()
+{
+    DSCapabilityCache cache(m_fileName);
+    QVERIFY(cache.waitForRevalidation(0));
+
+    MockProvider provider;
+    provider.setCapabilities(capabilities("usb#first", "1.0"));
+    provider.setCapabilities(capabilities("usb#second", "1.0"));
+
+    // keep the thread in the first query while more requests come in
+    provider.close();
+    cache.revalidate("usb#first", &provider);
+    QVERIFY(provider.waitUntilQueried());
+    cache.revalidate("usb#second", &provider);
+    cache.revalidate("usb#second", &provider);
+    QVERIFY(!cache.waitForRevalidation(50));
+
+    provider.open();
+    QVERIFY(cache.waitForRevalidation(5000));
+    QCOMPARE(provider.queries(), QList<QByteArray>() << "usb#first" << "usb#second");
+    QCOMPARE(cache.devices().size(), 2);
+
+    // and the thread starts again for the next one
+    provider.setCapabilities(capabilities("usb#third", "1.0"));
+    cache.revalidate("usb#third", &provider);
+    QVERIFY(cache.waitForRevalidation(5000));
+    QCOMPARE(cache.devices().size(), 3);
+}
+
+QTEST_GUILESS_MAIN(tst_DSCapabilityCache)
+
+#include "tst_dscapabilitycache.moc"
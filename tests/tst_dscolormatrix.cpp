@@ -0,0 +1,103 @@
+#include <QtTest/QtTest>
+
+#include <math.h>
+
+#include "dsframeconverter.h"
+
+QT_USE_NAMESPACE
+
+namespace {
+
+int clampRound(double value)
+{
+    const int rounded = int(floor(value + 0.5));
+    return rounded < 0 ? 0 : rounded > 255 ? 255 : rounded;
+}
+
+// Y, U and V to R, G and B in doubles, straight from the definition of the
+// standard: Kr and Kb give the luma weights, limited range scales Y from
+// 16..235 and chroma from 16..240 onto the full range.
+void reference(DSColorMatrix::Standard standard, DSColorMatrix::Range range,
+               int y, int u, int v, int *rgb)
+{
+    const double kr = standard == DSColorMatrix::BT709 ? 0.2126 : 0.299;
+    const double kb = standard == DSColorMatrix::BT709 ? 0.0722 : 0.114;
+    const double kg = 1.0 - kr - kb;
+    const bool limited = range == DSColorMatrix::LimitedRange;
+
+    const double luma = limited ? (y - 16) * 255.0 / 219.0 : y;
+    const double cb = (u - 128) * (limited ? 255.0 / 224.0 : 1.0);
+    const double cr = (v - 128) * (limited ? 255.0 / 224.0 : 1.0);
+
+    rgb[0] = clampRound(luma + 2 * (1 - kr) * cr);
+    rgb[1] = clampRound(luma - 2 * (1 - kb) * kb / kg * cb - 2 * (1 - kr) * kr / kg * cr);
+    rgb[2] = clampRound(luma + 2 * (1 - kb) * cb);
+}
+
+} // end namespace
+
+// The fixed point matrices against a double precision reference, over every
+// possible Y, U and V.
+class tst_DSColorMatrix : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void matchesDoubleReference();
+};
+
+void tst_DSColorMatrix::matchesDoubleReference()
+{
+    // one YUY2 row holding every combination: for each U and V all 256 Y
+    // values, two per macropixel
+    QVector<quint8> src(256 * 256 * 256 * 2);
+    quint8 *p = src.data();
+    for (int u = 0; u < 256; ++u) {
+        for (int v = 0; v < 256; ++v) {
+            for (int y = 0; y < 256; y += 2) {
+                *p++ = quint8(y);
+                *p++ = quint8(u);
+                *p++ = quint8(y + 1);
+                *p++ = quint8(v);
+            }
+        }
+    }
+    const int width = src.size() / 2;
+    QVector<quint8> scalar(width * 3);
+    QVector<quint8> dispatched(width * 3);
+
+    for (int s = DSColorMatrix::BT601; s <= DSColorMatrix::BT709; ++s) {
+        for (int r = DSColorMatrix::LimitedRange; r <= DSColorMatrix::FullRange; ++r) {
+            const DSColorMatrix::Standard standard = DSColorMatrix::Standard(s);
+            const DSColorMatrix::Range range = DSColorMatrix::Range(r);
+            const DSColorMatrix &matrix = DSColorMatrix::matrix(standard, range);
+
+            DSFrameConverter::yuy2ToRgb24Scalar(src.constData(), 0, scalar.data(), 0, width, 1, matrix);
+            DSFrameConverter::yuy2ToRgb24(src.constData(), 0, dispatched.data(), 0, width, 1, matrix);
+
+            // the same in every build, whichever kernel runs
+            QVERIFY(dispatched == scalar);
+
+            // and never more than one off the exact result
+            const quint8 *out = scalar.constData();
+            int rgb[3];
+            for (int u = 0; u < 256; ++u) {
+                for (int v = 0; v < 256; ++v) {
+                    for (int y = 0; y < 256; ++y, out += 3) {
+                        reference(standard, range, y, u, v, rgb);
+                        for (int c = 0; c < 3; ++c) {
+                            if (qAbs(rgb[c] - out[c]) > 1) {
+                                QFAIL(qPrintable(QString::fromLatin1("standard %1 range %2 YUV %3 %4 %5")
+                                                 .arg(s).arg(r).arg(y).arg(u).arg(v)));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+QTEST_APPLESS_MAIN(tst_DSColorMatrix)
+
+#include "tst_dscolormatrix.moc"
@@ -0,0 +1,247 @@
+#include <QtTest/QtTest>
+
+#include "dsformatnegotiator.h"
+
+QT_USE_NAMESPACE
+
+namespace {
+
+DSDeviceFormat deviceFormat(DSFrameFormat::PixelFormat pixelFormat, int width, int height,
+                            qreal frameRate)
+{
+    DSDeviceFormat format;
+    format.pixelFormat = pixelFormat;
+    format.width = width;
+    format.height = height;
+    format.frameRate = frameRate;
+    return format;
+}
+
+DSFormatRequest request(int width, int height, qreal frameRate,
+                        DSFrameProcessor::OutputFormat output = DSFrameProcessor::RgbOutput)
+{
+    DSFormatRequest request;
+    request.size = QSize(width, height);
+    request.frameRate = frameRate;
+    request.outputFormat = output;
+    return request;
+}
+
+DSBenchmarkResult result(const char *conversion, const char *variant, int threads,
+                         double nsPerPixel)
+{
+    DSBenchmarkResult result;
+    result.conversion = QLatin1String(conversion);
+    result.variant = QLatin1String(variant);
+    result.size = QSize(640, 480);
+    result.threads = threads;
+    result.nsPerPixel = nsPerPixel;
+    result.megabytesPerSecond = 0;
+    result.speedup = 0;
+    return result;
+}
+
+QList<DSFrameFormat::PixelFormat> pixelFormats(const QList<DSFormatCandidate> &candidates)
+{
+    QList<DSFrameFormat::PixelFormat> formats;
+    foreach (const DSFormatCandidate &candidate, candidates)
+        formats.append(candidate.format.pixelFormat);
+    return formats;
+}
+
+} // end namespace
+
+// Ranking of device formats against a request, with the default USB 2 bus
+// of 24.576 MB/s and MJPG frames of 0.25 bytes per pixel unless set.
+class tst_DSFormatNegotiator : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void usb2CarriesMjpgButNotYuy2At1080p30();
+    void fastBusPrefersYuy2At1080p30();
+    void meetingTheTargetComesFirstCheapestFirst();
+    void otherwiseFastestFirst();
+    void noCandidates();
+    void conversionCostsFromBenchmark();
+};
+
+void tst_DSFormatNegotiator::usb2CarriesMjpgButNotYuy2At1080p30()
+{
+    QList<DSDeviceFormat> formats;
+    formats << deviceFormat(DSFrameFormat::YUY2, 1920, 1080, 30)
+            << deviceFormat(DSFrameFormat::MJPG, 1920, 1080, 30);
+
+    DSFormatNegotiator negotiator;
+    const QList<DSFormatCandidate> candidates = negotiator.rank(formats, request(1920, 1080, 30));
+    QCOMPARE(candidates.size(), 2);
+
+    // 4 MB a frame fits through the bus not quite 6 times a second
+    const DSFormatCandidate &mjpg = candidates.at(0);
+    const DSFormatCandidate &yuy2 = candidates.at(1);
+    QCOMPARE(mjpg.format.pixelFormat, DSFrameFormat::MJPG);
+    QVERIFY(mjpg.meetsTarget);
+    QCOMPARE(mjpg.frameRate, qreal(30));
+    QVERIFY(qFuzzyCompare(mjpg.busBytesPerSecond, 1920 * 1080 * 0.25 * 30));
+    QCOMPARE(yuy2.format.pixelFormat, DSFrameFormat::YUY2);
+    QVERIFY(!yuy2.meetsTarget);
+    QVERIFY(qFuzzyCompare(yuy2.frameRate, qreal(3072.0 * 8000 / (1920 * 1080 * 2))));
+    QVERIFY(qFuzzyCompare(yuy2.busLoad, 1.0));
+
+    DSDeviceFormat chosen;
+    QVERIFY(negotiator.negotiate(formats, request(1920, 1080, 30), &chosen));
+    QVERIFY(chosen == formats.at(1));
+
+    // an advertised rate just below the request does not meet it
+    formats[1].frameRate = 10000000.0 / 333667;
+    QVERIFY(!negotiator.negotiate(formats, request(1920, 1080, 30), &chosen));
+    QVERIFY(chosen == formats.at(1));
+}
+
+void tst_DSFormatNegotiator::fastBusPrefersYuy2At1080p30()
+{
+    QList<DSDeviceFormat> formats;
+    formats << deviceFormat(DSFrameFormat::MJPG, 1920, 1080, 30)
+            << deviceFormat(DSFrameFormat::YUY2, 1920, 1080, 30);
+
+    // USB 3: YUY2 costs a third of the bus, MJPG a third of a core to decode
+    DSFormatNegotiator negotiator;
+    negotiator.setBusBandwidth(400e6);
+    const QList<DSFormatCandidate> candidates = negotiator.rank(formats, request(1920, 1080, 30));
+    QCOMPARE(candidates.size(), 2);
+    QCOMPARE(candidates.at(0).format.pixelFormat, DSFrameFormat::YUY2);
+    QVERIFY(candidates.at(0).meetsTarget);
+    QVERIFY(candidates.at(1).meetsTarget);
+    QVERIFY(candidates.at(0).busLoad + candidates.at(0).cpuLoad
+            < candidates.at(1).busLoad + candidates.at(1).cpuLoad);
+}
+
+void tst_DSFormatNegotiator::meetingTheTargetComesFirstCheapestFirst()
+{
+    QList<DSDeviceFormat> formats;
+    formats << deviceFormat(DSFrameFormat::BGR24, 640, 480, 30)    // 26.7 fps on the bus
+            << deviceFormat(DSFrameFormat::YUY2, 640, 480, 30)
+            << deviceFormat(DSFrameFormat::YUY2, 1280, 720, 30)    // other size
+            << deviceFormat(DSFrameFormat::NV12, 640, 480, 15)
+            << deviceFormat(DSFrameFormat::MJPG, 640, 480, 30)
+            << deviceFormat(DSFrameFormat::I420, 640, 480, 30);
+
+    DSFormatNegotiator negotiator;
+    const QList<DSFormatCandidate> candidates = negotiator.rank(formats, request(640, 480, 30));
+
+    QList<DSFrameFormat::PixelFormat> expected;
+    expected << DSFrameFormat::MJPG << DSFrameFormat::I420 << DSFrameFormat::YUY2
+             << DSFrameFormat::BGR24 << DSFrameFormat::NV12;
+    QCOMPARE(pixelFormats(candidates), expected);
+
+    for (int i = 0; i < candidates.size(); ++i)
+        QCOMPARE(candidates.at(i).meetsTarget, i < 3);
+    for (int i = 1; i < 3; ++i) {
+        QVERIFY(candidates.at(i - 1).busLoad + candidates.at(i - 1).cpuLoad
+                < candidates.at(i).busLoad + candidates.at(i).cpuLoad);
+    }
+    QVERIFY(qFuzzyCompare(candidates.at(3).frameRate, qreal(3072.0 * 8000 / (640 * 480 * 3))));
+    QCOMPARE(candidates.at(4).frameRate, qreal(15));
+
+    // costs are those of the requested rate, not of the advertised one
+    formats[4].frameRate = 60;
+    const QList<DSFormatCandidate> faster = negotiator.rank(formats, request(640, 480, 30));
+    QCOMPARE(faster.at(0).format.pixelFormat, DSFrameFormat::MJPG);
+    QCOMPARE(faster.at(0).frameRate, qreal(60));
+    QVERIFY(qFuzzyCompare(faster.at(0).busBytesPerSecond, candidates.at(0).busBytesPerSecond));
+
+    // any size, any rate
+    QCOMPARE(negotiator.rank(formats, DSFormatRequest()).size(), formats.size());
+}
+
+void tst_DSFormatNegotiator::otherwiseFastestFirst()
+{
+    QList<DSDeviceFormat> formats;
+    formats << deviceFormat(DSFrameFormat::YUY2, 1920, 1080, 30)  // 5.9 fps on the bus
+            << deviceFormat(DSFrameFormat::NV12, 1920, 1080, 60)  // 7.9 fps on the bus
+            << deviceFormat(DSFrameFormat::MJPG, 1920, 1080, 30);
+
+    DSFormatNegotiator negotiator;
+    const QList<DSFormatCandidate> candidates = negotiator.rank(formats, request(1920, 1080, 60));
+
+    QList<DSFrameFormat::PixelFormat> expected;
+    expected << DSFrameFormat::MJPG << DSFrameFormat::NV12 << DSFrameFormat::YUY2;
+    QCOMPARE(pixelFormats(candidates), expected);
+    foreach (const DSFormatCandidate &candidate, candidates)
+        QVERIFY(!candidate.meetsTarget);
+
+    // the best there is, but not what was asked for
+    DSDeviceFormat chosen;
+    QVERIFY(!negotiator.negotiate(formats, request(1920, 1080, 60), &chosen));
+    QVERIFY(chosen == formats.at(2));
+}
+
+void tst_DSFormatNegotiator::noCandidates()
+{
+    DSFormatNegotiator negotiator;
+    const DSDeviceFormat untouched = deviceFormat(DSFrameFormat::YUY2, 320, 240, 30);
+    DSDeviceFormat chosen = untouched;
+
+    QList<DSDeviceFormat> formats;
+    QVERIFY(negotiator.rank(formats, request(640, 480, 30)).isEmpty());
+    QVERIFY(!negotiator.negotiate(formats, request(640, 480, 30), &chosen));
+    QVERIFY(chosen == untouched);
+
+    // nothing of the size, and formats that say nothing about their frames
+    formats << deviceFormat(DSFrameFormat::YUY2, 1280, 720, 30)
+            << deviceFormat(DSFrameFormat::Invalid, 640, 480, 30);
+    QVERIFY(negotiator.rank(formats, request(640, 480, 30)).isEmpty());
+    QVERIFY(!negotiator.negotiate(formats, request(640, 480, 30), &chosen));
+    QVERIFY(chosen == untouched);
+}
+
+void tst_DSFormatNegotiator::conversionCostsFromBenchmark()
+{
+    QList<DSBenchmarkResult> results;
+    results << result("YUY2 -> RGB24", "SSE2 x1", 1, 2.0)
+            << result("YUY2 -> RGB24", "SSE2 x1", 1, 4.0)
+            << result("YUY2 -> RGB24", "legacy", 1, 50.0)
+            << result("YUY2 -> RGB24", "C", 1, 9.0)
+            << result("YUY2 -> RGB24", "SSE2 x4", 4, 0.5)
+            << result("YUY2 -> RGB24+1/2", "SSE2 x1", 1, 7.0)
+            << result("YUY2 -> GREY", "SSE2 x1", 1, 0.25)
+            << result("YUY2 -> BGR24", "SSE2 x1", 1, 8.0)
+            << result("Y800 -> RGB24", "SSE2 x1", 1, 8.0)
+            << result("I420 -> RGB24", "AVX2 x1", 1, 1.5)
+            << result("RGB24 -> RGB24", "AVX2 x1", 1, 0.7)
+            << result("MJPG -> RGB24", "1/1", 1, 12.0)
+            << result("MJPG -> RGB24", "1/2", 1, 4.0);
+
+    DSFormatNegotiator negotiator;
+    const double i420Planar = negotiator.conversionCost(DSFrameFormat::I420,
+                                                        DSFrameProcessor::PlanarYuvOutput);
+    const double nv12 = negotiator.conversionCost(DSFrameFormat::NV12, DSFrameProcessor::RgbOutput);
+    negotiator.setConversionCosts(results);
+
+    // single threaded dispatched kernels, averaged over sizes
+    QCOMPARE(negotiator.conversionCost(DSFrameFormat::YUY2, DSFrameProcessor::RgbOutput), 3.0);
+    QCOMPARE(negotiator.conversionCost(DSFrameFormat::YUY2, DSFrameProcessor::PlanarYuvOutput), 3.0);
+    QCOMPARE(negotiator.conversionCost(DSFrameFormat::YUY2, DSFrameProcessor::LumaOutput), 0.25);
+
+    // planar formats are handed out as they come
+    QCOMPARE(negotiator.conversionCost(DSFrameFormat::I420, DSFrameProcessor::RgbOutput), 1.5);
+    QCOMPARE(negotiator.conversionCost(DSFrameFormat::I420, DSFrameProcessor::PlanarYuvOutput),
+             i420Planar);
+
+    // RGB formats cost the same for every output
+    QCOMPARE(negotiator.conversionCost(DSFrameFormat::BGR24, DSFrameProcessor::RgbOutput), 0.7);
+    QCOMPARE(negotiator.conversionCost(DSFrameFormat::BGR24, DSFrameProcessor::LumaOutput), 0.7);
+
+    // grey decoding keeps its share of the full size decode
+    QCOMPARE(negotiator.conversionCost(DSFrameFormat::MJPG, DSFrameProcessor::RgbOutput), 12.0);
+    QVERIFY(qFuzzyCompare(negotiator.conversionCost(DSFrameFormat::MJPG, DSFrameProcessor::LumaOutput),
+                          12.0 * 4.0 / 6.0));
+
+    // not measured, left alone
+    QCOMPARE(negotiator.conversionCost(DSFrameFormat::NV12, DSFrameProcessor::RgbOutput), nv12);
+    QCOMPARE(negotiator.conversionCost(DSFrameFormat::Invalid, DSFrameProcessor::RgbOutput), 0.0);
+}
+
+QTEST_APPLESS_MAIN(tst_DSFormatNegotiator)
+
+#include "tst_dsformatnegotiator.moc"
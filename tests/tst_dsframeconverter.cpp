@@ -0,0 +1,310 @@
+#include <QtTest/QtTest>
+
+#include "dsframeconverter.h"
+
+QT_USE_NAMESPACE
+
+namespace {
+
+// Widths around the 16 and 32 pixel steps of the SIMD loops, so every tail
+// length is covered, and a couple of real frame widths.
+const int widths[] = { 2, 4, 14, 16, 18, 30, 32, 34, 46, 62, 64, 66, 640, 1938 };
+const int height = 5;
+const int guard = 64;
+
+QVector<quint8> noise(int size, uint seed)
+{
+    QVector<quint8> data(size);
+    for (int i = 0; i < size; ++i) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = quint8(seed >> 16);
+    }
+    return data;
+}
+
+// Output buffer with guard bytes behind the image, which no kernel may touch.
+QVector<quint8> output(int size)
+{
+    QVector<quint8> data;
+    data.fill(0xee, size + guard);
+    return data;
+}
+
+bool guardIntact(const QVector<quint8> &data)
+{
+    for (int i = data.size() - guard; i < data.size(); ++i) {
+        if (data.at(i) != 0xee)
+            return false;
+    }
+    return true;
+}
+
+// The bytes between the end of each row and the next, where rows are padded.
+bool paddingIntact(const QVector<quint8> &data, int rowSize, int stride, int rows)
+{
+    for (int y = 0; y < rows; ++y) {
+        for (int i = rowSize; i < stride; ++i) {
+            if (data.at(y * stride + i) != 0xee)
+                return false;
+        }
+    }
+    return true;
+}
+
+inline quint8 expand5(int c)
+{
+    return quint8((c << 3) | (c >> 2));
+}
+
+const DSColorMatrix &matrixAt(int index)
+{
+    return DSColorMatrix::matrix(DSColorMatrix::Standard(index / 2), DSColorMatrix::Range(index % 2));
+}
+
+} // end namespace
+
+// The dispatching kernels against their plain C++ references, which are what
+// the SIMD paths have to reproduce byte for byte. Every test runs once for
+// each instruction set, those the machine lacks are skipped.
+class tst_DSFrameConverter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase_data();
+    void init();
+    void cleanup();
+
+    void yuy2MatchesScalar();
+    void yuy2FlipsWithNegativeStride();
+    void uyvyMatchesScalar();
+    void i420MatchesScalar();
+    void nv12MatchesScalar();
+    void bgr24FlipsAndSwapsInOnePass();
+    void bgr32MatchesReference();
+    void rgb555MatchesReference();
+};
+
+void tst_DSFrameConverter::initTestCase_data()
+{
+    QTest::addColumn<QByteArray>("instructionSet");
+    QTest::newRow("AVX2") << QByteArray("AVX2");
+    QTest::newRow("SSE2") << QByteArray("SSE2");
+    QTest::newRow("C") << QByteArray("C");
+}
+
+void tst_DSFrameConverter::init()
+{
+    QFETCH_GLOBAL(QByteArray, instructionSet);
+    if (!DSFrameConverter::setInstructionSet(instructionSet.constData()))
+        QSKIP("not supported on this machine");
+    QCOMPARE(DSFrameConverter::instructionSet(), instructionSet.constData());
+}
+
+void tst_DSFrameConverter::cleanup()
+{
+    DSFrameConverter::setInstructionSet(0);
+}
+
+void tst_DSFrameConverter::yuy2MatchesScalar()
+{
+    for (int w = 0; w < int(sizeof(widths) / sizeof(widths[0])); ++w) {
+        const int width = widths[w];
+        const QVector<quint8> src = noise(width * 2 * height, width);
+
+        for (int m = 0; m < 4; ++m) {
+            for (int bgr = 0; bgr < 2; ++bgr) {
+                QVector<quint8> expected = output(width * 3 * height);
+                QVector<quint8> actual = output(width * 3 * height);
+                DSFrameConverter::yuy2ToRgb24Scalar(src.constData(), width * 2, expected.data(), width * 3,
+                                                    width, height, matrixAt(m), bgr);
+                DSFrameConverter::yuy2ToRgb24(src.constData(), width * 2, actual.data(), width * 3,
+                                              width, height, matrixAt(m), bgr);
+                QVERIFY2(actual == expected, qPrintable(QString::fromLatin1("width %1").arg(width)));
+                QVERIFY(guardIntact(actual));
+            }
+        }
+    }
+}
+
+void tst_DSFrameConverter::yuy2FlipsWithNegativeStride()
+{
+    const DSColorMatrix &matrix = matrixAt(0);
+    for (int w = 0; w < int(sizeof(widths) / sizeof(widths[0])); ++w) {
+        const int width = widths[w];
+        const int rowSize = width * 3;
+        const QVector<quint8> src = noise(width * 2 * height, width);
+
+        QVector<quint8> expected = output(rowSize * height);
+        QVector<quint8> flipped = output(rowSize * height);
+        DSFrameConverter::yuy2ToRgb24Scalar(src.constData(), width * 2, expected.data(), rowSize,
+                                            width, height, matrix);
+        DSFrameConverter::yuy2ToRgb24(src.constData() + (height - 1) * width * 2, -width * 2,
+                                      flipped.data(), rowSize, width, height, matrix);
+
+        for (int y = 0; y < height; ++y) {
+            QVERIFY(!memcmp(flipped.constData() + y * rowSize,
+                            expected.constData() + (height - 1 - y) * rowSize, rowSize));
+        }
+        QVERIFY(guardIntact(flipped));
+    }
+}
+
+void tst_DSFrameConverter::uyvyMatchesScalar()
+{
+    for (int w = 0; w < int(sizeof(widths) / sizeof(widths[0])); ++w) {
+        const int width = widths[w];
+        const QVector<quint8> src = noise(width * 2 * height, width);
+
+        for (int m = 0; m < 4; ++m) {
+            for (int bgr = 0; bgr < 2; ++bgr) {
+                QVector<quint8> expected = output(width * 3 * height);
+                QVector<quint8> actual = output(width * 3 * height);
+                DSFrameConverter::uyvyToRgb24Scalar(src.constData(), width * 2, expected.data(), width * 3,
+                                                    width, height, matrixAt(m), bgr);
+                DSFrameConverter::uyvyToRgb24(src.constData(), width * 2, actual.data(), width * 3,
+                                              width, height, matrixAt(m), bgr);
+                QVERIFY2(actual == expected, qPrintable(QString::fromLatin1("width %1").arg(width)));
+                QVERIFY(guardIntact(actual));
+            }
+        }
+    }
+}
+
+void tst_DSFrameConverter::i420MatchesScalar()
+{
+    const int planarHeight = height + 1;
+    for (int w = 0; w < int(sizeof(widths) / sizeof(widths[0])); ++w) {
+        const int width = widths[w];
+        const QVector<quint8> y = noise(width * planarHeight, width);
+        const QVector<quint8> u = noise(width / 2 * planarHeight / 2, width + 1);
+        const QVector<quint8> v = noise(width / 2 * planarHeight / 2, width + 2);
+
+        for (int m = 0; m < 4; ++m) {
+            QVector<quint8> expected = output(width * 3 * planarHeight);
+            QVector<quint8> actual = output(width * 3 * planarHeight);
+            DSFrameConverter::i420ToRgb24Scalar(y.constData(), width, u.constData(), v.constData(), width / 2,
+                                                expected.data(), width * 3, width, planarHeight, matrixAt(m));
+            DSFrameConverter::i420ToRgb24(y.constData(), width, u.constData(), v.constData(), width / 2,
+                                          actual.data(), width * 3, width, planarHeight, matrixAt(m));
+            QVERIFY2(actual == expected, qPrintable(QString::fromLatin1("width %1").arg(width)));
+            QVERIFY(guardIntact(actual));
+        }
+    }
+}
+
+void tst_DSFrameConverter::nv12MatchesScalar()
+{
+    const int planarHeight = height + 1;
+    for (int w = 0; w < int(sizeof(widths) / sizeof(widths[0])); ++w) {
+        const int width = widths[w];
+        const QVector<quint8> y = noise(width * planarHeight, width);
+        const QVector<quint8> uv = noise(width * planarHeight / 2, width + 1);
+
+        for (int m = 0; m < 4; ++m) {
+            QVector<quint8> expected = output(width * 3 * planarHeight);
+            QVector<quint8> actual = output(width * 3 * planarHeight);
+            DSFrameConverter::nv12ToRgb24Scalar(y.constData(), width, uv.constData(), width,
+                                                expected.data(), width * 3, width, planarHeight, matrixAt(m));
+            DSFrameConverter::nv12ToRgb24(y.constData(), width, uv.constData(), width,
+                                          actual.data(), width * 3, width, planarHeight, matrixAt(m));
+            QVERIFY2(actual == expected, qPrintable(QString::fromLatin1("width %1").arg(width)));
+            QVERIFY(guardIntact(actual));
+        }
+    }
+}
+
+void tst_DSFrameConverter::bgr24FlipsAndSwapsInOnePass()
+{
+    for (int w = 0; w < int(sizeof(widths) / sizeof(widths[0])); ++w) {
+        // odd widths too, with DIB rows padded to four bytes
+        for (int width = widths[w] - 1; width <= widths[w]; ++width) {
+            if (width < 1)
+                continue;
+            const int srcStride = (width * 3 + 3) & ~3;
+            const QVector<quint8> src = noise(srcStride * height, width);
+
+            QVector<quint8> dst = output(width * 3 * height);
+            DSFrameConverter::bgr24ToRgb24(src.constData() + (height - 1) * srcStride, -srcStride,
+                                           dst.data(), width * 3, width, height);
+
+            for (int y = 0; y < height; ++y) {
+                const quint8 *in = src.constData() + (height - 1 - y) * srcStride;
+                const quint8 *out = dst.constData() + y * width * 3;
+                for (int x = 0; x < width * 3; x += 3) {
+                    QVERIFY(out[x] == in[x + 2] && out[x + 1] == in[x + 1] && out[x + 2] == in[x]);
+                }
+            }
+            QVERIFY(guardIntact(dst));
+        }
+    }
+}
+
+void tst_DSFrameConverter::bgr32MatchesReference()
+{
+    for (int w = 0; w < int(sizeof(widths) / sizeof(widths[0])); ++w) {
+        for (int width = qMax(1, widths[w] - 1); width <= widths[w]; ++width) {
+            // top-down and, as DIBs come, bottom-up into padded rows
+            for (int flip = 0; flip < 2; ++flip) {
+                const int srcStride = width * 4;
+                const int rowSize = width * 3;
+                const int dstStride = rowSize + 5;
+                const QVector<quint8> src = noise(srcStride * height, width);
+                const quint8 *first = flip ? src.constData() + (height - 1) * srcStride : src.constData();
+
+                QVector<quint8> dst = output(dstStride * height);
+                DSFrameConverter::bgr32ToRgb24(first, flip ? -srcStride : srcStride,
+                                               dst.data(), dstStride, width, height);
+
+                for (int y = 0; y < height; ++y) {
+                    const quint8 *in = first + (flip ? -y : y) * srcStride;
+                    const quint8 *out = dst.constData() + y * dstStride;
+                    for (int x = 0; x < width; ++x) {
+                        QVERIFY2(out[x * 3] == in[x * 4 + 2] && out[x * 3 + 1] == in[x * 4 + 1]
+                                 && out[x * 3 + 2] == in[x * 4],
+                                 qPrintable(QString::fromLatin1("width %1 x %2 y %3").arg(width).arg(x).arg(y)));
+                    }
+                }
+                QVERIFY(paddingIntact(dst, rowSize, dstStride, height));
+                QVERIFY(guardIntact(dst));
+            }
+        }
+    }
+}
+
+void tst_DSFrameConverter::rgb555MatchesReference()
+{
+    for (int w = 0; w < int(sizeof(widths) / sizeof(widths[0])); ++w) {
+        for (int width = qMax(1, widths[w] - 1); width <= widths[w]; ++width) {
+            for (int flip = 0; flip < 2; ++flip) {
+                const int srcStride = (width * 2 + 3) & ~3;
+                const int rowSize = width * 3;
+                const int dstStride = rowSize + 5;
+                const QVector<quint8> src = noise(srcStride * height, width);
+                const quint8 *first = flip ? src.constData() + (height - 1) * srcStride : src.constData();
+
+                QVector<quint8> dst = output(dstStride * height);
+                DSFrameConverter::rgb555ToRgb24(first, flip ? -srcStride : srcStride,
+                                                dst.data(), dstStride, width, height);
+
+                for (int y = 0; y < height; ++y) {
+                    const quint8 *in = first + (flip ? -y : y) * srcStride;
+                    const quint8 *out = dst.constData() + y * dstStride;
+                    for (int x = 0; x < width; ++x) {
+                        const int pixel = in[x * 2] | (in[x * 2 + 1] << 8);
+                        QVERIFY2(out[x * 3] == expand5((pixel >> 10) & 0x1f)
+                                 && out[x * 3 + 1] == expand5((pixel >> 5) & 0x1f)
+                                 && out[x * 3 + 2] == expand5(pixel & 0x1f),
+                                 qPrintable(QString::fromLatin1("width %1 x %2 y %3").arg(width).arg(x).arg(y)));
+                    }
+                }
+                QVERIFY(paddingIntact(dst, rowSize, dstStride, height));
+                QVERIFY(guardIntact(dst));
+            }
+        }
+    }
+}
+
+QTEST_APPLESS_MAIN(tst_DSFrameConverter)
+
+#include "tst_dsframeconverter.moc"
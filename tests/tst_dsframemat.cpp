@@ -0,0 +1,155 @@
+#include <QtTest/QtTest>
+#include <QtCore/qthread.h>
+
+#include "dsframemat.h"
+
+QT_USE_NAMESPACE
+
+namespace {
+
+const int Rows = 480;
+const int Cols = 640;
+
+bool pointsInto(const cv::Mat &mat, const cv::Mat &buffer)
+{
+    return mat.data >= buffer.datastart && mat.data < buffer.dataend;
+}
+
+// Holds on to Mats and drops them from a thread of its own, the way a queued
+// receiver does.
+class Releaser : public QThread
+{
+public:
+    QList<cv::Mat> mats;
+
+protected:
+    void run()
+    {
+        while (!mats.isEmpty())
+            mats.takeFirst().release();
+    }
+};
+
+} // end namespace
+
+// Lifetime of pooled buffers behind cv::Mat: whatever is done to the Mats,
+// the buffer has to go back to its pool once, when the last one is released.
+class tst_DSFrameMat : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void copiesAndRoisShareTheBuffer();
+    void wrapKeepsTheBufferAlive();
+    void reallocationLeavesTheBuffer();
+    void releaseOnAnotherThread();
+
+private:
+    DSFramePool *m_pool;
+};
+
+void tst_DSFrameMat::init()
+{
+    m_pool = new DSFramePool(Rows * Cols * 3);
+}
+
+void tst_DSFrameMat::cleanup()
+{
+    m_pool->release();
+    m_pool = 0;
+}
+
+void tst_DSFrameMat::copiesAndRoisShareTheBuffer()
+{
+    cv::Mat mat = DSMatAllocator::allocate(m_pool, Rows, Cols, CV_8UC3);
+    QCOMPARE(m_pool->statistics().outstanding, 1);
+    mat.setTo(cv::Scalar(1, 2, 3));
+
+    cv::Mat copy = mat;
+    cv::Mat roi = mat(cv::Rect(16, 8, 64, 32));
+    cv::Mat roiOfCopy = copy(cv::Rect(0, 0, Cols, 1));
+    QVERIFY(copy.data == mat.data);
+    QVERIFY(pointsInto(roi, mat));
+    QVERIFY(roi.at<cv::Vec3b>(0, 0) == cv::Vec3b(1, 2, 3));
+    QCOMPARE(m_pool->statistics().outstanding, 1);
+
+    mat.release();
+    copy.release();
+    roiOfCopy.release();
+    QCOMPARE(m_pool->statistics().outstanding, 1);
+
+    roi.release();
+    QCOMPARE(m_pool->statistics().outstanding, 0);
+}
+
+void tst_DSFrameMat::wrapKeepsTheBufferAlive()
+{
+    DSFrameHandle buffer = m_pool->acquire();
+    cv::Mat mat = DSMatAllocator::wrap(buffer, Cols * 3, Rows - 1, Cols, CV_8UC3, Cols * 3);
+    QVERIFY(mat.data == buffer->data + Cols * 3);
+
+    buffer.reset();
+    QCOMPARE(m_pool->statistics().outstanding, 1);
+
+    cv::Mat copy = mat;
+    mat.release();
+    QCOMPARE(m_pool->statistics().outstanding, 1);
+    copy.release();
+    QCOMPARE(m_pool->statistics().outstanding, 0);
+}
+
+void tst_DSFrameMat::reallocationLeavesTheBuffer()
+{
+    cv::Mat mat = DSMatAllocator::allocate(m_pool, Rows, Cols, CV_8UC3);
+    cv::Mat copy = mat;
+
+    // A receiver reusing a shared Mat for output of another size gets heap
+    // memory of its own; the pooled buffer stays with the other references.
+    copy.create(Rows / 2, Cols / 2, CV_8UC1);
+    QVERIFY(!pointsInto(copy, mat));
+    copy.setTo(cv::Scalar(7));
+    QCOMPARE(m_pool->statistics().outstanding, 1);
+
+    cv::Mat clone = mat.clone();
+    QVERIFY(!pointsInto(clone, mat));
+
+    // same size and type: create() keeps the buffer
+    cv::Mat same = mat;
+    same.create(Rows, Cols, CV_8UC3);
+    QVERIFY(same.data == mat.data);
+
+    mat.release();
+    same.release();
+    QCOMPARE(m_pool->statistics().outstanding, 0);
+
+    // the heap Mats are freed by whoever allocated them
+    copy.release();
+    clone.release();
+    QCOMPARE(m_pool->statistics().outstanding, 0);
+}
+
+void tst_DSFrameMat::releaseOnAnotherThread()
+{
+    for (int round = 0; round < 100; ++round) {
+        Releaser releaser;
+        for (int i = 0; i < 4; ++i) {
+            cv::Mat mat = DSMatAllocator::allocate(m_pool, Rows, Cols, CV_8UC3);
+            releaser.mats << mat << mat(cv::Rect(0, i, Cols, 1));
+        }
+        QCOMPARE(m_pool->statistics().outstanding, 4);
+
+        releaser.start();
+        QVERIFY(releaser.wait());
+        QCOMPARE(m_pool->statistics().outstanding, 0);
+    }
+
+    // the returned buffers are reused rather than allocated again
+    QCOMPARE(m_pool->statistics().allocations, 4);
+}
+
+QTEST_APPLESS_MAIN(tst_DSFrameMat)
+
+#include "tst_dsframemat.moc"
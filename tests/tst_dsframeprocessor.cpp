@@ -0,0 +1,565 @@
+#include <QtTest/QtTest>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qmap.h>
+#include <QtCore/qmutex.h>
+
+#include "dsframeprocessor.h"
+
+QT_USE_NAMESPACE
+
+namespace {
+
+const int FrameCount = 2000;
+const int QueueDepth = 4;
+
+// BGR24 frames of one row, the sequence number in the first pixel.
+const int Width = 8;
+
+DSFrameFormat sequenceFormat()
+{
+    DSFrameFormat format;
+    format.pixelFormat = DSFrameFormat::BGR24;
+    format.width = Width;
+    format.height = 1;
+    format.stride = Width * 3;
+    format.sampleSize = format.frameSize();
+    return format;
+}
+
+// Converted to RGB, so the bytes come out the other way round.
+int sequenceOf(cv::Mat frame)
+{
+    const uchar *pixel = frame.ptr(0);
+    return pixel[2] | (pixel[1] << 8) | (pixel[0] << 16);
+}
+
+// Takes frames directly on the worker thread, spending delay microseconds on
+// each so the producer outruns it.
+class Receiver : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Receiver(int delay)
+        : m_delay(delay)
+    {
+    }
+
+    QVector<int> sequences() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_sequences;
+    }
+
+public slots:
+    void frameCaptured(cv::Mat frame)
+    {
+        QThread::usleep(m_delay);
+        QMutexLocker locker(&m_mutex);
+        m_sequences.append(sequenceOf(frame));
+    }
+
+private:
+    const int m_delay;
+    mutable QMutex m_mutex;
+    QVector<int> m_sequences;
+};
+
+void setUp(DSFrameProcessor *processor, Receiver *receiver,
+           DSFrameProcessor::BackpressurePolicy policy, int timeout = 100)
+{
+    processor->setFormat(sequenceFormat());
+    processor->setQueueDepth(QueueDepth);
+    processor->setBackpressurePolicy(policy, timeout);
+    processor->setWorkerThreadEnabled(true);
+    QObject::connect(processor, SIGNAL(cvFrameCaptured(cv::Mat)),
+                     receiver, SLOT(frameCaptured(cv::Mat)), Qt::DirectConnection);
+}
+
+// Pushes FrameCount frames, one every interval microseconds, and returns the
+// sequence numbers pushFrame() turned away.
+QVector<int> pushFrames(DSFrameProcessor *processor, int interval)
+{
+    QVector<int> refused;
+    quint8 frame[Width * 3];
+    memset(frame, 0, sizeof(frame));
+    for (int i = 0; i < FrameCount; ++i) {
+        frame[0] = quint8(i);
+        frame[1] = quint8(i >> 8);
+        frame[2] = quint8(i >> 16);
+        if (!processor->pushFrame(frame, sizeof(frame), i))
+            refused.append(i);
+        if (interval)
+            QThread::usleep(interval);
+    }
+    return refused;
+}
+
+// Pushes from a thread of its own, for the test thread to change settings
+// meanwhile.
+class Producer : public QThread
+{
+public:
+    explicit Producer(DSFrameProcessor *processor)
+        : m_processor(processor)
+    {
+    }
+
+    QVector<int> refused;
+
+protected:
+    void run()
+    {
+        refused = pushFrames(m_processor, 10);
+    }
+
+private:
+    DSFrameProcessor *m_processor;
+};
+
+// Keeps whole frames, regions and subscribers' frames as they come, directly
+// on the worker thread.
+class Collector : public QObject
+{
+    Q_OBJECT
+public:
+    Collector()
+        : m_regionCount(0)
+    {
+    }
+
+    QList<cv::Mat> frames() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_frames;
+    }
+
+    QMap<int, cv::Mat> regions() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_regions;
+    }
+
+    int regionCount() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_regionCount;
+    }
+
+    QList<cv::Mat> subscriptionFrames(int id) const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_subscriptionFrames.value(id);
+    }
+
+public slots:
+    void frameCaptured(cv::Mat frame)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_frames.append(frame);
+    }
+
+    void regionCaptured(int index, cv::Mat frame)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_regions.insert(index, frame);
+        ++m_regionCount;
+    }
+
+    void subscriptionFrameCaptured(int id, cv::Mat frame)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_subscriptionFrames[id].append(frame);
+    }
+
+private:
+    mutable QMutex m_mutex;
+    QList<cv::Mat> m_frames;
+    QMap<int, cv::Mat> m_regions;
+    int m_regionCount;
+    QMap<int, QList<cv::Mat> > m_subscriptionFrames;
+};
+
+// A frame of noise in format, so every misplaced pixel shows.
+QVector<quint8> noiseFrame(const DSFrameFormat &format)
+{
+    QVector<quint8> data(format.frameSize());
+    quint32 seed = 0x1234567 + format.pixelFormat;
+    for (int i = 0; i < data.size(); ++i) {
+        seed = seed * 1664525 + 1013904223;
+        data[i] = quint8(seed >> 24);
+    }
+    return data;
+}
+
+bool sameImage(cv::Mat a, cv::Mat b)
+{
+    if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type())
+        return false;
+    for (int y = 0; y < a.rows; ++y) {
+        if (memcmp(a.ptr(y), b.ptr(y), a.cols * a.channels()))
+            return false;
+    }
+    return true;
+}
+
+// Every frame has to be emitted, turned away by pushFrame() or evicted from
+// the queue, exactly one of the three, and the emitted ones in the order they
+// were pushed. Returns what is wrong, if anything.
+QString checkAccounting(const QVector<int> &emitted, const QVector<int> &refused,
+                        const DSFrameDropStatistics &stats)
+{
+    QVector<int> seen(FrameCount, 0);
+    for (int i = 0; i < emitted.size(); ++i) {
+        if (i > 0 && emitted.at(i) <= emitted.at(i - 1))
+            return QString::fromLatin1("frame %1 emitted after %2").arg(emitted.at(i)).arg(emitted.at(i - 1));
+        ++seen[emitted.at(i)];
+    }
+    foreach (int sequence, refused)
+        ++seen[sequence];
+    for (int i = 0; i < FrameCount; ++i) {
+        if (seen.at(i) > 1)
+            return QString::fromLatin1("frame %1 emitted and turned away").arg(i);
+    }
+
+    if (refused.size() != stats.droppedNewest + stats.timedOut)
+        return QString::fromLatin1("%1 frames turned away, %2 counted")
+                .arg(refused.size()).arg(stats.droppedNewest + stats.timedOut);
+    if (stats.queued != FrameCount - refused.size())
+        return QString::fromLatin1("%1 frames queued, %2 counted")
+                .arg(FrameCount - refused.size()).arg(stats.queued);
+    if (emitted.size() + stats.droppedOldest + refused.size() != FrameCount)
+        return QString::fromLatin1("%1 emitted, %2 evicted and %3 turned away of %4 frames")
+                .arg(emitted.size()).arg(stats.droppedOldest).arg(refused.size()).arg(FrameCount);
+    return QString();
+}
+
+} // end namespace
+
+// DSFrameProcessor end to end: frames pushed by the test thread, converted on
+// the worker thread and emitted to a receiver there.
+class tst_DSFrameProcessor : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void dropNewestTurnsFramesAway();
+    void dropOldestDeliversTheNewest();
+    void blockWithTimeoutWaitsForRoom();
+    void blockWithTimeoutGivesUp();
+    void formatChangesWhileStreaming();
+    void regionsMatchTheFullFrame();
+    void subscribersShareOneBuffer();
+    void subscriptionRatesAreLimited();
+};
+
+void tst_DSFrameProcessor::dropNewestTurnsFramesAway()
+{
+    DSFrameProcessor processor;
+    Receiver receiver(300);
+    setUp(&processor, &receiver, DSFrameProcessor::DropNewest);
+
+    const QVector<int> refused = pushFrames(&processor, 100);
+    QTRY_COMPARE(receiver.sequences().size(), processor.dropStatistics().queued);
+
+    const DSFrameDropStatistics stats = processor.dropStatistics();
+    QVERIFY(stats.droppedNewest > 0);
+    QCOMPARE(stats.droppedOldest, 0);
+    QCOMPARE(stats.timedOut, 0);
+    const QString error = checkAccounting(receiver.sequences(), refused, stats);
+    QVERIFY2(error.isEmpty(), qPrintable(error));
+}
+
+void tst_DSFrameProcessor::dropOldestDeliversTheNewest()
+{
+    DSFrameProcessor processor;
+    Receiver receiver(300);
+    setUp(&processor, &receiver, DSFrameProcessor::DropOldest);
+
+    const QVector<int> refused = pushFrames(&processor, 100);
+    QVERIFY(refused.isEmpty());
+    QTRY_COMPARE(receiver.sequences().size(),
+                 FrameCount - processor.dropStatistics().droppedOldest);
+
+    const DSFrameDropStatistics stats = processor.dropStatistics();
+    QVERIFY(stats.droppedOldest > 0);
+    QCOMPARE(stats.droppedNewest, 0);
+    const QVector<int> emitted = receiver.sequences();
+    QCOMPARE(emitted.last(), FrameCount - 1);
+    const QString error = checkAccounting(emitted, refused, stats);
+    QVERIFY2(error.isEmpty(), qPrintable(error));
+}
+
+void tst_DSFrameProcessor::blockWithTimeoutWaitsForRoom()
+{
+    DSFrameProcessor processor;
+    Receiver receiver(300);
+    setUp(&processor, &receiver, DSFrameProcessor::BlockWithTimeout, 5000);
+
+    // flat out, held back by the consumer alone
+    const QVector<int> refused = pushFrames(&processor, 0);
+    QVERIFY(refused.isEmpty());
+    QTRY_COMPARE(receiver.sequences().size(), FrameCount);
+
+    const DSFrameDropStatistics stats = processor.dropStatistics();
+    QCOMPARE(stats.timedOut, 0);
+    const QString error = checkAccounting(receiver.sequences(), refused, stats);
+    QVERIFY2(error.isEmpty(), qPrintable(error));
+}
+
+void tst_DSFrameProcessor::blockWithTimeoutGivesUp()
+{
+    DSFrameProcessor processor;
+    Receiver receiver(3000);
+    setUp(&processor, &receiver, DSFrameProcessor::BlockWithTimeout, 1);
+
+    const QVector<int> refused = pushFrames(&processor, 0);
+    QTRY_COMPARE(receiver.sequences().size(), processor.dropStatistics().queued);
+
+    const DSFrameDropStatistics stats = processor.dropStatistics();
+    QVERIFY(stats.timedOut > 0);
+    QCOMPARE(stats.droppedNewest, 0);
+    const QString error = checkAccounting(receiver.sequences(), refused, stats);
+    QVERIFY2(error.isEmpty(), qPrintable(error));
+}
+
+void tst_DSFrameProcessor::formatChangesWhileStreaming()
+{
+    DSFrameProcessor processor;
+    Receiver receiver(0);
+    setUp(&processor, &receiver, DSFrameProcessor::DropNewest);
+
+    // the same frames in larger buffers every other time, so the pool is
+    // replaced too
+    const DSFrameFormat format = sequenceFormat();
+    DSFrameFormat padded = format;
+    padded.sampleSize = 4096;
+
+    Producer producer(&processor);
+    producer.start();
+    int changes = 0;
+    while (!producer.isFinished()) {
+        processor.setFormat(changes++ % 2 ? format : padded);
+        QThread::yieldCurrentThread();
+    }
+    QVERIFY(producer.wait());
+    QTRY_COMPARE(processor.inputPoolStatistics().outstanding, 0);
+    qDebug() << changes << "format changes," << receiver.sequences().size() << "frames emitted";
+
+    // frames queued at a change are dropped, the others come out in order
+    const QVector<int> emitted = receiver.sequences();
+    QVERIFY(!emitted.isEmpty());
+    for (int i = 1; i < emitted.size(); ++i)
+        QVERIFY(emitted.at(i) > emitted.at(i - 1));
+    foreach (int sequence, producer.refused)
+        QVERIFY(!emitted.contains(sequence));
+}
+
+void tst_DSFrameProcessor::regionsMatchTheFullFrame()
+{
+    struct Case
+    {
+        DSFrameFormat::PixelFormat pixelFormat;
+        bool bottomUp;
+    };
+    const Case cases[] = {
+        { DSFrameFormat::YUY2, false }, { DSFrameFormat::UYVY, false },
+        { DSFrameFormat::I420, false }, { DSFrameFormat::NV12, false },
+        { DSFrameFormat::BGR24, false }, { DSFrameFormat::BGR24, true },
+        { DSFrameFormat::BGR32, false }, { DSFrameFormat::BGR32, true },
+        { DSFrameFormat::RGB555, true }
+    };
+    const DSFrameProcessor::OutputFormat outputs[] = {
+        DSFrameProcessor::RgbOutput, DSFrameProcessor::LumaOutput
+    };
+
+    // rows of RGB24 and RGB555 padded to four bytes
+    const int width = 62;
+    const int height = 34;
+    const QRect bounds(0, 0, width, height);
+    QList<QRect> regions;
+    regions << QRect(3, 5, 17, 9)                   // odd, across chroma pairs
+            << QRect(-7, -3, 20, 12)                // over the top left corner
+            << QRect(width - 5, height - 3, 16, 16) // over the bottom right one
+            << QRect(width + 2, 0, 8, 8)            // outside, skipped
+            << bounds
+            << QRect(1, 1, 1, 1);
+    const int skipped = 3;
+
+    for (int c = 0; c < int(sizeof(cases) / sizeof(cases[0])); ++c) {
+        for (int o = 0; o < int(sizeof(outputs) / sizeof(outputs[0])); ++o) {
+            DSFrameFormat format;
+            format.pixelFormat = cases[c].pixelFormat;
+            format.width = width;
+            format.height = height;
+            format.bottomUp = cases[c].bottomUp;
+            switch (format.pixelFormat) {
+            case DSFrameFormat::BGR24:
+                format.stride = (width * 3 + 3) & ~3;
+                break;
+            case DSFrameFormat::BGR32:
+                format.stride = width * 4;
+                break;
+            case DSFrameFormat::I420:
+            case DSFrameFormat::NV12:
+                format.stride = width;
+                break;
+            default:
+                format.stride = (width * 2 + 3) & ~3;
+                break;
+            }
+            format.sampleSize = format.frameSize();
+
+            DSFrameProcessor processor;
+            processor.setFormat(format);
+            processor.setOutputFormat(outputs[o]);
+            processor.setWorkerThreadEnabled(true);
+            Collector collector;
+            QObject::connect(&processor, SIGNAL(cvFrameCaptured(cv::Mat)),
+                             &collector, SLOT(frameCaptured(cv::Mat)), Qt::DirectConnection);
+            QObject::connect(&processor, SIGNAL(regionCaptured(int,cv::Mat)),
+                             &collector, SLOT(regionCaptured(int,cv::Mat)), Qt::DirectConnection);
+
+            // the whole frame first, then the same frame again in regions
+            const QVector<quint8> data = noiseFrame(format);
+            QVERIFY(processor.pushFrame(data.constData(), data.size(), 0));
+            QTRY_COMPARE(collector.frames().size(), 1);
+            processor.setRegionsOfInterest(regions);
+            QVERIFY(processor.pushFrame(data.constData(), data.size(), 1));
+            QTRY_COMPARE(collector.regionCount(), regions.size() - 1);
+            QCOMPARE(collector.frames().size(), 1);
+
+            const cv::Mat full = collector.frames().first();
+            const QMap<int, cv::Mat> captured = collector.regions();
+            QVERIFY(!captured.contains(skipped));
+            for (int i = 0; i < regions.size(); ++i) {
+                if (i == skipped)
+                    continue;
+                const QRect rect = regions.at(i) & bounds;
+                const QString what = QString::fromLatin1("format %1, bottom-up %2, output %3, region %4")
+                        .arg(int(format.pixelFormat)).arg(int(format.bottomUp)).arg(int(outputs[o])).arg(i);
+                QVERIFY2(captured.contains(i), qPrintable(what));
+                QVERIFY2(sameImage(captured.value(i), full(cv::Rect(rect.x(), rect.y(), rect.width(), rect.height()))),
+                         qPrintable(what));
+            }
+        }
+    }
+}
+
+void tst_DSFrameProcessor::subscribersShareOneBuffer()
+{
+    DSFrameFormat format;
+    format.pixelFormat = DSFrameFormat::YUY2;
+    format.width = 64;
+    format.height = 32;
+    format.stride = format.width * 2;
+    format.sampleSize = format.frameSize();
+
+    DSFrameProcessor processor;
+    processor.setFormat(format);
+    processor.setWorkerThreadEnabled(true);
+    Collector collector;
+    QObject::connect(&processor, SIGNAL(cvFrameCaptured(cv::Mat)),
+                     &collector, SLOT(frameCaptured(cv::Mat)), Qt::DirectConnection);
+    QObject::connect(&processor, SIGNAL(subscriptionFrameCaptured(int,cv::Mat)),
+                     &collector, SLOT(subscriptionFrameCaptured(int,cv::Mat)), Qt::DirectConnection);
+
+    DSFrameProcessor::Subscription subscription;
+    subscription.scale = 3;
+    QCOMPARE(processor.subscribe(subscription), -1);
+    subscription.outputFormat = DSFrameProcessor::PlanarYuvOutput;
+    subscription.scale = 2;
+    QCOMPARE(processor.subscribe(subscription), -1);
+
+    // two the same, one of them at half size, and grey
+    subscription.outputFormat = DSFrameProcessor::RgbOutput;
+    subscription.scale = 1;
+    const int first = processor.subscribe(subscription);
+    const int second = processor.subscribe(subscription);
+    subscription.scale = 2;
+    const int half = processor.subscribe(subscription);
+    subscription.outputFormat = DSFrameProcessor::LumaOutput;
+    subscription.scale = 1;
+    const int grey = processor.subscribe(subscription);
+    QCOMPARE(processor.subscriptions(), QList<int>() << first << second << half << grey);
+
+    const QVector<quint8> data = noiseFrame(format);
+    const int frameCount = 3;
+    for (int i = 0; i < frameCount; ++i) {
+        QVERIFY(processor.pushFrame(data.constData(), data.size(), i));
+        QTRY_COMPARE(collector.subscriptionFrames(grey).size(), i + 1);
+    }
+    QTRY_COMPARE(collector.subscriptionFrames(first).size(), frameCount);
+    QTRY_COMPARE(collector.subscriptionFrames(second).size(), frameCount);
+    QTRY_COMPARE(collector.subscriptionFrames(half).size(), frameCount);
+    QVERIFY(collector.frames().isEmpty());
+
+    for (int i = 0; i < frameCount; ++i) {
+        // the very same buffer, not a copy
+        const cv::Mat image = collector.subscriptionFrames(first).at(i);
+        QVERIFY(collector.subscriptionFrames(second).at(i).data == image.data);
+        QCOMPARE(image.cols, format.width);
+        QCOMPARE(image.type(), CV_8UC3);
+
+        const cv::Mat small = collector.subscriptionFrames(half).at(i);
+        QVERIFY(small.data != image.data);
+        QCOMPARE(small.cols, format.width / 2);
+        QCOMPARE(small.rows, format.height / 2);
+        QCOMPARE(small.type(), CV_8UC3);
+        QCOMPARE(collector.subscriptionFrames(grey).at(i).type(), CV_8UC1);
+    }
+
+    // with everyone gone frames are whole again, converted the same
+    processor.unsubscribe(first);
+    processor.unsubscribe(second);
+    processor.unsubscribe(half);
+    processor.unsubscribe(grey);
+    QVERIFY(processor.subscriptions().isEmpty());
+    QVERIFY(processor.pushFrame(data.constData(), data.size(), frameCount));
+    QTRY_COMPARE(collector.frames().size(), 1);
+    QVERIFY(sameImage(collector.frames().first(), collector.subscriptionFrames(first).last()));
+    QCOMPARE(collector.subscriptionFrames(first).size(), frameCount);
+}
+
+void tst_DSFrameProcessor::subscriptionRatesAreLimited()
+{
+    DSFrameProcessor processor;
+    processor.setFormat(sequenceFormat());
+    processor.setBackpressurePolicy(DSFrameProcessor::BlockWithTimeout, 5000);
+    processor.setWorkerThreadEnabled(true);
+    Collector collector;
+    QObject::connect(&processor, SIGNAL(subscriptionFrameCaptured(int,cv::Mat)),
+                     &collector, SLOT(subscriptionFrameCaptured(int,cv::Mat)), Qt::DirectConnection);
+
+    DSFrameProcessor::Subscription subscription;
+    const int all = processor.subscribe(subscription);
+    subscription.frameRate = 10;
+    const int limited = processor.subscribe(subscription);
+
+    // about 100 fps for half a second
+    const int frameCount = 50;
+    quint8 frame[Width * 3];
+    memset(frame, 0, sizeof(frame));
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < frameCount; ++i) {
+        frame[0] = quint8(i);
+        QVERIFY(processor.pushFrame(frame, sizeof(frame), i));
+        QThread::usleep(10000);
+    }
+    const qint64 elapsed = timer.elapsed();
+    QTRY_COMPARE(collector.subscriptionFrames(all).size(), frameCount);
+
+    // the first frame, then one every 100 ms
+    const int expected = int(elapsed / 100) + 1;
+    const QList<cv::Mat> frames = collector.subscriptionFrames(limited);
+    qDebug() << frames.size() << "of" << frameCount << "frames in" << elapsed << "ms";
+    QVERIFY(frames.size() >= expected - 1);
+    QVERIFY(frames.size() <= expected + 1);
+    for (int i = 1; i < frames.size(); ++i)
+        QVERIFY(sequenceOf(frames.at(i)) > sequenceOf(frames.at(i - 1)));
+}
+
+QTEST_GUILESS_MAIN(tst_DSFrameProcessor)
+
+#include "tst_dsframeprocessor.moc"
@@ -0,0 +1,151 @@
+#include <QtTest/QtTest>
+#include <QtCore/qthread.h>
+
+#include <algorithm>
+
+#include "dsframequeue.h"
+#include "dslatencytracer.h"
+
+QT_USE_NAMESPACE
+
+namespace {
+
+const int FrameCount = 200000;
+const int QueueCapacity = 8;
+
+// Pushes FrameCount frames, each carrying its sequence number, from a thread
+// of its own. With evict set it uses pushEvictingOldest() and keeps the
+// numbers of the frames it got back; otherwise it retries until there is room.
+class Producer : public QThread
+{
+public:
+    Producer(DSFrameQueue *queue, DSFramePool *pool, bool evict)
+        : m_queue(queue)
+        , m_pool(pool)
+        , m_evict(evict)
+    {
+    }
+
+    static int sequence(const DSFrameHandle &frame)
+    {
+        int value;
+        memcpy(&value, frame->data, sizeof(value));
+        return value;
+    }
+
+    QVector<int> evicted;
+
+protected:
+    void run()
+    {
+        for (int i = 0; i < FrameCount; ++i) {
+            DSFrameHandle frame = m_pool->acquire();
+            memcpy(frame->data, &i, sizeof(i));
+            frame->time = DSLatencyTracer::now();
+
+            if (m_evict) {
+                const DSFrameHandle old = m_queue->pushEvictingOldest(frame);
+                if (!old.isNull())
+                    evicted.append(sequence(old));
+            } else {
+                while (!m_queue->push(frame)) {
+                    yieldCurrentThread();
+                    frame->time = DSLatencyTracer::now();
+                }
+            }
+        }
+    }
+
+private:
+    DSFrameQueue *m_queue;
+    DSFramePool *m_pool;
+    bool m_evict;
+};
+
+} // end namespace
+
+// Hammers the queue from a producer thread while the test thread consumes.
+class tst_DSFrameQueue : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void deliversEveryFrameInOrder();
+    void dropOldestNeverLosesNorDuplicates();
+};
+
+void tst_DSFrameQueue::deliversEveryFrameInOrder()
+{
+    DSFramePool *pool = new DSFramePool(64, QueueCapacity);
+    QVector<qint64> latencies;
+    latencies.reserve(FrameCount);
+    {
+        DSFrameQueue queue(QueueCapacity);
+        Producer producer(&queue, pool, false);
+        producer.start();
+
+        for (int expected = 0; expected < FrameCount; ) {
+            const DSFrameHandle frame = queue.pop();
+            if (frame.isNull()) {
+                QThread::yieldCurrentThread();
+                continue;
+            }
+            latencies.append(DSLatencyTracer::now() - frame->time);
+            QCOMPARE(Producer::sequence(frame), expected);
+            ++expected;
+        }
+
+        QVERIFY(producer.wait());
+        QVERIFY(queue.isEmpty());
+    }
+
+    QCOMPARE(pool->statistics().outstanding, 0);
+    pool->release();
+
+    std::sort(latencies.begin(), latencies.end());
+    qDebug() << "handoff latency p50" << latencies.at(FrameCount / 2)
+             << "ns, p99" << latencies.at(FrameCount * 99 / 100) << "ns";
+}
+
+void tst_DSFrameQueue::dropOldestNeverLosesNorDuplicates()
+{
+    DSFramePool *pool = new DSFramePool(64, QueueCapacity + 2);
+    QVector<int> seen(FrameCount, 0);
+    {
+        DSFrameQueue queue(QueueCapacity);
+        Producer producer(&queue, pool, true);
+        producer.start();
+
+        int last = -1;
+        for (;;) {
+            const bool finished = producer.isFinished();
+            const DSFrameHandle frame = queue.pop();
+            if (frame.isNull()) {
+                if (finished)
+                    break;
+                QThread::yieldCurrentThread();
+                continue;
+            }
+            const int sequence = Producer::sequence(frame);
+            QVERIFY(sequence > last);
+            last = sequence;
+            ++seen[sequence];
+        }
+
+        QVERIFY(producer.wait());
+        QCOMPARE(last, FrameCount - 1);
+        foreach (int sequence, producer.evicted)
+            ++seen[sequence];
+        qDebug() << "evicted" << producer.evicted.size() << "of" << FrameCount << "frames";
+    }
+
+    for (int i = 0; i < FrameCount; ++i)
+        QCOMPARE(seen.at(i), 1);
+
+    QCOMPARE(pool->statistics().outstanding, 0);
+    pool->release();
+}
+
+QTEST_APPLESS_MAIN(tst_DSFrameQueue)
+
+#include "tst_dsframequeue.moc"
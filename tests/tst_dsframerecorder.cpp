@@ -0,0 +1,119 @@
+#include <QtTest/QtTest>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qtemporarydir.h>
+#include <QtCore/qthread.h>
+
+#include "dsframerecorder.h"
+#include "dsrecordformat.h"
+
+QT_USE_NAMESPACE
+
+namespace {
+
+const int Width = 1920;
+const int Height = 1080;
+const int FrameRate = 60;
+const int FrameCount = 3 * FrameRate;
+
+// Every frame differs, so misplaced or mixed up frames show.
+void fillFrame(quint8 *data, int size, int number)
+{
+    memset(data, (number * 37) & 0xff, size);
+    memcpy(data, &number, sizeof(number));
+}
+
+} // end namespace
+
+// Records synthetic 1080p60 YUY2 into a temporary directory on local disk,
+// paced like a camera, then reads the recording back.
+class tst_DSFrameRecorder : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void sustains1080p60();
+};
+
+void tst_DSFrameRecorder::sustains1080p60()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString base = dir.path() + QLatin1String("/capture");
+
+    DSFrameFormat format;
+    format.pixelFormat = DSFrameFormat::YUY2;
+    format.width = Width;
+    format.height = Height;
+    format.stride = Width * 2;
+    format.sampleSize = format.frameSize();
+    const int frameSize = format.frameSize();
+
+    DSFramePool *pool = new DSFramePool(frameSize);
+    DSFrameRecorder recorder;
+    recorder.setSegmentSize(256 << 20); // a few roll overs
+    QVERIFY(recorder.start(base, format));
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < FrameCount; ++i) {
+        const qint64 due = qint64(i) * 1000000000 / FrameRate;
+        const qint64 wait = due - timer.nsecsElapsed();
+        if (wait > 0)
+            QThread::usleep(ulong(wait / 1000));
+
+        DSFrameHandle frame = pool->acquire();
+        fillFrame(frame->data, frameSize, i);
+        frame->length = frameSize;
+        frame->time = due;
+        QVERIFY(recorder.write(frame));
+    }
+    recorder.stop();
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    const DSRecorderStatistics statistics = recorder.statistics();
+    qDebug() << statistics.bytesWritten / 1e6 / (elapsed / 1e9) << "MB/s in"
+             << statistics.segments << "segments";
+    QCOMPARE(statistics.framesDropped, qint64(0));
+    QCOMPARE(statistics.framesWritten, qint64(FrameCount));
+    QVERIFY(statistics.segments > 1);
+    QCOMPARE(pool->statistics().outstanding, 0);
+    pool->release();
+
+    // read back: every frame once, in order, block aligned and intact
+    QVector<quint8> expected(frameSize);
+    QVector<quint8> actual(frameSize);
+    int number = 0;
+    for (int segment = 0; segment < statistics.segments; ++segment) {
+        QFile data(DSRecordFormat::segmentPath(base, segment));
+        QFile index(DSRecordFormat::indexPath(base, segment));
+        QVERIFY(data.open(QIODevice::ReadOnly));
+        QVERIFY(index.open(QIODevice::ReadOnly));
+
+        DSRecordFormat::Header header;
+        QCOMPARE(data.read(reinterpret_cast<char *>(&header), sizeof(header)), qint64(sizeof(header)));
+        QVERIFY(DSRecordFormat::isValid(header));
+        QCOMPARE(header.segment, segment);
+        QCOMPARE(header.firstFrame, qint64(number));
+        QCOMPARE(DSRecordFormat::format(header).frameSize(), frameSize);
+        QCOMPARE(data.size() % DSRecordFormat::BlockSize, qint64(0));
+
+        DSRecordFormat::IndexEntry entry;
+        while (index.read(reinterpret_cast<char *>(&entry), sizeof(entry)) == qint64(sizeof(entry))) {
+            QCOMPARE(entry.offset % DSRecordFormat::BlockSize, qint64(0));
+            QCOMPARE(entry.length, frameSize);
+            QCOMPARE(entry.time, qint64(number) * 1000000000 / FrameRate);
+
+            QVERIFY(data.seek(entry.offset));
+            QCOMPARE(data.read(reinterpret_cast<char *>(actual.data()), frameSize), qint64(frameSize));
+            fillFrame(expected.data(), frameSize, number);
+            QVERIFY(actual == expected);
+            ++number;
+        }
+    }
+    QCOMPARE(number, FrameCount);
+}
+
+QTEST_APPLESS_MAIN(tst_DSFrameRecorder)
+
+#include "tst_dsframerecorder.moc"
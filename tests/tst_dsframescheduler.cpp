@@ -0,0 +1,334 @@
+#include <QtTest/QtTest>
+#include <QtCore/qthread.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qwaitcondition.h>
+
+#include "dsframescheduler.h"
+#include "dsframeprocessor.h"
+#include "dssyntheticframesource.h"
+
+QT_USE_NAMESPACE
+
+namespace {
+
+const int Width = 640;
+const int Height = 480;
+const int FrameCount = 240;
+const int ProcessorCount = 3;
+const int QueueDepth = 4;
+
+// Phase of the synthetic source's moving bars in the top row of a luma
+// frame: the first bar edge is an eighth of the width in and moves left by
+// a 64th of it per phase.
+int phaseOf(cv::Mat frame)
+{
+    const uchar *row = frame.ptr(0);
+    int x = 1;
+    while (x < frame.cols && row[x] == row[0])
+        ++x;
+    return (frame.cols / 8 - x) / (frame.cols / 64);
+}
+
+// Keeps the phase of every frame it gets and the thread it came on,
+// connected directly so it runs wherever the frame was processed. While held
+// it blocks in the slot, keeping that thread busy until release().
+class Receiver : public QObject
+{
+    Q_OBJECT
+public:
+    Receiver()
+        : m_inside(0)
+        , m_overlaps(0)
+        , m_hold(false)
+        , m_holding(false)
+    {
+    }
+
+    QVector<int> phases() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_phases;
+    }
+
+    QList<QThread *> threads() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_threads;
+    }
+
+    // Frames that arrived while another was still in the slot.
+    int overlaps() const { return m_overlaps.load(); }
+
+    void hold()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_hold = true;
+    }
+
+    bool waitUntilHolding()
+    {
+        QMutexLocker locker(&m_mutex);
+        while (!m_holding) {
+            if (!m_condition.wait(&m_mutex, 5000))
+                return false;
+        }
+        return true;
+    }
+
+    void release()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_hold = false;
+        m_condition.wakeAll();
+    }
+
+public slots:
+    void frameCaptured(cv::Mat frame)
+    {
+        if (m_inside.fetchAndAddOrdered(1) > 0)
+            m_overlaps.fetchAndAddOrdered(1);
+
+        QMutexLocker locker(&m_mutex);
+        m_phases.append(phaseOf(frame));
+        m_threads.append(QThread::currentThread());
+        while (m_hold) {
+            m_holding = true;
+            m_condition.wakeAll();
+            m_condition.wait(&m_mutex);
+        }
+        m_holding = false;
+        locker.unlock();
+
+        m_inside.fetchAndAddOrdered(-1);
+    }
+
+private:
+    mutable QMutex m_mutex;
+    QWaitCondition m_condition;
+    QVector<int> m_phases;
+    QList<QThread *> m_threads;
+    QAtomicInt m_inside;
+    QAtomicInt m_overlaps;
+    bool m_hold;
+    bool m_holding;
+};
+
+// Luma frames, so the phase can be read off them, and no frame turned away
+// while the producer can wait.
+void setUp(DSFrameProcessor *processor, Receiver *receiver)
+{
+    processor->setOutputFormat(DSFrameProcessor::LumaOutput);
+    processor->setBackpressurePolicy(DSFrameProcessor::BlockWithTimeout, 10000);
+    QObject::connect(processor, SIGNAL(cvFrameCaptured(cv::Mat)),
+                     receiver, SLOT(frameCaptured(cv::Mat)), Qt::DirectConnection);
+}
+
+} // end namespace
+
+// Synthetic sources pushing as fast as they can into processors that share a
+// scheduler.
+class tst_DSFrameScheduler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void framesKeepTheirOrder();
+    void sharesFollowPriority();
+    void removeHandsQueuedFramesBack();
+    void deleteWhileQueued();
+    void queueDepthChangesWhileScheduled();
+};
+
+void tst_DSFrameScheduler::framesKeepTheirOrder()
+{
+    DSFrameScheduler scheduler(4);
+    DSFrameProcessor processors[ProcessorCount];
+    Receiver receivers[ProcessorCount];
+    QList<DSSyntheticFrameSource *> sources;
+
+    for (int i = 0; i < ProcessorCount; ++i) {
+        setUp(&processors[i], &receivers[i]);
+        scheduler.add(&processors[i]);
+        DSSyntheticFrameSource *source = new DSSyntheticFrameSource(DSFrameFormat::YUY2,
+                                                                    Width, Height, 0);
+        source->setFrameCount(FrameCount);
+        sources.append(source);
+    }
+    for (int i = 0; i < ProcessorCount; ++i)
+        QVERIFY(sources.at(i)->start(&processors[i]));
+
+    foreach (DSSyntheticFrameSource *source, sources) {
+        QVERIFY(source->waitForFinished(10000));
+        QCOMPARE(source->framesDropped(), 0);
+    }
+    QVERIFY(scheduler.waitForDone(10000));
+    qDeleteAll(sources);
+
+    for (int i = 0; i < ProcessorCount; ++i) {
+        const QVector<int> phases = receivers[i].phases();
+        QCOMPARE(phases.size(), FrameCount);
+        for (int j = 0; j < FrameCount; ++j)
+            QCOMPARE(phases.at(j), j % 8);
+        QCOMPARE(receivers[i].overlaps(), 0);
+        QCOMPARE(scheduler.statistics(&processors[i]).frames, qint64(FrameCount));
+    }
+}
+
+void tst_DSFrameScheduler::sharesFollowPriority()
+{
+    // One thread, so the two always compete for it. Frames take long enough
+    // to convert that the producers keep both queues full.
+    DSFrameScheduler scheduler(1);
+    DSFrameProcessor low;
+    DSFrameProcessor high;
+    DSFrameProcessor *processors[] = { &low, &high };
+    for (int i = 0; i < 2; ++i) {
+        DSFrameProcessor *processor = processors[i];
+        processor->setQueueDepth(8);
+        processor->setBackpressurePolicy(DSFrameProcessor::BlockWithTimeout, 10000);
+        scheduler.add(processor, i + 1);
+    }
+
+    DSSyntheticFrameSource lowSource(DSFrameFormat::YUY2, 1280, 720, 0);
+    DSSyntheticFrameSource highSource(DSFrameFormat::YUY2, 1280, 720, 0);
+    QVERIFY(lowSource.start(&low));
+    QVERIFY(highSource.start(&high));
+
+    // measured after both got going
+    QThread::msleep(250);
+    const DSSchedulerStatistics lowBefore = scheduler.statistics(&low);
+    const DSSchedulerStatistics highBefore = scheduler.statistics(&high);
+    QThread::msleep(1500);
+    const DSSchedulerStatistics lowAfter = scheduler.statistics(&low);
+    const DSSchedulerStatistics highAfter = scheduler.statistics(&high);
+
+    lowSource.stop();
+    highSource.stop();
+    QVERIFY(scheduler.waitForDone(10000));
+
+    const qint64 lowTime = lowAfter.busyTime - lowBefore.busyTime;
+    const qint64 highTime = highAfter.busyTime - highBefore.busyTime;
+    QVERIFY(lowAfter.frames - lowBefore.frames > 10);
+    const double ratio = double(highTime) / lowTime;
+    qDebug() << "priority 2 got" << ratio << "times the time of priority 1,"
+             << highAfter.frames - highBefore.frames << "against"
+             << lowAfter.frames - lowBefore.frames << "frames";
+    QVERIFY2(ratio > 1.6 && ratio < 2.5, qPrintable(QString::number(ratio)));
+}
+
+void tst_DSFrameScheduler::removeHandsQueuedFramesBack()
+{
+    DSFrameScheduler scheduler(1);
+    DSFrameProcessor busy;
+    DSFrameProcessor queued;
+    Receiver busyReceiver;
+    Receiver queuedReceiver;
+    setUp(&busy, &busyReceiver);
+    setUp(&queued, &queuedReceiver);
+    scheduler.add(&busy);
+    scheduler.add(&queued);
+    queued.setQueueDepth(QueueDepth);
+
+    // keep the only thread in busy's frame while queued's frames pile up
+    busyReceiver.hold();
+    DSSyntheticFrameSource busySource(DSFrameFormat::YUY2, Width, Height, 0);
+    busySource.setFrameCount(1);
+    QVERIFY(busySource.start(&busy));
+    QVERIFY(busyReceiver.waitUntilHolding());
+
+    DSSyntheticFrameSource queuedSource(DSFrameFormat::YUY2, Width, Height, 0);
+    queuedSource.setFrameCount(QueueDepth);
+    QVERIFY(queuedSource.start(&queued));
+    QVERIFY(queuedSource.waitForFinished(5000));
+    QCOMPARE(queuedSource.framesDelivered(), QueueDepth);
+
+    scheduler.remove(&queued);
+    QVERIFY(!scheduler.contains(&queued));
+    busyReceiver.release();
+    QVERIFY(scheduler.waitForDone(5000));
+    QCOMPARE(busyReceiver.phases().size(), 1);
+
+    // what was queued is processed on the thread the processor lives in
+    QTRY_COMPARE(queuedReceiver.phases().size(), QueueDepth);
+    const QVector<int> phases = queuedReceiver.phases();
+    for (int i = 0; i < QueueDepth; ++i)
+        QCOMPARE(phases.at(i), i);
+    foreach (QThread *thread, queuedReceiver.threads())
+        QVERIFY(thread == QThread::currentThread());
+}
+
+void tst_DSFrameScheduler::deleteWhileQueued()
+{
+    DSFrameScheduler scheduler(1);
+    DSFrameProcessor busy;
+    Receiver busyReceiver;
+    setUp(&busy, &busyReceiver);
+    scheduler.add(&busy);
+
+    DSFrameProcessor *queued = new DSFrameProcessor;
+    Receiver queuedReceiver;
+    setUp(queued, &queuedReceiver);
+    scheduler.add(queued);
+    queued->setQueueDepth(QueueDepth);
+
+    busyReceiver.hold();
+    DSSyntheticFrameSource busySource(DSFrameFormat::YUY2, Width, Height, 0);
+    busySource.setFrameCount(2);
+    QVERIFY(busySource.start(&busy));
+    QVERIFY(busyReceiver.waitUntilHolding());
+
+    DSSyntheticFrameSource queuedSource(DSFrameFormat::YUY2, Width, Height, 0);
+    queuedSource.setFrameCount(QueueDepth);
+    QVERIFY(queuedSource.start(queued));
+    QVERIFY(queuedSource.waitForFinished(5000));
+    QCOMPARE(queuedSource.framesDelivered(), QueueDepth);
+
+    // ready on the scheduler with its queue full
+    delete queued;
+    QVERIFY(!scheduler.contains(queued));
+
+    busyReceiver.release();
+    QVERIFY(busySource.waitForFinished(5000));
+    QVERIFY(scheduler.waitForDone(5000));
+    QCoreApplication::processEvents();
+
+    QCOMPARE(queuedReceiver.phases().size(), 0);
+    QCOMPARE(busyReceiver.phases().size(), 2);
+    QCOMPARE(scheduler.statistics(&busy).frames, qint64(2));
+}
+
+void tst_DSFrameScheduler::queueDepthChangesWhileScheduled()
+{
+    DSFrameScheduler scheduler(2);
+    DSFrameProcessor processor;
+    Receiver receiver;
+    setUp(&processor, &receiver);
+    scheduler.add(&processor, 3);
+
+    // paced, as a source running flat out would use up its frames during
+    // the first change
+    DSSyntheticFrameSource source(DSFrameFormat::YUY2, Width, Height, 240);
+    source.setFrameCount(FrameCount);
+    QVERIFY(source.start(&processor));
+
+    int changes = 0;
+    for (int depth = 1; !source.waitForFinished(1); depth = depth % 8 + 1) {
+        processor.setQueueDepth(depth);
+        ++changes;
+    }
+    QVERIFY(scheduler.waitForDone(5000));
+    qDebug() << changes << "queue depth changes," << source.framesDropped()
+             << "frames turned away meanwhile";
+
+    // still scheduled as before, with nothing lost track of
+    QVERIFY(scheduler.contains(&processor));
+    QCOMPARE(scheduler.priority(&processor), 3);
+    QCOMPARE(source.framesDelivered() + source.framesDropped(), FrameCount);
+    QVERIFY(receiver.phases().size() <= source.framesDelivered());
+    QCOMPARE(receiver.overlaps(), 0);
+    QCOMPARE(processor.inputPoolStatistics().outstanding, 0);
+}
+
+QTEST_GUILESS_MAIN(tst_DSFrameScheduler)
+
+#include "tst_dsframescheduler.moc"
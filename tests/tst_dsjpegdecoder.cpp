@@ -0,0 +1,109 @@
+#include <QtTest/QtTest>
+
+#include <stdio.h>
+#include <jpeglib.h>
+
+#include "dsjpegdecoder.h"
+
+QT_USE_NAMESPACE
+
+namespace {
+
+const int Width = 320;
+const int Height = 240;
+
+// A 320x240 frame with detail everywhere, compressed with 4:2:0 chroma like
+// camera MJPEG.
+QByteArray encodeFrame()
+{
+    QVector<quint8> rgb(Width * Height * 3);
+    for (int y = 0; y < Height; ++y) {
+        for (int x = 0; x < Width * 3; ++x)
+            rgb[y * Width * 3 + x] = quint8(x * 7 + y * 3);
+    }
+
+    jpeg_compress_struct compress;
+    jpeg_error_mgr error;
+    compress.err = jpeg_std_error(&error);
+    jpeg_create_compress(&compress);
+
+    unsigned char *data = 0;
+    unsigned long size = 0;
+    jpeg_mem_dest(&compress, &data, &size);
+    compress.image_width = Width;
+    compress.image_height = Height;
+    compress.input_components = 3;
+    compress.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&compress);
+    jpeg_start_compress(&compress, TRUE);
+    while (compress.next_scanline < compress.image_height) {
+        JSAMPROW row = &rgb[compress.next_scanline * Width * 3];
+        jpeg_write_scanlines(&compress, &row, 1);
+    }
+    jpeg_finish_compress(&compress);
+    jpeg_destroy_compress(&compress);
+
+    const QByteArray frame(reinterpret_cast<const char *>(data), int(size));
+    free(data);
+    return frame;
+}
+
+} // end namespace
+
+// Region decoding against decoding the whole frame. Built twice, against the
+// installed libjpeg and with its libjpeg-turbo extensions hidden, since the
+// two skip rows in different ways.
+class tst_DSJpegDecoder : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void fullWidthRegionsMatchFullDecode();
+};
+
+void tst_DSJpegDecoder::fullWidthRegionsMatchFullDecode()
+{
+    const QByteArray frame = encodeFrame();
+    const quint8 *data = reinterpret_cast<const quint8 *>(frame.constData());
+
+    // full width, so nothing is cropped horizontally, starting below the top
+    const QRect regions[] = {
+        QRect(0, 40, Width, 100),
+        QRect(0, 17, Width, Height - 17),
+        QRect(0, 8, Width, 8),
+        QRect(0, Height - 1, Width, 1)
+    };
+
+    for (int scale = 1; scale <= 2; ++scale) {
+        DSJpegDecoder decoder;
+        decoder.setScale(scale);
+        const QSize size = decoder.start(data, frame.size());
+        QCOMPARE(size, QSize(Width / scale, Height / scale));
+
+        const int rowSize = size.width() * 3;
+        QVector<quint8> full(rowSize * size.height());
+        QVERIFY(decoder.decode(full.data(), rowSize));
+
+        for (int r = 0; r < int(sizeof(regions) / sizeof(regions[0])); ++r) {
+            decoder.setRegion(regions[r]);
+            QVERIFY(!decoder.start(data, frame.size()).isEmpty());
+            const QRect output = decoder.outputRegion();
+            QCOMPARE(output.x(), 0);
+            QCOMPARE(output.width(), size.width());
+            QVERIFY(output.y() > 0);
+
+            QVector<quint8> part(rowSize * output.height());
+            QVERIFY(decoder.decode(part.data(), rowSize));
+            for (int y = 0; y < output.height(); ++y) {
+                QVERIFY2(!memcmp(part.constData() + y * rowSize,
+                                 full.constData() + (output.y() + y) * rowSize, rowSize),
+                         qPrintable(QString::fromLatin1("scale %1 region %2 row %3").arg(scale).arg(r).arg(y)));
+            }
+        }
+        QCOMPARE(decoder.errorCount(), 0);
+    }
+}
+
+QTEST_APPLESS_MAIN(tst_DSJpegDecoder)
+
+#include "tst_dsjpegdecoder.moc"
@@ -0,0 +1,301 @@
+#include <QtTest/QtTest>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qtemporarydir.h>
+#include <QtCore/qthread.h>
+
+#include "dsframeprocessor.h"
+#include "dsframerecorder.h"
+#include "dsrecordformat.h"
+#include "dsreplayframesource.h"
+
+QT_USE_NAMESPACE
+
+namespace {
+
+const int FrameCount = 100;
+const qint64 Interval = 10000000; // 100 fps, in nanoseconds
+
+// BGR24 frames of one row, the sequence number in the first pixel.
+const int Width = 8;
+
+DSFrameFormat sequenceFormat()
+{
+    DSFrameFormat format;
+    format.pixelFormat = DSFrameFormat::BGR24;
+    format.width = Width;
+    format.height = 1;
+    format.stride = Width * 3;
+    format.sampleSize = format.frameSize();
+    return format;
+}
+
+// Converted to RGB, so the bytes come out the other way round.
+int sequenceOf(cv::Mat frame)
+{
+    const uchar *pixel = frame.ptr(0);
+    return pixel[2] | (pixel[1] << 8) | (pixel[0] << 16);
+}
+
+// Records FrameCount frames stamped Interval apart, as fast as the recorder
+// takes them.
+bool record(const QString &base)
+{
+    const DSFrameFormat format = sequenceFormat();
+    DSFramePool *pool = new DSFramePool(format.frameSize());
+    DSFrameRecorder recorder;
+    if (!recorder.start(base, format))
+        return false;
+
+    for (int i = 0; i < FrameCount; ++i) {
+        DSFrameHandle frame = pool->acquire();
+        memset(frame->data, 0, format.frameSize());
+        frame->data[0] = quint8(i);
+        frame->data[1] = quint8(i >> 8);
+        frame->data[2] = quint8(i >> 16);
+        frame->length = format.frameSize();
+        frame->time = i * Interval;
+        // the writer may fall behind a loop this tight; wait for it
+        while (!recorder.write(frame))
+            QThread::usleep(100);
+    }
+    recorder.stop();
+    pool->release();
+    return recorder.statistics().framesWritten == FrameCount;
+}
+
+// Takes frames directly on the processor's worker thread.
+class Receiver : public QObject
+{
+    Q_OBJECT
+public:
+    QVector<int> sequences() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_sequences;
+    }
+
+public slots:
+    void frameCaptured(cv::Mat frame)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_sequences.append(sequenceOf(frame));
+    }
+
+private:
+    mutable QMutex m_mutex;
+    QVector<int> m_sequences;
+};
+
+void setUp(DSFrameProcessor *processor, Receiver *receiver)
+{
+    // lossless, so every frame replayed comes out
+    processor->setBackpressurePolicy(DSFrameProcessor::BlockWithTimeout, 5000);
+    processor->setWorkerThreadEnabled(true);
+    QObject::connect(processor, SIGNAL(cvFrameCaptured(cv::Mat)),
+                     receiver, SLOT(frameCaptured(cv::Mat)), Qt::DirectConnection);
+}
+
+// first, first + 1, ... up to but not including last
+QVector<int> range(int first, int last)
+{
+    QVector<int> sequences;
+    for (int i = first; i < last; ++i)
+        sequences.append(i);
+    return sequences;
+}
+
+} // end namespace
+
+// Records a numbered sequence of frames into a temporary directory, then
+// replays it into a processor converting on its worker thread.
+class tst_DSReplayFrameSource : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void asFastAsPossible();
+    void realTime();
+    void seek();
+    void seekWhilePlaying();
+    void truncatedIndex();
+
+private:
+    QTemporaryDir *m_dir;
+    QString m_base;
+};
+
+void tst_DSReplayFrameSource::init()
+{
+    m_dir = new QTemporaryDir;
+    QVERIFY(m_dir->isValid());
+    m_base = m_dir->path() + QLatin1String("/capture");
+    QVERIFY(record(m_base));
+}
+
+void tst_DSReplayFrameSource::cleanup()
+{
+    delete m_dir;
+    m_dir = 0;
+}
+
+void tst_DSReplayFrameSource::asFastAsPossible()
+{
+    DSReplayFrameSource source(m_base);
+    QVERIFY(source.open());
+    QCOMPARE(source.frameCount(), FrameCount);
+    QCOMPARE(source.format().pixelFormat, DSFrameFormat::BGR24);
+    QCOMPARE(source.format().width, Width);
+    QCOMPARE(source.format().stride, Width * 3);
+
+    DSFrameProcessor processor;
+    Receiver receiver;
+    setUp(&processor, &receiver);
+    source.setPacing(DSReplayFrameSource::AsFastAsPossible);
+
+    // a second's worth of recording, in well under half that
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(source.start(&processor));
+    QVERIFY(source.waitForFinished(5000));
+    QVERIFY(timer.elapsed() < FrameCount * Interval / 2000000);
+
+    QCOMPARE(source.framesDelivered(), FrameCount);
+    QCOMPARE(source.framesDropped(), 0);
+    QTRY_COMPARE(receiver.sequences(), range(0, FrameCount));
+    QTRY_COMPARE(processor.inputPoolStatistics().outstanding, 0);
+}
+
+void tst_DSReplayFrameSource::realTime()
+{
+    DSReplayFrameSource source(m_base);
+    DSFrameProcessor processor;
+    Receiver receiver;
+    setUp(&processor, &receiver);
+    QCOMPARE(source.pacing(), DSReplayFrameSource::RealTime);
+
+    // the last frame is due (FrameCount - 1) intervals after the first
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(source.start(&processor));
+    QVERIFY(source.waitForFinished(5000));
+    QVERIFY(timer.nsecsElapsed() >= (FrameCount - 1) * Interval);
+
+    QCOMPARE(source.framesDelivered(), FrameCount);
+    QTRY_COMPARE(receiver.sequences(), range(0, FrameCount));
+
+    // the recorded time stamps come along
+    const DSFramePacingStatistics pacing = processor.arrivalPacing();
+    QCOMPARE(pacing.lastCaptureTime - pacing.firstCaptureTime, (FrameCount - 1) * Interval);
+}
+
+void tst_DSReplayFrameSource::seek()
+{
+    DSReplayFrameSource source(m_base);
+    QVERIFY(source.open());
+
+    // the first frame at or after the time
+    source.seekToTime(40 * Interval);
+    QCOMPARE(source.position(), 40);
+    source.seekToTime(40 * Interval + 1);
+    QCOMPARE(source.position(), 41);
+    source.seekToTime(-1);
+    QCOMPARE(source.position(), 0);
+    source.seekToTime(FrameCount * Interval);
+    QCOMPARE(source.position(), FrameCount);
+    source.seek(-5);
+    QCOMPARE(source.position(), 0);
+    source.seek(FrameCount + 5);
+    QCOMPARE(source.position(), FrameCount);
+
+    // playback starts where seeked to
+    DSFrameProcessor processor;
+    Receiver receiver;
+    setUp(&processor, &receiver);
+    source.setPacing(DSReplayFrameSource::AsFastAsPossible);
+    source.seekToTime(FrameCount / 2 * Interval);
+    QVERIFY(source.start(&processor));
+    QVERIFY(source.waitForFinished(5000));
+    QCOMPARE(source.framesDelivered(), FrameCount / 2);
+    QTRY_COMPARE(receiver.sequences(), range(FrameCount / 2, FrameCount));
+}
+
+void tst_DSReplayFrameSource::seekWhilePlaying()
+{
+    DSReplayFrameSource source(m_base);
+    DSFrameProcessor processor;
+    Receiver receiver;
+    setUp(&processor, &receiver);
+
+    QVERIFY(source.start(&processor));
+    QTRY_VERIFY(receiver.sequences().size() >= 3);
+
+    // jump ahead, and the pacing starts over from the frame seeked to
+    // rather than waiting out the time skipped
+    const int target = FrameCount - 10;
+    QElapsedTimer timer;
+    timer.start();
+    source.seekToTime(source.frameTime(target));
+    QVERIFY(source.waitForFinished(5000));
+    QVERIFY(timer.nsecsElapsed() < FrameCount * Interval / 2);
+
+    QTRY_COMPARE(receiver.sequences().size(), source.framesDelivered());
+    const QVector<int> emitted = receiver.sequences();
+    QVERIFY(emitted.size() < target);
+    for (int i = 1; i < emitted.size(); ++i)
+        QVERIFY(emitted.at(i) > emitted.at(i - 1));
+    QCOMPARE(emitted.mid(emitted.size() - 10), range(target, FrameCount));
+}
+
+void tst_DSReplayFrameSource::truncatedIndex()
+{
+    const QString data = DSRecordFormat::segmentPath(m_base, 0);
+    const QString index = DSRecordFormat::indexPath(m_base, 0);
+    QVERIFY(!QFile::exists(DSRecordFormat::segmentPath(m_base, 1)));
+
+    // the last entry written halfway
+    const qint64 entrySize = sizeof(DSRecordFormat::IndexEntry);
+    QFile indexFile(index);
+    QCOMPARE(indexFile.size(), FrameCount * entrySize);
+    QVERIFY(QFile::resize(index, indexFile.size() - entrySize / 2));
+    {
+        DSReplayFrameSource source(m_base);
+        QVERIFY(source.open());
+        QCOMPARE(source.frameCount(), FrameCount - 1);
+    }
+
+    // and the data cut off in the middle of frame 40: the entries from there
+    // on point past the end
+    QVERIFY(indexFile.open(QIODevice::ReadOnly));
+    DSRecordFormat::IndexEntry entry;
+    QVERIFY(indexFile.seek(40 * entrySize));
+    QCOMPARE(indexFile.read(reinterpret_cast<char *>(&entry), entrySize), entrySize);
+    indexFile.close();
+    QVERIFY(QFile::resize(data, entry.offset + entry.length / 2));
+
+    DSReplayFrameSource source(m_base);
+    QVERIFY(source.open());
+    QCOMPARE(source.frameCount(), 40);
+
+    DSFrameProcessor processor;
+    Receiver receiver;
+    setUp(&processor, &receiver);
+    source.setPacing(DSReplayFrameSource::AsFastAsPossible);
+    QVERIFY(source.start(&processor));
+    QVERIFY(source.waitForFinished(5000));
+    QTRY_COMPARE(receiver.sequences(), range(0, 40));
+
+    // nothing left at all
+    QVERIFY(QFile::resize(index, 0));
+    DSReplayFrameSource empty(m_base);
+    QVERIFY(!empty.open());
+    QVERIFY(!empty.start(&processor));
+}
+
+QTEST_GUILESS_MAIN(tst_DSReplayFrameSource)
+
+#include "tst_dsreplayframesource.moc"
@@ -0,0 +1,178 @@
+#include <QtTest/QtTest>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qmutex.h>
+
+#include "dsframeprocessor.h"
+#include "dssyntheticframesource.h"
+
+QT_USE_NAMESPACE
+
+namespace {
+
+const int Width = 640;
+const int Height = 480;
+const int FrameCount = 24;
+const int PhaseCount = 8;
+
+// Keeps the frames it gets, directly on the processor's worker thread.
+class Receiver : public QObject
+{
+    Q_OBJECT
+public:
+    QList<cv::Mat> frames() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_frames;
+    }
+
+    int count() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_frames.size();
+    }
+
+public slots:
+    void frameCaptured(cv::Mat frame)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_frames.append(frame);
+    }
+
+private:
+    mutable QMutex m_mutex;
+    QList<cv::Mat> m_frames;
+};
+
+const DSFrameFormat::PixelFormat pixelFormats[] = {
+    DSFrameFormat::YUY2, DSFrameFormat::BGR24, DSFrameFormat::I420, DSFrameFormat::NV12
+};
+
+bool near(const uchar *pixel, int r, int g, int b)
+{
+    return qAbs(pixel[0] - r) <= 3 && qAbs(pixel[1] - g) <= 3 && qAbs(pixel[2] - b) <= 3;
+}
+
+// Phase of the moving bars: the first edge, white to yellow, where blue
+// drops, is an eighth of the width in and moves left by a 64th per phase.
+int phaseOf(cv::Mat frame)
+{
+    const uchar *row = frame.ptr(0);
+    int x = 1;
+    while (x < frame.cols && qAbs(row[x * 3 + 2] - row[2]) < 64)
+        ++x;
+    return (frame.cols / 8 - x) / (frame.cols / 64);
+}
+
+// What is wrong with the frames the source sent, if anything.
+QString checkFrames(const QList<cv::Mat> &frames)
+{
+    for (int i = 0; i < frames.size(); ++i) {
+        cv::Mat frame = frames.at(i);
+        if (frame.cols != Width || frame.rows != Height || frame.type() != CV_8UC3)
+            return QString::fromLatin1("frame %1 is %2x%3").arg(i).arg(frame.cols).arg(frame.rows);
+
+        // white bar top left, the grey ramp along the bottom, upright for
+        // the bottom-up RGB24 as well
+        if (!near(frame.ptr(0), 191, 191, 191))
+            return QString::fromLatin1("frame %1 does not start with white").arg(i);
+        if (!near(frame.ptr(Height - 1), 0, 0, 0)
+                || !near(frame.ptr(Height - 1) + (Width - 1) * 3, 255, 255, 255))
+            return QString::fromLatin1("frame %1 has no ramp at the bottom").arg(i);
+        if (phaseOf(frame) != i % PhaseCount)
+            return QString::fromLatin1("frame %1 in phase %2").arg(i).arg(phaseOf(frame));
+    }
+    return QString();
+}
+
+} // end namespace
+
+// The synthetic source feeding a processor converting on its worker thread,
+// in each format it generates.
+class tst_DSSyntheticFrameSource : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void deliversThroughThePipeline();
+    void pacesToTheFrameRate();
+    void stopEndsDelivery();
+};
+
+void tst_DSSyntheticFrameSource::deliversThroughThePipeline()
+{
+    for (int f = 0; f < int(sizeof(pixelFormats) / sizeof(pixelFormats[0])); ++f) {
+        DSFrameProcessor processor;
+        processor.setBackpressurePolicy(DSFrameProcessor::BlockWithTimeout, 5000);
+        processor.setWorkerThreadEnabled(true);
+        Receiver receiver;
+        QObject::connect(&processor, SIGNAL(cvFrameCaptured(cv::Mat)),
+                         &receiver, SLOT(frameCaptured(cv::Mat)), Qt::DirectConnection);
+
+        // as fast as the processor takes them
+        DSSyntheticFrameSource source(pixelFormats[f], Width, Height, 0);
+        source.setFrameCount(FrameCount);
+        QVERIFY(source.start(&processor));
+        QCOMPARE(processor.format().pixelFormat, pixelFormats[f]);
+        QVERIFY(source.waitForFinished(5000));
+        QCOMPARE(source.framesDelivered(), FrameCount);
+        QCOMPARE(source.framesDropped(), 0);
+        QTRY_COMPARE(receiver.count(), FrameCount);
+
+        const QString error = checkFrames(receiver.frames());
+        QVERIFY2(error.isEmpty(), qPrintable(QString::fromLatin1("format %1: %2").arg(int(pixelFormats[f])).arg(error)));
+    }
+}
+
+void tst_DSSyntheticFrameSource::pacesToTheFrameRate()
+{
+    DSFrameProcessor processor;
+    processor.setWorkerThreadEnabled(true);
+    Receiver receiver;
+    QObject::connect(&processor, SIGNAL(cvFrameCaptured(cv::Mat)),
+                     &receiver, SLOT(frameCaptured(cv::Mat)), Qt::DirectConnection);
+
+    DSSyntheticFrameSource source(DSFrameFormat::YUY2, 320, 240, 120);
+    source.setFrameCount(FrameCount);
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(source.start(&processor));
+    QVERIFY(source.waitForFinished(5000));
+
+    // the last frame is due (FrameCount - 1) / 120 s after the first
+    QVERIFY(timer.elapsed() >= (FrameCount - 1) * 1000 / 120);
+    QCOMPARE(source.framesDelivered(), FrameCount);
+    QTRY_COMPARE(receiver.count(), FrameCount);
+
+    // stamped with when they were due, not when they were sent
+    const DSFramePacingStatistics pacing = processor.arrivalPacing();
+    QCOMPARE(pacing.frames, qint64(FrameCount));
+    QVERIFY(qAbs(pacing.captureFrameRate - 120) < 0.5);
+}
+
+void tst_DSSyntheticFrameSource::stopEndsDelivery()
+{
+    DSFrameProcessor processor;
+    processor.setWorkerThreadEnabled(true);
+    Receiver receiver;
+    QObject::connect(&processor, SIGNAL(cvFrameCaptured(cv::Mat)),
+                     &receiver, SLOT(frameCaptured(cv::Mat)), Qt::DirectConnection);
+
+    // no frame count, on until stopped
+    DSSyntheticFrameSource source(DSFrameFormat::NV12, 320, 240, 200);
+    QVERIFY(source.start(&processor));
+    QVERIFY(source.isActive());
+    QVERIFY(!source.start(&processor));
+    QTRY_VERIFY(receiver.count() >= 4);
+
+    source.stop();
+    QVERIFY(!source.isActive());
+    const int delivered = source.framesDelivered();
+    QTRY_COMPARE(receiver.count(), delivered);
+    QTest::qWait(50);
+    QCOMPARE(source.framesDelivered(), delivered);
+    QCOMPARE(receiver.count(), delivered);
+}
+
+QTEST_GUILESS_MAIN(tst_DSSyntheticFrameSource)
+
+#include "tst_dssyntheticframesource.moc"